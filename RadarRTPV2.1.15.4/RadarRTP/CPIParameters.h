@@ -20,8 +20,13 @@ See the GNU General Public License for more details, supplied with this source a
 using DataTOV = std::chrono::system_clock::time_point;
 using DataTics = std::chrono::duration<int64_t, std::micro>;
 
+// Processing mode of a CPI.  Selected by ProcessingMode in the configuration file and handled by the
+// worker kernels in processWorkers.cpp (Radar_Data_Flowing::calibrateRows and compress).
 enum DataType {
-	CW, LFMRangeDoppler, UpDownLFM, ArbRangeDoppler, SonarRangeDoppler 
+	CW,					// No range processing, Doppler FFT of each sample of the WRI
+	LFMRangeDoppler,	// Stretch (dechirped) LFM, 2-D FFT
+	UpDownLFM,			// Triangle sweep, up on even WRIs and down on odd ones, combined to remove range-Doppler coupling
+	SonarRangeDoppler	// Sonar: mixed to baseband, correlated with the replica of the sonar waveform, then Doppler FFT
 };
 
 typedef struct CPI_Params {
@@ -33,6 +38,6 @@ typedef struct CPI_Params {
 	unsigned int Samp_Per_WRI=128;			// Samples per waveform repetition interval
 	unsigned int Num_WRI=128;				// Number of WRI per coherent processing interval
 	unsigned int NumSensorsSet=2;			// Number of sensors
-	//DataType myType;
+	DataType myType = LFMRangeDoppler;	// How the CPI is processed
 } CPI_Params;
 
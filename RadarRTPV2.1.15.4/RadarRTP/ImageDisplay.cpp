@@ -442,6 +442,8 @@ void PowerSpecDispThread()
 	float tmp;
 	int cindex;
 	uint32_t *targetLines[MaxRadars];
+	char *lineTemp;			// For the fftshift of each line
+	setThreadRole(ThreadDisplay);
 	log_message("Thread that converts results to display format and tells display to update has started.");
 
 	// initialize the database
@@ -449,21 +451,14 @@ void PowerSpecDispThread()
 		dBInitialize();
 #endif
 
-	// Reserve my output memory
+	// Reserve my output memory, from gArena
 	for (int rindex = 0; rindex < gRadarState.NumSensorsSet; rindex++) {
 		gProcessedData.pDTI[rindex] = (float*)
-			malloc(gRadarConfig.DTI_Height*gRadarConfig.NWRIPerCPI*NBYTES_PER_PIXEL);
-		gProcessedData.target_line[rindex] = (char*)malloc(gRadarConfig.NWRIPerCPI*NBYTES_PER_PIXEL);
-		targetLines[rindex] = (unsigned int *)malloc(gRadarConfig.NWRIPerCPI*sizeof(unsigned int));
-		if ((gProcessedData.pDTI[rindex] == NULL) || 
-			(gProcessedData.target_line[rindex] == NULL) ||
-			(targetLines[rindex]==NULL) )
-		{
-			log_error_message("Allocation of DTI memory blocks failed.  Exiting", GetLastError());
-			// If the array allocation fails, the system is out of memory so exit
-			exit(5);
-		}
+			gArena.take(gRadarConfig.DTI_Height*gRadarConfig.NWRIPerCPI*NBYTES_PER_PIXEL, "DTI");
+		gProcessedData.target_line[rindex] = (char*)gArena.take(gRadarConfig.NWRIPerCPI*NBYTES_PER_PIXEL, "target line");
+		targetLines[rindex] = (unsigned int *)gArena.take(gRadarConfig.NWRIPerCPI*sizeof(unsigned int), "target line");
 	}
+	lineTemp = (char *)gArena.take(gRadarConfig.NWRIPerCPI*NBYTES_PER_PIXEL, "display line");
 	dthreadSyncFlag = FALSE;  // If starting thread is listening, let them know we completed initialization
 
 	while (!dthreadSyncFlag)  // Loop until stop is requested
@@ -527,14 +522,9 @@ void PowerSpecDispThread()
 				}
 
 				// Now do FFTShift on only the Doppler axis
-				float* ptemp;
+				char* ptemp = lineTemp;
 				int j;
 				if ((Num_WRI > 1)) {
-					ptemp = (float*)malloc(Num_WRI * sizeof(char)* Bytes_per_pixel);
-					if (ptemp == NULL) {
-						log_message("Error %d: Unable to perform fftshift of data", GetLastError());
-						return;
-					}
 					int txsize=Num_WRI / 2 * sizeof(char) * Bytes_per_pixel;
 					for (j = 0; j < Samp_Per_WRI ; j++) {
 						// Using pointer arithmetic to point at location for copy
@@ -542,7 +532,15 @@ void PowerSpecDispThread()
 						memcpy(pRDIBits + (j * Num_WRI + Num_WRI / 2)* Bytes_per_pixel, pRDIBits + (j  * Num_WRI ) * Bytes_per_pixel, txsize);
 						memcpy(pRDIBits + j * Num_WRI * Bytes_per_pixel, ptemp, txsize);
 					}
-					free(ptemp);
+				}
+
+				// Mark the CFAR detections on the RDI with the blue value full on, like the peak overlay on the DTI
+				if (gRadarState.PeakOverlay) {
+					DetectionList &dets = gProcessedData.Detections[rindex];
+					for (int k = 0; k < dets.NumDetections; k++) {
+						int dopcol = (dets.Det[k].DopplerIndex + Num_WRI / 2) % Num_WRI;
+						pRDIBits[(dets.Det[k].RangeIndex * Num_WRI + dopcol) * Bytes_per_pixel] = (char)255;
+					}
 				}
 			}
 					
@@ -576,11 +574,8 @@ void PowerSpecDispThread()
 	}
 	log_message("Display data formatting routine exiting.");
 	Sleep(10);
-	// Delete memory that I allocated
+	// The memory that I took goes back with gArena
 	for (int rindex = 0; rindex < gRadarState.NumSensorsSet; rindex++) {
-		free(gProcessedData.pDTI[rindex]);
-		free(gProcessedData.target_line[rindex]);
-		free(targetLines[rindex]);
 		gProcessedData.pDTI[rindex] = NULL;
 		gProcessedData.target_line[rindex] = NULL;
 		targetLines[rindex] = NULL;
@@ -34,11 +34,9 @@ public:
 		log_message("Initializing Raw Data Buffer");
 		data.resize(Params.NumSensorsSet);
 		for (unsigned int rindex = 0; rindex < Params.NumSensorsSet; rindex++) {
-			data[rindex] = (RTPComplex*)fftwf_malloc(sizeof(RTPComplex) * Params.Samp_Per_WRI*Params.Num_WRI);
-			if (data[rindex] == NULL) {
-				log_error_message("Can't allocate raw data memory for processing thread", GetLastError());
-				exit(1L);
-			}
+			data[rindex] = (RTPComplex*)gArena.take(sizeof(RTPComplex) * Params.Samp_Per_WRI*Params.Num_WRI, "raw data");
+			// On the node of the dispatcher, which made it and loads it
+			gNuma.place(data[rindex], sizeof(RTPComplex) * Params.Samp_Per_WRI*Params.Num_WRI, gNuma.currentNode());
 		}
 	};
 	void MoveUp() {
@@ -112,12 +110,30 @@ public:
 		}
 
 	};
+	// Adds one sensor's simulated block, contiguous in time (see SimStage)
+	void AddSimBlock(const RTPComplex *Sim, unsigned int Sensor, int offset) {
+		const unsigned int n = NWRIPerBlock * Params.Samp_Per_WRI;
+		RTPComplex *d = &data[Sensor][offset];
+		if (!RealOnly) {
+			for (unsigned int i = 0; i < n; i++) d[i] += Sim[i];
+		}
+		else {
+			for (unsigned int i = 0; i < n; i++) d[i] += RTPComplex(Sim[i].real(), 0.0f);
+		}
+	};
+	// The newest block of a sensor's data, at the offset returned by LoadData
+	const RTPComplex *Block(unsigned int Sensor, int offset) const {
+		return &data[Sensor][offset];
+	};
+	RTPComplex *Block(unsigned int Sensor, int offset) {
+		return &data[Sensor][offset];
+	};
 	void CopyOut(RTPComplex * OutBuffer, unsigned int Sensor) {
 		memcpy(OutBuffer, data[Sensor], (Params.Samp_Per_WRI*Params.Num_WRI) * sizeof(RTPComplex));
 	};
 	~RawDataBuffer() {
 		for (unsigned int rindex = 0; rindex < Params.NumSensorsSet; rindex++) {
-			if (data[rindex] != NULL) { fftwf_free(data[rindex]);  data[rindex] = NULL; }
+			data[rindex] = NULL;	// The memory goes back with gArena
 		}
 	};
 };
@@ -0,0 +1,161 @@
+// One block of memory for the pipeline buffers.
+// The ADC ring, the raw data buffers, the worker, calibration and gather buffers, and the display lines are all
+// taken from a block that is reserved once, when the radar starts.  Its size is worked out from the CPI up front,
+// so if there isn't the memory it shows up then, in one message, rather than as exit(n) from whichever thread
+// got to its malloc last.  Nothing is allocated while the data is flowing.
+//
+// The block is on 2 MB huge pages, which cuts the TLB misses of the FFTs on large CPIs:
+//	Linux: explicit huge pages (vm.nr_hugepages) if there are enough, otherwise transparent huge pages
+//	Windows: large pages, which need the "Lock pages in memory" right (SeLockMemoryPrivilege)
+// and falls back to normal pages.  [system] HugePages = false goes straight to normal pages.
+// Every buffer starts on a 64 byte boundary, for AVX-512.  With NumaOn the buffers of a huge page or more start
+// on a page of their own, so that each can go on its worker's node.  Without NumaOn the pages are touched
+// here, so they are all mapped before the start.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "radarc.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+static const char *KindText[] = { "none", "huge pages", "transparent huge pages", "normal pages" };	// By ArenaKind
+
+static size_t roundUp(size_t Bytes, size_t Grain)
+{
+	return (Bytes + Grain - 1) / Grain * Grain;
+}
+
+// Where a buffer of this size starts
+size_t BufferArena::boundary(size_t Bytes) const
+{
+	return (Bytes >= Grain) ? Grain : AlignBytes;
+}
+
+// Every buffer the pipeline takes, with the number of each.  This has to follow the allocations in
+// buff_init, Process_data, StartWorkerThreads, Radar_Data_Flowing::initialize, CalData::initializeCal,
+// OutputWorkerFunction and PowerSpecDispThread.
+void BufferArena::plan(const CPI_Params &Params)
+{
+	const size_t S = Params.Samp_Per_WRI, W = Params.Num_WRI;
+	const size_t Radars = MAX((size_t)Params.NumSensorsSet, (size_t)gRadarConfig.NumRadars);	// The ADC setup can lower it later
+	const size_t Workers = gRadarConfig.NumThreads;
+	// MTI isn't used with the long sweep, see Process_data
+	const size_t RawBuffers = 1 + ((longSweepOn() || (gRadarConfig.MTIType != MTIOff)) ? 1 : 0);
+	Parts.clear();
+	Parts.push_back({ "ADC ring", 2 * NBUFF * S * gRadarConfig.NWRIPerBlock * gRadarConfig.NumRadars * sizeof(float), 1 });
+	Parts.push_back({ "raw data", S * W * sizeof(RTPComplex), RawBuffers * Radars });
+	Parts.push_back({ "window", W * sizeof(float), 1 });
+	Parts.push_back({ "window", S * sizeof(float), 1 });
+	Parts.push_back({ "worker data", S * W * sizeof(fftwf_complex) * gRadarConfig.BatchCPIs, Workers });	// A batch of CPIs each
+	Parts.push_back({ "worker power", S * W * sizeof(float) * gRadarConfig.BatchCPIs, Workers });
+	Parts.push_back({ "cal data", S * W * sizeof(RTPComplex), Radars });
+	Parts.push_back({ "cal offsets", S * sizeof(RTPComplex), Radars });
+	Parts.push_back({ "gather power", S * W * sizeof(float), Radars });
+	Parts.push_back({ "DTI", gRadarConfig.DTI_Height * W * NBYTES_PER_PIXEL, Radars });
+	Parts.push_back({ "target line", W * NBYTES_PER_PIXEL, 2 * Radars });
+	Parts.push_back({ "display line", W * NBYTES_PER_PIXEL, 1 });
+}
+
+int BufferArena::reserve(const CPI_Params &Params)
+{
+	if (Base != NULL) return 0;
+	Grain = gRadarConfig.NumaOn ? HugePageBytes : AlignBytes;
+	plan(Params);
+	size_t Bytes = 0, Buffers = 0;
+	for (const ArenaPart &Part : Parts) {
+		// Up to a boundary less one alignment of padding in front of each
+		Bytes += Part.Count * (roundUp(Part.Bytes, AlignBytes) + boundary(Part.Bytes) - AlignBytes);
+		Buffers += Part.Count;
+	}
+	Size = roundUp(Bytes, HugePageBytes);
+	Used = 0;
+
+#ifdef _WIN32
+	SIZE_T LargePage = GetLargePageMinimum();
+	if (gRadarConfig.HugePages && (LargePage > 0)) {
+		Base = (char *)VirtualAlloc(NULL, roundUp(Size, LargePage), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (Base != NULL) Kind = ArenaHugePages;
+	}
+	if (Base == NULL) {
+		Base = (char *)VirtualAlloc(NULL, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (Base != NULL) Kind = ArenaNormalPages;
+	}
+#else
+#ifdef MAP_HUGETLB
+	if (gRadarConfig.HugePages) {
+		void *p = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED) {
+			Base = (char *)p;
+			Kind = ArenaHugePages;
+		}
+	}
+#endif
+	if (Base == NULL) {
+		void *p = NULL;
+		if (posix_memalign(&p, HugePageBytes, Size) == 0) {
+			Base = (char *)p;
+			Kind = ArenaNormalPages;
+#ifdef MADV_HUGEPAGE
+			if (gRadarConfig.HugePages && (madvise(p, Size, MADV_HUGEPAGE) == 0)) Kind = ArenaTransparentPages;
+#endif
+		}
+	}
+#endif
+	if (Base == NULL) {
+		std::stringstream msgstr;
+		msgstr << "Error: Can't allocate " << Size / 1048576.0 << " MB for the processing buffers. Exiting. They are";
+		for (const ArenaPart &Part : Parts)
+			msgstr << "\n\t" << Part.Name << ": " << Part.Count << " x " << Part.Bytes << " bytes";
+		log_message(msgstr.str());
+		exit(1);
+	}
+	if (!gRadarConfig.NumaOn) memset(Base, 0, Size);	// Otherwise the owner of each buffer touches it first (NumaLayout::place)
+	log_message("Processing buffers: %zu buffers, %zu bytes, in %.1f MB on %s", Buffers, Bytes, Size / 1048576.0, KindText[Kind]);
+	return 0;
+}
+
+void *BufferArena::take(size_t Bytes, const char *Name)
+{
+	std::unique_lock<std::mutex> lock(Lock);
+	size_t Start = roundUp(Used, boundary(Bytes));
+	if ((Base == NULL) || (Start + Bytes > Size)) {
+		log_message("Error: No room for the %s buffer (%zu bytes) in the %zu byte processing buffer block, %zu used. Exiting",
+			Name, Bytes, Size, Used);
+		exit(1);
+	}
+	Used = Start + roundUp(MAX(Bytes, (size_t)1), AlignBytes);
+	return Base + Start;
+}
+
+// When the program exits, after the display has stopped
+void BufferArena::release()
+{
+	if (Base == NULL) return;
+	log_message("Processing buffers: %zu of %zu bytes were used", Used, Size);
+#ifdef _WIN32
+	VirtualFree(Base, 0, MEM_RELEASE);
+#else
+	if (Kind == ArenaHugePages) munmap(Base, Size);
+	else free(Base);
+#endif
+	Base = NULL;
+	Kind = ArenaNone;
+	Size = Used = 0;
+}
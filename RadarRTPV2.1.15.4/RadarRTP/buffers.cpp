@@ -33,6 +33,7 @@ See the GNU General Public License for more details, supplied with this source a
 #include <condition_variable>
 
 std::condition_variable BuffDataHere; // Data ready for processing
+std::condition_variable BuffSpaceHere; // A buffer has been freed (only waited on in virtual time)
 std::mutex BuffOwnBuffers;			// Mutex for the data buffers
 
 int Buff_Next_Open = 0;		// only the producer should change this value through buff_mark_used()
@@ -43,15 +44,10 @@ bool BuffDataFlowing = FALSE;
 void buff_init(void)
 {
 	// Allocate global memory for the circular buffers [NBUFF][NSAMP_PER_WRI*NWRI_Per_Block*NUMRXCHAN]
-	Buff_Data[0] = (float*)malloc(2 * NBUFF*gRadarConfig.NSamplesPerWRI *gRadarConfig.NWRIPerBlock * gRadarConfig.NumRadars * sizeof(float));
-	if (Buff_Data != NULL) {
-		for (int index = 1; index<NBUFF; index++) {
-			Buff_Data[index] = Buff_Data[index - 1] + 2 * gRadarConfig.NSamplesPerWRI *gRadarConfig.NWRIPerBlock * gRadarConfig.NumRadars;
-		}
-	}
-	else {
-		log_error_message("Circular Buffer: Unable to allocate memory for cicular buffers.", GetLastError());
-		exit(1);
+	Buff_Data[0] = (float*)gArena.take(2 * NBUFF*gRadarConfig.NSamplesPerWRI *gRadarConfig.NWRIPerBlock * gRadarConfig.NumRadars * sizeof(float),
+		"ADC ring");
+	for (int index = 1; index<NBUFF; index++) {
+		Buff_Data[index] = Buff_Data[index - 1] + 2 * gRadarConfig.NSamplesPerWRI *gRadarConfig.NWRIPerBlock * gRadarConfig.NumRadars;
 	}
 	std::unique_lock<std::mutex> bufferlock(BuffOwnBuffers);
 	Buff_Next_Open=0;
@@ -76,6 +72,7 @@ void buff_free(void)
 		BuffCount = 0;
 	}
 	bufferlock.unlock();
+	BuffSpaceHere.notify_one();
 }
 
 void buff_mark_used(int index)  		/* Mark buffer as being used (has data)  */
@@ -93,7 +90,8 @@ void buff_mark_used(int index)  		/* Mark buffer as being used (has data)  */
 	if (BuffCount==(NBUFF-1)) {
 		log_message("Warning: Circular Buffer: over run. Skipping input data block.  Currently blocks = %d", BuffCount);
 		// Don't advance the block buffer pointer even though the data might have been consumed before the next callback */
-		// This buffer will be over-written and warning logged - data will be currupted
+		// This buffer will be over-written and the block lost.  The dispatcher sees the gap in the frame counts
+		// (Buff_count) and doesn't make CPIs across it, see overload.cpp
 
 	} else {
 		Buff_Next_Open= (Buff_Next_Open+1) % NBUFF;  /* increment write pointer to next block */
@@ -111,6 +109,24 @@ int buff_get_next_free(void)
 	return(Buff_Next_Open);
 }
 
+int buff_depth(void)
+{
+	std::unique_lock<std::mutex> bufferlock(BuffOwnBuffers);
+	return(BuffCount);
+}
+
+// The simulated ADC in virtual time waits here instead of over-running the buffers.
+// Returns false if nothing was freed for a second so the caller can check whether it should stop.
+bool buff_Wait_For_Space(void)
+{
+	std::unique_lock<std::mutex> bufferlock(BuffOwnBuffers);
+	while (BuffCount >= (NBUFF - 1)) {
+		std::cv_status cvstat = BuffSpaceHere.wait_for(bufferlock, std::chrono::milliseconds(1000));
+		if (cvstat == std::cv_status::timeout) return false;
+	}
+	return true;
+}
+
 /* The following will block until a full data buffer block is available or timeout occurs */
 /* It will return the index to the data block that is next to be read/processed */
 /* Will return -1 if no data is provided in last 1000ms */
@@ -134,8 +150,7 @@ int buff_Wait_For_Data(void)
 
 void buff_destroy(void)
 {
-	free(Buff_Data[0]);
-	Buff_Data[0] = NULL;
+	Buff_Data[0] = NULL;	// The memory goes back with gArena
 	return;
 }
 
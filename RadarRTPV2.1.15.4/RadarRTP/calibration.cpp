@@ -10,6 +10,8 @@
 //                Re-wrote the calibration functions for means, covariance and specialized eigen decomposition
 //  April 2019, added the N-point moving average approach to calculating the DC offset and fixed a bug in the fading memory for the covariance.
 //              The moving average works far better, at least in simulation, than fading memory for DC offset calculation.
+//  Oct 2026, save the converged calibration and reload it at start up (saveState, loadState)
+//  Oct 2026, optional IQ correction per range sub-band (CalSubBands) for coupling that varies along the sweep
 /*
 RadarRTP - Radar Real time Program (RTP)
 
@@ -31,6 +33,232 @@ See the GNU General Public License for more details, supplied with this source a
 #include <iostream>
 #include <sstream>
 
+// Single pass over the calibration data for all of the statistics: the overall mean, the mean of each
+// range sample and the second moments of I and Q.  The data is read in memory order, one WRI at a time.
+// A reference (the previous mean) is subtracted first so the second moments don't lose precision to a
+// large DC offset.  Within a WRI the sums are kept in eight float lanes, which the compiler vectorizes
+// without needing to reorder the sums, and the WRI totals are added up in double.
+// Data[] points to NumWRI WRIs for each radar: a whole CPI (calStatistics) or one block (updateBlock).
+void CalData::blockStatistics(const RTPComplex * const Data[], unsigned int NumWRI, bool RangeDep)
+{
+	const unsigned int nr = Params.Samp_Per_WRI, nwri = NumWRI;
+	const unsigned int nf = 2 * nr;					// floats per WRI
+	StatWRI = NumWRI;
+	const unsigned int nblk = nf & ~7u;
+
+	for (unsigned int rindex = 0; rindex < Params.NumSensorsSet; rindex++) {
+		float *ref = &RefRow[rindex * nf];
+		double *bin = &BinSum[rindex * nf];
+		for (unsigned int k = 0; k < nr; k++) {
+			RTPComplex c = RangeDep ? DCOffsetWRIHist[rindex][k] : DCOffsetHist[rindex];
+			ref[2 * k] = c.real();
+			ref[2 * k + 1] = c.imag();
+		}
+		for (unsigned int j = 0; j < nf; j++) bin[j] = 0.0;
+
+		double sxx = 0.0, syy = 0.0, sxy = 0.0;
+		if (RangeDep && (NumBands > 0)) {
+			// Sub-bands need the second moments of each range sample, so keep them per sample in double
+			double *mxx = &BinMom[rindex * 3 * nr], *myy = mxx + nr, *mxy = myy + nr;
+			for (unsigned int k = 0; k < 3 * nr; k++) mxx[k] = 0.0;
+			for (unsigned int w = 0; w < nwri; w++) {
+				const float *row = reinterpret_cast<const float *>(&Data[rindex][w * nr]);
+				for (unsigned int k = 0; k < nr; k++) {
+					float dr = row[2 * k] - ref[2 * k], di = row[2 * k + 1] - ref[2 * k + 1];
+					bin[2 * k] += dr;
+					bin[2 * k + 1] += di;
+					mxx[k] += dr * dr;
+					myy[k] += di * di;
+					mxy[k] += dr * di;
+				}
+			}
+			for (unsigned int k = 0; k < nr; k++) {
+				sxx += mxx[k];
+				syy += myy[k];
+				sxy += mxy[k];
+			}
+		}
+		else for (unsigned int w = 0; w < nwri; w++) {
+			const float *row = reinterpret_cast<const float *>(&Data[rindex][w * nr]);
+			float sq[8] = { 0.0f }, cr[4] = { 0.0f };
+			for (unsigned int j = 0; j < nblk; j += 8) {
+				float d[8];
+				for (int l = 0; l < 8; l++) d[l] = row[j + l] - ref[j + l];
+				for (int l = 0; l < 8; l++) {
+					bin[j + l] += d[l];
+					sq[l] += d[l] * d[l];
+				}
+				for (int l = 0; l < 4; l++) cr[l] += d[2 * l] * d[2 * l + 1];
+			}
+			for (unsigned int j = nblk; j < nf; j += 2) {
+				float dr = row[j] - ref[j], di = row[j + 1] - ref[j + 1];
+				bin[j] += dr;
+				bin[j + 1] += di;
+				sq[0] += dr * dr;
+				sq[1] += di * di;
+				cr[0] += dr * di;
+			}
+			sxx += (double)sq[0] + sq[2] + sq[4] + sq[6];
+			syy += (double)sq[1] + sq[3] + sq[5] + sq[7];
+			sxy += (double)cr[0] + cr[1] + cr[2] + cr[3];
+		}
+		Sxx[rindex] = sxx;
+		Syy[rindex] = syy;
+		Sxy[rindex] = sxy;
+
+		// Means follow from the sums
+		double mr = 0.0, mi = 0.0;
+		for (unsigned int k = 0; k < nr; k++) {
+			double br = ref[2 * k] + bin[2 * k] / nwri, bi = ref[2 * k + 1] + bin[2 * k + 1] / nwri;
+			DCOffsetWRI[rindex][k] = RTPComplex((float)br, (float)bi);
+			mr += br;
+			mi += bi;
+		}
+		DCOffset[rindex] = RTPComplex((float)(mr / nr), (float)(mi / nr));
+	}
+}
+
+void CalData::calStatistics(bool RangeDep)
+{
+	blockStatistics(&pCalData[0], Params.Num_WRI, RangeDep);
+}
+
+// The 2 by 2 covariance of I and Q from the moments of the last calStatistics pass.  With RangeDep
+// it is about the fading memory mean of each range sample, otherwise about the fading memory DC
+// offset (as covarianceSingleMean).  Both are updated after the pass.  The means of the pass itself
+// would take a degree of freedom from each range sample, all of them with a block of one WRI.
+void CalData::covarianceFromMoments(bool RangeDep)
+{
+	const unsigned int nr = Params.Samp_Per_WRI, nwri = StatWRI;
+	const double n = (double)nr * nwri;
+	for (unsigned int rindex = 0; rindex < Params.NumSensorsSet; rindex++) {
+		const float *ref = &RefRow[rindex * 2 * nr];
+		const double *bin = &BinSum[rindex * 2 * nr];
+		double cxx, cyy, cxy;
+		if (RangeDep) {
+			// Each sample's sums are about ref, so move them to the history: sum (d - s)^2 = sum d^2 - 2 s sum d + nwri s^2
+			const RTPComplex *hist = DCOffsetWRIHist[rindex];
+			auto shift = [&](unsigned int k, double &sxx, double &syy, double &sxy) {
+				double sr = (double)hist[k].real() - ref[2 * k], si = (double)hist[k].imag() - ref[2 * k + 1];
+				sxx = nwri * sr * sr - 2.0 * sr * bin[2 * k];
+				syy = nwri * si * si - 2.0 * si * bin[2 * k + 1];
+				sxy = nwri * sr * si - sr * bin[2 * k + 1] - si * bin[2 * k];
+			};
+			double bxx = 0.0, byy = 0.0, bxy = 0.0;
+			for (unsigned int k = 0; k < nr; k++) {
+				double sxx, syy, sxy;
+				shift(k, sxx, syy, sxy);
+				bxx += sxx;
+				byy += syy;
+				bxy += sxy;
+			}
+			cxx = (Sxx[rindex] + bxx) / n;
+			cyy = (Syy[rindex] + byy) / n;
+			cxy = (Sxy[rindex] + bxy) / n;
+
+			// Same again over each sub-band
+			const double *mxx = &BinMom[rindex * 3 * nr], *myy = mxx + nr, *mxy = myy + nr;
+			for (int b = 0; b < NumBands; b++) {
+				unsigned int k0 = b * BandWidth, k1 = MIN(k0 + BandWidth, nr);
+				double pxx = 0.0, pyy = 0.0, pxy = 0.0;
+				for (unsigned int k = k0; k < k1; k++) {
+					double sxx, syy, sxy;
+					shift(k, sxx, syy, sxy);
+					pxx += mxx[k] + sxx;
+					pyy += myy[k] + syy;
+					pxy += mxy[k] + sxy;
+				}
+				double nb = (double)nwri * (k1 - k0);
+				floatdim4 &Rb = RBand[rindex * NumBands + b];
+				Rb.value[0] = (float)(pxx / nb);
+				Rb.value[1] = Rb.value[2] = (float)(pxy / nb);
+				Rb.value[3] = (float)(pyy / nb);
+			}
+		}
+		else {
+			double dr = 0.0, di = 0.0;		// Mean of the data less the reference
+			for (unsigned int k = 0; k < nr; k++) {
+				dr += bin[2 * k];
+				di += bin[2 * k + 1];
+			}
+			dr /= n;
+			di /= n;
+			double sr = (double)DCOffsetHist[rindex].real() - ref[0], si = (double)DCOffsetHist[rindex].imag() - ref[1];
+			cxx = Sxx[rindex] / n - 2.0 * sr * dr + sr * sr;
+			cyy = Syy[rindex] / n - 2.0 * si * di + si * si;
+			cxy = Sxy[rindex] / n - sr * di - si * dr + sr * si;
+		}
+		R[rindex].value[0] = (float)cxx;
+		R[rindex].value[1] = (float)cxy;
+		R[rindex].value[2] = (float)cxy;
+		R[rindex].value[3] = (float)cyy;
+	}
+}
+
+// Compare the single pass statistics with the separate pass routines on synthetic data the size of
+// the CPI: time for each and the difference from a double precision calculation.  Run at start up
+// when CalBenchmark is set.  It uses the calibration buffers, so it has to run before the cal thread.
+void CalData::benchmarkStatistics()
+{
+	const unsigned int nsamp = Params.Samp_Per_WRI * Params.Num_WRI;
+	const int reps = 20;
+	unsigned int seed = 12345;
+	for (unsigned int rindex = 0; rindex < Params.NumSensorsSet; rindex++) {
+		// Large DC offset, unequal I and Q gain and some correlation between them
+		for (unsigned int i = 0; i < nsamp; i++) {
+			float u[2];
+			for (int k = 0; k < 2; k++) {
+				seed = seed * 1664525u + 1013904223u;
+				u[k] = (float)(seed >> 8) / 16777216.0f - 0.5f;
+			}
+			pCalData[rindex][i] = RTPComplex(0.3f + 0.01f*u[0], -0.2f + 0.012f*u[1] + 0.004f*u[0]);
+		}
+		DCOffsetHist[rindex] = RTPComplex(0.3f, -0.2f);
+		for (unsigned int k = 0; k < Params.Samp_Per_WRI; k++) DCOffsetWRIHist[rindex][k] = DCOffsetHist[rindex];
+	}
+
+	// Double precision covariance about DCOffsetHist for the first radar
+	double ref[3] = { 0.0, 0.0, 0.0 };
+	for (unsigned int i = 0; i < nsamp; i++) {
+		double dr = (double)pCalData[0][i].real() - DCOffsetHist[0].real(), di = (double)pCalData[0][i].imag() - DCOffsetHist[0].imag();
+		ref[0] += dr * dr;
+		ref[1] += dr * di;
+		ref[2] += di * di;
+	}
+	for (int k = 0; k < 3; k++) ref[k] /= nsamp;
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	for (int rep = 0; rep < reps; rep++) {
+		complexMean();
+		covarianceSingleMean();
+		complexMeanColumns3D();
+		covarianceRangeDepMean();
+	}
+	double toldms = 1000.0 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / reps;
+	covarianceSingleMean();
+	float Rold[3] = { R[0].value[0], R[0].value[1], R[0].value[3] };
+
+	t0 = std::chrono::steady_clock::now();
+	for (int rep = 0; rep < reps; rep++) {
+		calStatistics(false);
+		covarianceFromMoments(false);
+		calStatistics(true);
+		covarianceFromMoments(true);
+	}
+	double tnewms = 1000.0 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / reps;
+	calStatistics(false);
+	covarianceFromMoments(false);
+	float Rnew[3] = { R[0].value[0], R[0].value[1], R[0].value[3] };
+
+	double errold = 0.0, errnew = 0.0;
+	for (int k = 0; k < 3; k++) {
+		errold = MAX(errold, fabs(Rold[k] - ref[k]) / ref[0]);
+		errnew = MAX(errnew, fabs(Rnew[k] - ref[k]) / ref[0]);
+	}
+	log_message("Cal statistics benchmark, %u samples x %u radars: separate passes %.3f ms, single pass %.3f ms. Covariance error %.2e and %.2e",
+		nsamp, Params.NumSensorsSet, toldms, tnewms, errold, errnew);
+}
+
 // Calculate the complex mean of the data array.  Data is interleaved real/imaginary
 // 
 void CalData::complexMean()
@@ -227,7 +455,8 @@ int CalData::whitenTransformEigen()
 // the scaled inverse for use as a whitening transform.  THe scaling maintains a gain
 // of 1 as the original real component is transformed into the whitened output.
 //whitenTransformCholesky(&Rhist[0], &CalXform[0], NumSensorsSet);
-int CalData::whitenTransformCholesky()
+// choleskyWhiten does one 2 by 2 covariance, returning 1 if it isn't positive definite.
+static int choleskyWhiten(const floatdim4 &Cov, floatdim4 &Xform)
 {
 	//float det, ev1, ev2;
 	//float v11, v12, v21, v22;
@@ -238,45 +467,50 @@ int CalData::whitenTransformCholesky()
 	float L11, L12, L21, L22;
 	float A11, A12, A21, A22;
 
-	for (unsigned int rindex = 0; rindex < Params.NumSensorsSet; rindex++)
-	{
-		a = Rhist[rindex].value[0];
-		b = Rhist[rindex].value[1];
-		c = Rhist[rindex].value[3];
-
-		det = a * c - b * b;	// Determinant
-
-		if ((det > 0.0) && (a > 0.0f) && (c > 0.0f)) { // Verify that it is positive definite matrix
-			// Check for b=0
-			if (b == 0.0f) {  // This is the same for Cholesky or for Eigen
-				CalXform[rindex].value[1] = 0.0f;
-				CalXform[rindex].value[2] = 0.0f;
-				CalXform[rindex].value[3] = sqrtf(a / c);  // Since positive definite check already done, c is not 0
-				CalXform[rindex].value[0] = 1.0f;
-			}
-			else {
-				// Form the cholesky factor 
-				L11 = sqrtf(a);
-				L12 = b / L11;
-				L21 = 0.0f;
-				L22 = sqrtf(c - L12 * L12);
-
+	a = Cov.value[0];
+	b = Cov.value[1];
+	c = Cov.value[3];
 
-				// Then the inverse of the Cholesky factor.  
-				A11 = 1.0f / L11;
-				A12 = -L12 / (L11*L22);
-				A21 = 0.0f;
-				A22 = 1.0f / L22;
-
-				// Normalize gain on real channel.
-				CalXform[rindex].value[1] = 0.0f;
-				CalXform[rindex].value[2] = A12 / A11;
-				CalXform[rindex].value[3] = A22 / A11;  // Since positive definite check already done, c is not 0
-				CalXform[rindex].value[0] = 1.0f;
-			}
+	det = a * c - b * b;	// Determinant
 
+	if ((det > 0.0) && (a > 0.0f) && (c > 0.0f)) { // Verify that it is positive definite matrix
+		// Check for b=0
+		if (b == 0.0f) {  // This is the same for Cholesky or for Eigen
+			Xform.value[1] = 0.0f;
+			Xform.value[2] = 0.0f;
+			Xform.value[3] = sqrtf(a / c);  // Since positive definite check already done, c is not 0
+			Xform.value[0] = 1.0f;
 		}
 		else {
+			// Form the cholesky factor 
+			L11 = sqrtf(a);
+			L12 = b / L11;
+			L21 = 0.0f;
+			L22 = sqrtf(c - L12 * L12);
+
+
+			// Then the inverse of the Cholesky factor.  
+			A11 = 1.0f / L11;
+			A12 = -L12 / (L11*L22);
+			A21 = 0.0f;
+			A22 = 1.0f / L22;
+
+			// Normalize gain on real channel.
+			Xform.value[1] = 0.0f;
+			Xform.value[2] = A12 / A11;
+			Xform.value[3] = A22 / A11;  // Since positive definite check already done, c is not 0
+			Xform.value[0] = 1.0f;
+		}
+		return(0);
+	}
+	return(1);
+}
+
+int CalData::whitenTransformCholesky()
+{
+	for (unsigned int rindex = 0; rindex < Params.NumSensorsSet; rindex++)
+	{
+		if (choleskyWhiten(Rhist[rindex], CalXform[rindex]) != 0) {
 			log_message("Warning: Problem!!! Non positive definite covariance in whitenTransformCholesky cal routine");
 			return(1);
 		}
@@ -285,6 +519,26 @@ int CalData::whitenTransformCholesky()
 
 }
 
+// Fading memory and whitening transform for each sub-band.  A sub-band with too little signal to give
+// a positive definite covariance uses the transform of the whole radar, so it runs after whitenTransformCholesky.
+void CalData::updateBands()
+{
+	float fadeVal = this->FadeMemVal;
+	for (unsigned int i = 0; i < Params.NumSensorsSet * NumBands; i++) {
+		if (CalCount == 0) RhistBand[i] = RBand[i];
+		else {
+			RhistBand[i].value[0] = fadeVal * RhistBand[i].value[0] + (1.0f - fadeVal)*RBand[i].value[0];
+			RhistBand[i].value[3] = fadeVal * RhistBand[i].value[3] + (1.0f - fadeVal)*RBand[i].value[3];
+			RhistBand[i].value[1] = fadeVal * RhistBand[i].value[1] + (1.0f - fadeVal)*RBand[i].value[1];
+			RhistBand[i].value[2] = RhistBand[i].value[1];
+		}
+		if (choleskyWhiten(RhistBand[i], CalXformBand[i]) != 0) {
+			CalXformBand[i] = CalXform[i / NumBands];
+			BandFailures++;
+		}
+	}
+}
+
 
 void CalData::FadeMemAveDCSingle()
 {
@@ -315,7 +569,6 @@ void CalData::DCAveSingle()
 	}
 
 	int curHist = (this->CalCount >= Nhist) ? Nhist : this->CalCount + 1;
-	std::vector<RTPComplex> DCOffsetAve(NumSensorsSet);
 	for (int rindex = 0; rindex < NumSensorsSet; rindex++) {	// Initialize to zero
 		DCOffsetAve[rindex] = RTPComplex(0.0f, 0.0f);
 	}
@@ -327,7 +580,7 @@ void CalData::DCAveSingle()
 	}
 
 	for ( int rindex = 0; rindex < NumSensorsSet; rindex++) {	// Scale it properly
-		DCOffsetAve[rindex] *= RTPComplex(1.0f / (float)(curHist + 1), 0.0f);
+		DCOffsetAve[rindex] *= RTPComplex(1.0f / (float)curHist, 0.0f);
 	}
 
 }
@@ -343,202 +596,238 @@ void CalData::FadeMemAveDCWRI()
 
 }
 
-void CalData::CalibrateFunction(int bob)
-// This thread calculates the calibration of the radars in the background
-// It is kicked off with a new data set every so often.  The statistics from the
-// new data set are fading memory averaged with the statistics from previous data
-// sets prior to calculating the cal coefficients
+// Initialize the historical values using what was passed in (initializeCal) for the DC Offset
+void CalData::initHistory()
 {
-	int index, rindex;
-	index = bob; // To do something
-	// Copy some values, just to save typing
+	int rindex;
 	int NumSensorsSet = this->Params.NumSensorsSet;
-	int NWRI = Params.Num_WRI;
 	int NPerWRI = this->Params.Samp_Per_WRI;
-	bool DCOnly = this->CalDCOnly;
-	//int count = 1;
-	this->CalCount = 0;
-	const int Nhist = 50; // Number of points to save history
-	float fadeVal = this->FadeMemVal;
-
-	bool initHist = false;	// Whether the history has been initialized
-
-	log_message("Calibration thread is started.");
-	
-	// Initialize the historical values using what was passed into the function for the DC Offset
-	if ((!initHist)) {
-		log_message("Initialize Calibration History.");
-		for (rindex = 0; rindex < NumSensorsSet; rindex++) {
-			DCOffsetHist[rindex] = this->DCOffset[rindex];  // Initialize to the saved means
-		// The following is useful for testing - this will ignore the DCoffset value from the ini file
-		//	DCOffsetHist[rindex] = RTPComplex(0.0f, 0.0f);  // Zero the history.
-		// The following initialize the covariance history to a very small value so it is ignored
-			Rhist[rindex].value[0] = 1.0e-12f;
-			Rhist[rindex].value[1] = 0.0f;
-			Rhist[rindex].value[2] = 0.0f;
-			Rhist[rindex].value[3] = 1.0e-12f;
-			R[rindex] = Rhist[rindex];
-		}
-
-		// This currently resets the calculation of the covariance matrix for the WRI based approach. No historical value is passed in.
-
-		// This assumes only a single covariance history value per sensor. Otherwise, use rindex < NumSensorsSet*Nhist
-		for (int rindex = 0; rindex < NumSensorsSet; rindex++)
-			for (int index = 0; index < NPerWRI; index++) {
-				DCOffsetWRI[rindex][index] = RTPComplex(0.0f, 0.0f);
-				DCOffsetWRIHist[rindex][index] = RTPComplex(0.0f, 0.0f);
-			}
-
-		initHist = true;
+	if (this->WarmStart) {
+		log_message("Calibration history is from the saved state.");
+		return;
+	}
+	log_message("Initialize Calibration History.");
+	for (rindex = 0; rindex < NumSensorsSet; rindex++) {
+		DCOffsetHist[rindex] = this->DCOffset[rindex];  // Initialize to the saved means
+	// The following is useful for testing - this will ignore the DCoffset value from the ini file
+	//	DCOffsetHist[rindex] = RTPComplex(0.0f, 0.0f);  // Zero the history.
+	// The following initialize the covariance history to a very small value so it is ignored
+		Rhist[rindex].value[0] = 1.0e-12f;
+		Rhist[rindex].value[1] = 0.0f;
+		Rhist[rindex].value[2] = 0.0f;
+		Rhist[rindex].value[3] = 1.0e-12f;
+		R[rindex] = Rhist[rindex];
+	}
+	for (int i = 0; i < NumSensorsSet * NumBands; i++) {
+		RhistBand[i] = Rhist[i / NumBands];
+		RBand[i] = RhistBand[i];
 	}
 
-	while (TRUE)
-	{
-		// Grab the calibration data buffer
-		std::unique_lock<std::mutex> bufferlock(this->OwnBuffers);
-		// Wait for results to be ready or for request that this function be stopped.		
-		while (!this->InBufferFull && !this->StopRequested) {
-			/*std::cv_status cvstat =*/ this->DataHere.wait_for(bufferlock, std::chrono::milliseconds(100));
-		}
-		if (this->StopRequested == TRUE) break; // stop flag
-		this->InBufferFull = FALSE;
-
-		//pData = (RTPComplex**)this->pCalData;  // Point to the current calibration data
-
-		if (DCOnly) {
+	// This currently resets the calculation of the covariance matrix for the WRI based approach. No historical value is passed in.
 
-			this->complexMean(); // calculate mean and store in local DCOffset variable
+	// This assumes only a single covariance history value per sensor. Otherwise, use rindex < NumSensorsSet*Nhist
+	for (int rindex = 0; rindex < NumSensorsSet; rindex++)
+		for (int index = 0; index < NPerWRI; index++) {
+			DCOffsetWRI[rindex][index] = RTPComplex(0.0f, 0.0f);
+			DCOffsetWRIHist[rindex][index] = RTPComplex(0.0f, 0.0f);
+		}
+	this->CalCount = 0;
+}
 
-			// The following is the single DC offset for all ranges approach to calibration
-			if (!gRadarConfig.ReceiveRealOnly) {
+// Fold the statistics of the latest calStatistics or blockStatistics pass into the fading memory
+// history and update the calibration coefficients.
+void CalData::updateCal()
+{
+	int rindex;
+	// Copy some values, just to save typing
+	int NumSensorsSet = this->Params.NumSensorsSet;
+	int NPerWRI = this->Params.Samp_Per_WRI;
+	float fadeVal = this->FadeMemVal;
 
-				//	std::cout << "DC Off: " << DCOffset[0] << ", Hist: " << DCOffsetHist[0] << std::endl;
-				// This is method 1 for determining DC offset with a fading memory
-				FadeMemAveDCSingle();
+	if (this->CalDCOnly) {
 
+		// The following is the single DC offset for all ranges approach to calibration
+		if (!gRadarConfig.ReceiveRealOnly) {
 
-				covarianceSingleMean();
-				if (this->CalCount == 0) Rhist = R; // If the first time through, then initialize the fading memory history to the current estimate
+			//	std::cout << "DC Off: " << DCOffset[0] << ", Hist: " << DCOffsetHist[0] << std::endl;
+			// This is method 1 for determining DC offset with a fading memory
+			FadeMemAveDCSingle();
 
-				if (this->CalCount < 20) { // Make the filter very responsive at startup
-					float fval = 0.5;
-					for (rindex = 0; rindex < NumSensorsSet; rindex++) {
-						Rhist[rindex].value[0] = fval * Rhist[rindex].value[0] + (1.0f - fval)*R[rindex].value[0];
-						Rhist[rindex].value[3] = fval * Rhist[rindex].value[3] + (1.0f - fval)*R[rindex].value[3];
-						Rhist[rindex].value[1] = fval * Rhist[rindex].value[1] + (1.0f - fval)*R[rindex].value[1];
-						Rhist[rindex].value[2] = Rhist[rindex].value[1];
-					}
-				}
 
-				else
+			covarianceFromMoments(false);
+			if (this->CalCount == 0) Rhist = R; // If the first time through, then initialize the fading memory history to the current estimate
 
-				{
-					for (rindex = 0; rindex < NumSensorsSet; rindex++) {
-						Rhist[rindex].value[0] = fadeVal * Rhist[rindex].value[0] + (1.0f - fadeVal)*R[rindex].value[0];
-						Rhist[rindex].value[3] = fadeVal * Rhist[rindex].value[3] + (1.0f - fadeVal)*R[rindex].value[3];
-						Rhist[rindex].value[1] = fadeVal * Rhist[rindex].value[1] + (1.0f - fadeVal)*R[rindex].value[1];
-						Rhist[rindex].value[2] = Rhist[rindex].value[1];
-					}
+			if (this->CalCount < StartCount) { // Make the filter very responsive at startup
+				float fval = StartFade;
+				for (rindex = 0; rindex < NumSensorsSet; rindex++) {
+					Rhist[rindex].value[0] = fval * Rhist[rindex].value[0] + (1.0f - fval)*R[rindex].value[0];
+					Rhist[rindex].value[3] = fval * Rhist[rindex].value[3] + (1.0f - fval)*R[rindex].value[3];
+					Rhist[rindex].value[1] = fval * Rhist[rindex].value[1] + (1.0f - fval)*R[rindex].value[1];
+					Rhist[rindex].value[2] = Rhist[rindex].value[1];
 				}
-				//std::cout << "Cov: " << R[0].value[0] << "," << R[0].value[1] << "," << R[0].value[3]  <<
-				//	", Hist: " << Rhist[0].value[0] << "," << Rhist[0].value[1] << "," << Rhist[0].value[3]  << std::endl;
+			}
 
-				//whitenTransformEigen();
-				int stat = whitenTransformCholesky();
-				if (stat == 0) {
-					for (rindex = 0; rindex < NumSensorsSet; rindex++) {
+			else
 
-						this->CalXform[rindex] = CalXform[rindex];
-						this->DCOffset[rindex] = DCOffsetHist[rindex];
-					}
+			{
+				for (rindex = 0; rindex < NumSensorsSet; rindex++) {
+					Rhist[rindex].value[0] = fadeVal * Rhist[rindex].value[0] + (1.0f - fadeVal)*R[rindex].value[0];
+					Rhist[rindex].value[3] = fadeVal * Rhist[rindex].value[3] + (1.0f - fadeVal)*R[rindex].value[3];
+					Rhist[rindex].value[1] = fadeVal * Rhist[rindex].value[1] + (1.0f - fadeVal)*R[rindex].value[1];
+					Rhist[rindex].value[2] = Rhist[rindex].value[1];
 				}
-				else log_message("Calibration error: not updating coefficients this cycle");
-
 			}
-			else {
+			//std::cout << "Cov: " << R[0].value[0] << "," << R[0].value[1] << "," << R[0].value[3]  <<
+			//	", Hist: " << Rhist[0].value[0] << "," << Rhist[0].value[1] << "," << Rhist[0].value[3]  << std::endl;
+
+			//whitenTransformEigen();
+			int stat = whitenTransformCholesky();
+			if (stat == 0) {
 				for (rindex = 0; rindex < NumSensorsSet; rindex++) {
-					this->CalXform[rindex].value[0] = 1.0; // Gain and correlation default cal constants;
-					this->CalXform[rindex].value[1] = 0.0;
-					this->CalXform[rindex].value[2] = 0.0;
-					this->CalXform[rindex].value[3] = 1.0;
+
+					this->CalXform[rindex] = CalXform[rindex];
 					this->DCOffset[rindex] = DCOffsetHist[rindex];
 				}
 			}
+			else log_message("Calibration error: not updating coefficients this cycle");
+
 		}
 		else {
-			// This will do a DC offset per range bin. Needed when there is large mutual coupling between transmit and receive
-
-			complexMeanColumns3D(); // calculate mean and store in local DCOffset variable
-			/* if ( (calcount % 5 == 0)) {
-					log_message("Using per sample DC offset");
-					std::cout << "Cal Count: " << calcount << " DC_OffsetArr = ";
-					for (int nnn = 0; nnn < NPerWRI; nnn++)
-						std::cout << DCOffsetWRI[nnn];
-					std::cout << std::endl;
-				}
-				*/
-			if (CalCount == 0) { // Do a brute force initialization of DC Offset history
-				for (int index = 0; index < NumSensorsSet*NPerWRI; index++) {
-					DCOffsetWRIHist[index] = DCOffsetWRI[index];
-				}
+			for (rindex = 0; rindex < NumSensorsSet; rindex++) {
+				this->CalXform[rindex].value[0] = 1.0; // Gain and correlation default cal constants;
+				this->CalXform[rindex].value[1] = 0.0;
+				this->CalXform[rindex].value[2] = 0.0;
+				this->CalXform[rindex].value[3] = 1.0;
+				this->DCOffset[rindex] = DCOffsetHist[rindex];
+			}
+		}
+	}
+	else {
+		// This will do a DC offset per range bin. Needed when there is large mutual coupling between transmit and receive
+
+		/* if ( (calcount % 5 == 0)) {
+				log_message("Using per sample DC offset");
+				std::cout << "Cal Count: " << calcount << " DC_OffsetArr = ";
+				for (int nnn = 0; nnn < NPerWRI; nnn++)
+					std::cout << DCOffsetWRI[nnn];
+				std::cout << std::endl;
 			}
-			if (!gRadarConfig.ReceiveRealOnly) {
+			*/
+		if (CalCount == 0) { // Do a brute force initialization of DC Offset history
+			for (rindex = 0; rindex < NumSensorsSet; rindex++)
+				for (int index = 0; index < NPerWRI; index++)
+					DCOffsetWRIHist[rindex][index] = DCOffsetWRI[rindex][index];
+		}
+		// A block of one WRI has no spread about its own mean, so the first one only starts the DC offset history
+		const int FirstCov = (StatWRI < 2) ? 1 : 0;
+		if (CalCount < FirstCov) {
+		}
+		else if (!gRadarConfig.ReceiveRealOnly) {
 
 
-				FadeMemAveDCWRI();
+			FadeMemAveDCWRI();
 
 
-				covarianceRangeDepMean();
+			covarianceFromMoments(true);
 
-				if (CalCount == 0) { // Do a brute force initialization first time through
-					for (rindex = 0; rindex < NumSensorsSet; rindex++) {
-						/*Rhist[rindex][0] = R[rindex][0];
-						Rhist[rindex][3] = R[rindex][3];
-						Rhist[rindex][1] = R[rindex][1];
-						Rhist[rindex][2] = Rhist[rindex][1];*/
-						Rhist[rindex] = R[rindex];
-					}
+			if (CalCount == FirstCov) { // Do a brute force initialization first time through
+				for (rindex = 0; rindex < NumSensorsSet; rindex++) {
+					/*Rhist[rindex][0] = R[rindex][0];
+					Rhist[rindex][3] = R[rindex][3];
+					Rhist[rindex][1] = R[rindex][1];
+					Rhist[rindex][2] = Rhist[rindex][1];*/
+					Rhist[rindex] = R[rindex];
 				}
-				else {
-					for (rindex = 0; rindex < NumSensorsSet; rindex++) {
-						Rhist[rindex].value[0] = fadeVal * Rhist[rindex].value[0] + (1.0f - fadeVal)*R[rindex].value[0];
-						Rhist[rindex].value[3] = fadeVal * Rhist[rindex].value[3] + (1.0f - fadeVal)*R[rindex].value[3];
-						Rhist[rindex].value[1] = fadeVal * Rhist[rindex].value[1] + (1.0f - fadeVal)*R[rindex].value[1];
-						Rhist[rindex].value[2] = Rhist[rindex].value[1];
-					}
+			}
+			else {
+				for (rindex = 0; rindex < NumSensorsSet; rindex++) {
+					Rhist[rindex].value[0] = fadeVal * Rhist[rindex].value[0] + (1.0f - fadeVal)*R[rindex].value[0];
+					Rhist[rindex].value[3] = fadeVal * Rhist[rindex].value[3] + (1.0f - fadeVal)*R[rindex].value[3];
+					Rhist[rindex].value[1] = fadeVal * Rhist[rindex].value[1] + (1.0f - fadeVal)*R[rindex].value[1];
+					Rhist[rindex].value[2] = Rhist[rindex].value[1];
 				}
-
-				int stat = whitenTransformCholesky();
-				if (stat == 0) {
-					std::vector<RTPComplex> temp_mean(NumSensorsSet);
-					for (index = 0; index < NumSensorsSet; index++)
-						temp_mean[index] = RTPComplex(0.0f, 0.0f);
-					for (rindex = 0; rindex < NumSensorsSet; rindex++) {
-						this->CalXform[rindex] = CalXform[rindex];
-						for (int samp_index = 0; samp_index < NPerWRI; samp_index++) {
-							this->pOffsetsdat[rindex][samp_index] = DCOffsetWRIHist[rindex][samp_index];
-							temp_mean[rindex] += DCOffsetWRIHist[rindex][samp_index];
-						}
-						this->DCOffset[rindex] = temp_mean[rindex] * (1.0f / ((float)NPerWRI));  // Calculate mean
+			}
+			int stat = whitenTransformCholesky();
+			if (NumBands > 0) updateBands();
+			if (stat == 0) {
+				for (rindex = 0; rindex < NumSensorsSet; rindex++) {
+					RTPComplex temp_mean(0.0f, 0.0f);
+					this->CalXform[rindex] = CalXform[rindex];
+					for (int samp_index = 0; samp_index < NPerWRI; samp_index++) {
+						this->pOffsetsdat[rindex][samp_index] = DCOffsetWRIHist[rindex][samp_index];
+						temp_mean += DCOffsetWRIHist[rindex][samp_index];
 					}
+					this->DCOffset[rindex] = temp_mean * (1.0f / ((float)NPerWRI));  // Calculate mean
 				}
+			}
+			if ((CalCount % LogEvery) == 0)
 				std::cout << "Cov: " << R[0].value[0] << "," << R[0].value[1] << "," << R[0].value[3] <<
 					", Hist: " << Rhist[0].value[0] << "," << Rhist[0].value[1] << "," << Rhist[0].value[3] <<
 					"\n  DC vals:" << DCOffsetWRI[0] << DCOffsetWRIHist[0] << ", " << this->DCOffset[0] << std::endl;
-
+			if ((NumBands > 0) && ((CalCount % LogEvery) == 0) && (BandFailures > 0)) {
+				log_message("Calibration: %lu sub-band covariances were not positive definite, used the radar's transform", BandFailures);
+				BandFailures = 0;
 			}
-			else {
-				for (rindex = 0; rindex < NumSensorsSet; rindex++) {
-					this->CalXform[rindex].value[0] = 1.0; // Gain and correlation default cal constants;
-					this->CalXform[rindex].value[1] = 0.0;
-					this->CalXform[rindex].value[2] = 0.0;
-					this->CalXform[rindex].value[3] = 1.0;
-					this->DCOffset[rindex] = DCOffsetHist[rindex];
-				}
+
+		}
+		else {
+			for (rindex = 0; rindex < NumSensorsSet; rindex++) {
+				this->CalXform[rindex].value[0] = 1.0; // Gain and correlation default cal constants;
+				this->CalXform[rindex].value[1] = 0.0;
+				this->CalXform[rindex].value[2] = 0.0;
+				this->CalXform[rindex].value[3] = 1.0;
+				this->DCOffset[rindex] = DCOffsetHist[rindex];
 			}
 		}
-		this->CalCount++;
-		//= calcount;
+	}
+	this->CalCount++;
+
+	// Save once settled, and every CalSaveInterval after that
+	if (!StateFile.empty() && (CalCount >= StartCount) && (gRadarConfig.CalSaveInterval > 0.0)) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now >= NextSave) {
+			if (StateWriter.joinable()) queueSave();
+			else saveState();
+			NextSave = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(gRadarConfig.CalSaveInterval));
+		}
+	}
+}
+
+// Streaming calibration.  Called by the dispatch loop with each new block of data as it arrives, so the
+// calibration follows drift smoothly instead of jumping every few seconds.  The fading memory constants
+// are scaled in initializeCal so the memory is the same length in time as with whole CPIs.
+void CalData::updateBlock(const RTPComplex * const Block[], unsigned int NumWRI)
+{
+	blockStatistics(Block, NumWRI, !this->CalDCOnly);
+	updateCal();
+	this->Cal_ready = TRUE;
+}
+
+void CalData::CalibrateFunction(int bob)
+// This thread calculates the calibration of the radars in the background
+// It is kicked off with a new data set every so often.  The statistics from the
+// new data set are fading memory averaged with the statistics from previous data
+// sets prior to calculating the cal coefficients
+{
+	setThreadRole(ThreadCal);
+	log_message("Calibration thread is started.");
+	initHistory();
+
+	while (TRUE)
+	{
+		// Grab the calibration data buffer
+		std::unique_lock<std::mutex> bufferlock(this->OwnBuffers);
+		// Wait for results to be ready or for request that this function be stopped.		
+		while (!this->InBufferFull && !this->StopRequested) {
+			/*std::cv_status cvstat =*/ this->DataHere.wait_for(bufferlock, std::chrono::milliseconds(100));
+		}
+		if (this->StopRequested == TRUE) break; // stop flag
+		this->InBufferFull = FALSE;
+
+		calStatistics(!this->CalDCOnly); // calculate means and moments
+		updateCal();
+
 		// Notify calling thread that results are ready
 		this->Cal_ready = TRUE;
 		// pRadarCalData->Cal_ready = FALSE;
@@ -547,10 +836,15 @@ void CalData::CalibrateFunction(int bob)
 	}
 
 	// Drops through to here when signaled to stop
+	logFinal();
+	return;
+}
 
+void CalData::logFinal()
+{
 	std::ostringstream msg;
-	msg << "Calibration thread is exiting.\n                    Number of blocks processed is " << this->CalCount << "." << std::endl;
-	for (rindex = 0; rindex < NumSensorsSet; rindex++) {
+	msg << "Calibration is exiting.\n                    Number of blocks processed is " << this->CalCount << "." << std::endl;
+	for (int rindex = 0; rindex < (int) this->Params.NumSensorsSet; rindex++) {
 		msg << "                    Radar " << rindex << ", DC: " << this->DCOffset[rindex] << ", XForm: "
 			<< this->CalXform[rindex].value[0] << ", "
 			<< this->CalXform[rindex].value[1] << ", "
@@ -558,7 +852,218 @@ void CalData::CalibrateFunction(int bob)
 			<< this->CalXform[rindex].value[3] << std::endl;
 	}
 	log_message(msg.str());
-	return;
+	if (!StateFile.empty() && (CalCount >= StartCount)) saveState();
+}
+
+
+// Saved calibration state.  The header says what CPI shape it was made with, and a warm start only
+// uses it when that matches.  It is followed by the per radar DC offset and covariance histories, the
+// transforms and, for the range dependent cal, the per sample DC offset history and current values.
+typedef struct CalStateHeader {
+	char Magic[8];
+	unsigned int FormatVersion;
+	unsigned int NumSensors, SampPerWRI, NumWRI;
+	unsigned int DCOnly, RealOnly;
+	unsigned int NumBands;
+	int CalCount;
+	double SavedTime;					// Seconds since 1970 when saved
+	unsigned int PayloadBytes;
+	unsigned int Checksum;				// FNV-1a of the payload
+} CalStateHeader;
+
+static const char CalStateMagic[8] = "RTPCAL";
+static const unsigned int CalStateFormat = 2;
+
+static unsigned int calStateChecksum(const std::vector<char> &Buf)
+{
+	unsigned int h = 2166136261u;
+	for (size_t i = 0; i < Buf.size(); i++) h = (h ^ (unsigned char)Buf[i]) * 16777619u;
+	return h;
+}
+
+static void calStatePut(std::vector<char> &Buf, const void *Src, size_t Bytes)
+{
+	const char *p = (const char *)Src;
+	Buf.insert(Buf.end(), p, p + Bytes);
+}
+
+// The header and the state, as they go in the file
+void CalData::packState(std::vector<char> &File)
+{
+	unsigned int N = Params.NumSensorsSet, S = Params.Samp_Per_WRI;
+	std::vector<char> Buf;
+	Buf.reserve(N * (2 * sizeof(RTPComplex) + 2 * sizeof(floatdim4) + 2 * S * sizeof(RTPComplex)));
+	calStatePut(Buf, &DCOffsetHist[0], N * sizeof(RTPComplex));
+	calStatePut(Buf, &Rhist[0], N * sizeof(floatdim4));
+	calStatePut(Buf, &CalXform[0], N * sizeof(floatdim4));
+	calStatePut(Buf, &DCOffset[0], N * sizeof(RTPComplex));
+	if (!CalDCOnly) {
+		for (unsigned int rindex = 0; rindex < N; rindex++) calStatePut(Buf, DCOffsetWRIHist[rindex], S * sizeof(RTPComplex));
+		for (unsigned int rindex = 0; rindex < N; rindex++) calStatePut(Buf, pOffsetsdat[rindex], S * sizeof(RTPComplex));
+	}
+	if (NumBands > 0) {
+		calStatePut(Buf, &RhistBand[0], N * NumBands * sizeof(floatdim4));
+		calStatePut(Buf, &CalXformBand[0], N * NumBands * sizeof(floatdim4));
+	}
+
+	CalStateHeader Head;
+	memset(&Head, 0, sizeof(Head));
+	memcpy(Head.Magic, CalStateMagic, sizeof(Head.Magic));
+	Head.FormatVersion = CalStateFormat;
+	Head.NumSensors = N;
+	Head.SampPerWRI = S;
+	Head.NumWRI = Params.Num_WRI;
+	Head.DCOnly = CalDCOnly;
+	Head.RealOnly = gRadarConfig.ReceiveRealOnly;
+	Head.NumBands = NumBands;
+	Head.CalCount = CalCount;
+	Head.SavedTime = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+	Head.PayloadBytes = (unsigned int)Buf.size();
+	Head.Checksum = calStateChecksum(Buf);
+
+	File.clear();
+	calStatePut(File, &Head, sizeof(Head));
+	File.insert(File.end(), Buf.begin(), Buf.end());
+}
+
+// Write to a temporary file and rename it, so a crash while saving leaves the last good state
+int CalData::writeState(const std::vector<char> &File)
+{
+	std::string tmpname = StateFile + ".tmp";
+	FILE *fp = fopen(tmpname.c_str(), "wb");
+	if (fp == NULL) {
+		log_message("Warning: Unable to save the calibration state to '%s'", tmpname.c_str());
+		return 1;
+	}
+	size_t written = fwrite(File.data(), File.size(), 1, fp);
+	fclose(fp);
+	if (written != 1) {
+		log_message("Warning: Unable to write the calibration state to '%s'", tmpname.c_str());
+		remove(tmpname.c_str());
+		return 1;
+	}
+	remove(StateFile.c_str());		// Windows won't rename over an existing file
+	if (rename(tmpname.c_str(), StateFile.c_str()) != 0) {
+		log_message("Warning: Unable to rename the calibration state to '%s'", StateFile.c_str());
+		return 1;
+	}
+	return 0;
+}
+
+int CalData::saveState()
+{
+	std::vector<char> File;
+	packState(File);
+	return writeState(File);
+}
+
+// Copy the state for StateWriter, which does the file I/O off the dispatch thread
+void CalData::queueSave()
+{
+	std::vector<char> File;
+	packState(File);
+	std::unique_lock<std::mutex> lock(SaveLock);
+	SaveFile.swap(File);
+	SavePending = true;
+	lock.unlock();
+	SaveHere.notify_one();
+}
+
+// With the streaming calibration there is no calibration thread, so this stands in for it to save the state
+void CalData::startStateWriter()
+{
+	if (StateFile.empty() || (gRadarConfig.CalSaveInterval <= 0.0)) return;
+	SavePending = SaveStop = false;
+	StateWriter = std::thread(&CalData::StateWriterFunction, this);
+}
+
+// Anything still queued is written before it returns
+void CalData::stopStateWriter()
+{
+	if (!StateWriter.joinable()) return;
+	std::unique_lock<std::mutex> lock(SaveLock);
+	SaveStop = true;
+	lock.unlock();
+	SaveHere.notify_one();
+	StateWriter.join();
+}
+
+void CalData::StateWriterFunction()
+{
+	setThreadRole(ThreadCal);
+	std::vector<char> File;
+	std::unique_lock<std::mutex> lock(SaveLock);
+	while (TRUE) {
+		SaveHere.wait(lock, [this] { return SavePending || SaveStop; });
+		if (SavePending) {
+			File.swap(SaveFile);
+			SavePending = false;
+			lock.unlock();
+			writeState(File);
+			lock.lock();
+		}
+		else break;
+	}
+}
+
+// Returns 0 and sets WarmStart when the saved state was loaded.  Anything wrong with the file and the
+// calibration starts from the configuration values as before.
+int CalData::loadState()
+{
+	unsigned int N = Params.NumSensorsSet, S = Params.Samp_Per_WRI;
+	FILE *fp = fopen(StateFile.c_str(), "rb");
+	if (fp == NULL) {
+		log_message("No saved calibration state in '%s', starting the calibration from scratch", StateFile.c_str());
+		return 1;
+	}
+	CalStateHeader Head;
+	std::vector<char> Buf;
+	bool ok = (fread(&Head, sizeof(Head), 1, fp) == 1) && (memcmp(Head.Magic, CalStateMagic, sizeof(Head.Magic)) == 0)
+		&& (Head.FormatVersion == CalStateFormat);
+	if (ok) {
+		Buf.resize(Head.PayloadBytes);
+		ok = (Head.PayloadBytes == 0) || (fread(&Buf[0], Head.PayloadBytes, 1, fp) == 1);
+	}
+	fclose(fp);
+	if (!ok || (calStateChecksum(Buf) != Head.Checksum)) {
+		log_message("Warning: Saved calibration state in '%s' is not readable, starting the calibration from scratch", StateFile.c_str());
+		return 1;
+	}
+	if ((Head.NumSensors != N) || (Head.SampPerWRI != S) || (Head.NumWRI != Params.Num_WRI)
+		|| (Head.DCOnly != (unsigned int)CalDCOnly) || (Head.RealOnly != (unsigned int)gRadarConfig.ReceiveRealOnly)
+		|| (Head.NumBands != (unsigned int)NumBands)) {
+		log_message("Saved calibration state is for %u radars, %u x %u samples, DC only %u, %u sub-bands. Not used.",
+			Head.NumSensors, Head.SampPerWRI, Head.NumWRI, Head.DCOnly, Head.NumBands);
+		return 1;
+	}
+	size_t expect = N * (2 * sizeof(RTPComplex) + 2 * sizeof(floatdim4)) + (CalDCOnly ? 0 : 2 * N * S * sizeof(RTPComplex))
+		+ 2 * N * NumBands * sizeof(floatdim4);
+	if (Buf.size() != expect) {
+		log_message("Warning: Saved calibration state is the wrong size, starting the calibration from scratch");
+		return 1;
+	}
+
+	const char *p = Buf.data();
+	memcpy(&DCOffsetHist[0], p, N * sizeof(RTPComplex));	p += N * sizeof(RTPComplex);
+	memcpy(&Rhist[0], p, N * sizeof(floatdim4));			p += N * sizeof(floatdim4);
+	memcpy(&CalXform[0], p, N * sizeof(floatdim4));			p += N * sizeof(floatdim4);
+	memcpy(&DCOffset[0], p, N * sizeof(RTPComplex));		p += N * sizeof(RTPComplex);
+	if (!CalDCOnly) {
+		for (unsigned int rindex = 0; rindex < N; rindex++) { memcpy(DCOffsetWRIHist[rindex], p, S * sizeof(RTPComplex)); p += S * sizeof(RTPComplex); }
+		for (unsigned int rindex = 0; rindex < N; rindex++) { memcpy(pOffsetsdat[rindex], p, S * sizeof(RTPComplex)); p += S * sizeof(RTPComplex); }
+	}
+	if (NumBands > 0) {
+		memcpy(&RhistBand[0], p, N * NumBands * sizeof(floatdim4));	p += N * NumBands * sizeof(floatdim4);
+		memcpy(&CalXformBand[0], p, N * NumBands * sizeof(floatdim4));
+	}
+	R = Rhist;
+	CalCount = StartCount;		// Already settled, skip the fast start up updates
+	WarmStart = TRUE;
+	Cal_ready = TRUE;			// Have the dispatch loop publish it right away
+
+	double age = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count() - Head.SavedTime;
+	log_message("Calibration state loaded from '%s', saved %.1f minutes ago after %d updates", StateFile.c_str(), age / 60.0, Head.CalCount);
+	return 0;
 }
 
 
@@ -577,14 +1082,31 @@ int CalData::initializeCal(CPI_Params InParams)
 		
 
 		this->pCalData[rindex] = (RTPComplex*)
-			fftwf_malloc(sizeof(RTPComplex) * Params.Samp_Per_WRI*Params.Num_WRI);
+			gArena.take(sizeof(RTPComplex) * Params.Samp_Per_WRI*Params.Num_WRI, "cal data");
 		this->pOffsetsdat[rindex] = (RTPComplex*)
-			malloc(sizeof(fftwf_complex) * Params.Samp_Per_WRI);
-		if ((this->pCalData[rindex] == NULL) || (this->pOffsetsdat[rindex] == NULL)) {
-			log_message("Error %d: Can't allocate memory for data in processing thread, exiting", GetLastError());
-			exit(1L);
-		}
+			gArena.take(sizeof(RTPComplex) * Params.Samp_Per_WRI, "cal offsets");
 	}
+	this->RefRow.assign(2 * NumSensorsSet * Params.Samp_Per_WRI, 0.0f);
+	this->BinSum.assign(2 * NumSensorsSet * Params.Samp_Per_WRI, 0.0);
+	this->Sxx.assign(NumSensorsSet, 0.0);
+	this->Syy.assign(NumSensorsSet, 0.0);
+	this->Sxy.assign(NumSensorsSet, 0.0);
+
+	// Sub-band IQ correction.  Its work space is three doubles per range sample and two transforms per sub-band.
+	this->BandWidth = calBandWidth(Params.Samp_Per_WRI);
+	this->NumBands = (BandWidth > 0) ? (Params.Samp_Per_WRI + BandWidth - 1) / BandWidth : 0;
+	floatdim4 Ident;
+	Ident.value[0] = Ident.value[3] = 1.0f;
+	this->BinMom.assign((NumBands > 0) ? 3 * NumSensorsSet * Params.Samp_Per_WRI : 0, 0.0);
+	this->RBand.assign(NumSensorsSet * NumBands, Ident);
+	this->RhistBand.assign(NumSensorsSet * NumBands, Ident);
+	this->CalXformBand.assign(NumSensorsSet * NumBands, Ident);
+	this->BandFailures = 0;
+	if (NumBands > 0) log_message("Calibration IQ correction in %d sub-bands of %u range samples", NumBands, BandWidth);
+	else if ((gRadarConfig.CalSubBands > 0) && gRadarConfig.DC_CalOnly)
+		log_message("Warning: CalSubBands needs DC_CalOnly = false. Using one IQ correction per radar.");
+	if (gRadarConfig.CalBenchmark) benchmarkStatistics();
+
 	// Intitialize default calibration variables
 	for (rindex = 0; rindex < NumSensorsSet; rindex++) {
 		this->DCOffset[rindex] = RTPComplex((float) gRadarConfig.CalDCVal[2 * rindex], (float) gRadarConfig.CalDCVal[2 * rindex + 1]);
@@ -608,12 +1130,153 @@ int CalData::initializeCal(CPI_Params InParams)
 
 	this->CalDCOnly = gRadarConfig.DC_CalOnly;
 	this->FadeMemVal = (float)gRadarConfig.FadeMemVal;
+	this->StartFade = 0.5f;
+	this->StartCount = 20;
+	this->LogEvery = 1;
+	if (gRadarConfig.CalStreaming) {
+		// One update per block instead of per CPI.  Scale the fading memory so it lasts as long in time
+		// and the start up period covers as much data, but log only as often as before.
+		double ratio = (double)gRadarConfig.NWRIPerBlock / (double)Params.Num_WRI;
+		this->FadeMemVal = (float)pow(gRadarConfig.FadeMemVal, ratio);
+		this->StartFade = (float)pow(0.5, ratio);
+		this->StartCount = (int)(20.0 / ratio + 0.5);
+		this->LogEvery = 50;
+	}
 	this->Cal_ready = FALSE;
 	this->StopRequested = FALSE;
+	this->WarmStart = FALSE;
+
+	// Warm start from the last run's calibration, if there is one of the same shape.  Not in virtual time,
+	// where every run has to start from the same place.
+	this->StateFile.clear();
+	if (!gRadarConfig.CalStateFile.empty() && !gRadarConfig.VirtualTime)
+		this->StateFile = gRadarConfig.DataFileRoot + gRadarConfig.CalStateFile;
+	this->NextSave = std::chrono::steady_clock::now();
+	if (!this->StateFile.empty()) loadState();
 
 	return 0;
 }
 
+// Range samples per IQ correction sub-band, or 0 for one correction per radar.  Sub-bands need the
+// range dependent statistics, so they are only used without DC_CalOnly.
+unsigned int calBandWidth(unsigned int SampPerWRI)
+{
+	if ((gRadarConfig.CalSubBands <= 0) || (SampPerWRI == 0) || gRadarConfig.DC_CalOnly) return 0;
+	unsigned int bands = MIN((unsigned int)gRadarConfig.CalSubBands, SampPerWRI);
+	return (SampPerWRI + bands - 1) / bands;
+}
+
+int CalPublisher::initialize(CPI_Params Params, int NumThreads)
+{
+	NumSensors = Params.NumSensorsSet;
+	Samp_Per_WRI = Params.Samp_Per_WRI;
+	BandWidth = calBandWidth(Samp_Per_WRI);
+	ZeroDC = (gRadarConfig.MTIType != MTIOff);
+	NumSlots = NumThreads * gRadarConfig.BatchCPIs + 2;		// One for each CPI of each worker's batch, the current one and one to fill
+	Slots = new CalSnapshot[NumSlots];
+	for (int s = 0; s < NumSlots; s++) {
+		Slots[s].Readers = 0;
+		Slots[s].DCOffsetArr = (RTPComplex *)malloc(NumSensors * Samp_Per_WRI * sizeof(RTPComplex));
+		if (BandWidth > 0) Slots[s].XformBins = (float *)malloc(NumSensors * 4 * Samp_Per_WRI * sizeof(float));
+		if ((Slots[s].DCOffsetArr == NULL) || ((BandWidth > 0) && (Slots[s].XformBins == NULL))) {
+			log_message("Error %d: Can't allocate memory for calibration snapshots, exiting", GetLastError());
+			exit(9L);
+		}
+	}
+
+	// Version 0 is the configured calibration
+	CalSnapshot &First = Slots[0];
+	for (unsigned int rindex = 0; rindex < NumSensors; rindex++) {
+		First.DCOffset[rindex] = RTPComplex((float)gRadarConfig.CalDCVal[2 * rindex], (float)gRadarConfig.CalDCVal[2 * rindex + 1]);
+		First.CalXform[rindex] = gRadarConfig.CalTransForm[rindex];
+	}
+	for (unsigned int i = 0; i < NumSensors * Samp_Per_WRI; i++) First.DCOffsetArr[i] = RTPComplex(0.0f, 0.0f);
+	if (First.XformBins != NULL)
+		for (unsigned int rindex = 0; rindex < NumSensors; rindex++)
+			for (int v = 0; v < 4; v++)
+				for (unsigned int k = 0; k < Samp_Per_WRI; k++)
+					First.XformBins[(rindex * 4 + v) * Samp_Per_WRI + k] = First.CalXform[rindex].value[v];
+	if (ZeroDC) zeroDC(First);
+	First.Version = Version = 0;
+	Current.store(&First);
+	return 0;
+}
+
+// Called only by the dispatch thread.  DCOffsetArr can be NULL when only the single DC offset is used,
+// BandXform ([radar][sub-band]) when there are no sub-bands.
+void CalPublisher::publish(const RTPComplex DCOffset[], const floatdim4 CalXform[], RTPComplex * const DCOffsetArr[],
+	const floatdim4 BandXform[])
+{
+	CalSnapshot *cur = Current.load();
+	CalSnapshot *next = NULL;
+	for (int s = 0; (s < NumSlots) && (next == NULL); s++) {
+		if ((&Slots[s] != cur) && (Slots[s].Readers.load() == 0)) next = &Slots[s];
+	}
+	if (next == NULL) {		// Can't happen with a slot per worker, but don't overwrite one in use
+		log_message("Warning: No free calibration snapshot, not updating this cycle");
+		return;
+	}
+	for (unsigned int rindex = 0; rindex < NumSensors; rindex++) {
+		next->DCOffset[rindex] = DCOffset[rindex];
+		next->CalXform[rindex] = CalXform[rindex];
+		if (DCOffsetArr != NULL)
+			memcpy(&next->DCOffsetArr[rindex * Samp_Per_WRI], DCOffsetArr[rindex], Samp_Per_WRI * sizeof(RTPComplex));
+		else
+			for (unsigned int i = 0; i < Samp_Per_WRI; i++) next->DCOffsetArr[rindex * Samp_Per_WRI + i] = RTPComplex(0.0f, 0.0f);
+		if (next->XformBins != NULL) {
+			// Spread the sub-band transforms out to each sample so the workers don't have to look them up
+			unsigned int NumBands = (Samp_Per_WRI + BandWidth - 1) / BandWidth;
+			for (int v = 0; v < 4; v++) {
+				float *dst = &next->XformBins[(rindex * 4 + v) * Samp_Per_WRI];
+				for (unsigned int k = 0; k < Samp_Per_WRI; k++)
+					dst[k] = (BandXform != NULL) ? BandXform[rindex * NumBands + k / BandWidth].value[v] : CalXform[rindex].value[v];
+			}
+		}
+	}
+	if (ZeroDC) zeroDC(*next);
+	next->Version = ++Version;
+	Current.store(next);
+}
+
+// The MTI filters out the DC offset along with the clutter, so subtracting it again in the workers
+// would add it back.  The IQ transforms are still used.
+void CalPublisher::zeroDC(CalSnapshot &Snap)
+{
+	for (unsigned int rindex = 0; rindex < NumSensors; rindex++) Snap.DCOffset[rindex] = RTPComplex(0.0f, 0.0f);
+	for (unsigned int i = 0; i < NumSensors * Samp_Per_WRI; i++) Snap.DCOffsetArr[i] = RTPComplex(0.0f, 0.0f);
+}
+
+// A reader marks the snapshot in use and then checks it is still current.  If it isn't, the publisher
+// may already be refilling it, so let it go and try again.
+const CalSnapshot *CalPublisher::acquire()
+{
+	while (TRUE) {
+		CalSnapshot *snap = Current.load();
+		snap->Readers++;
+		if (Current.load() == snap) return snap;
+		snap->Readers--;
+	}
+}
+
+void CalPublisher::release(const CalSnapshot *Snap)
+{
+	const_cast<CalSnapshot *>(Snap)->Readers--;
+}
+
+// After the workers have stopped
+void CalPublisher::cleanup()
+{
+	for (int s = 0; s < NumSlots; s++) {
+		free(Slots[s].DCOffsetArr);
+		Slots[s].DCOffsetArr = NULL;
+		free(Slots[s].XformBins);
+		Slots[s].XformBins = NULL;
+	}
+	delete[] Slots;
+	Slots = NULL;
+	NumSlots = 0;
+}
+
 int cleanupCalThread(pCalData pRadarCalData, RTPComplex *DCOffsetVals[], RTPComplex DCOffset[])
 {
 	int rindex;
@@ -621,8 +1284,8 @@ int cleanupCalThread(pCalData pRadarCalData, RTPComplex *DCOffsetVals[], RTPComp
 	NumSensorsSet = pRadarCalData->Params.NumSensorsSet;
 	for (rindex = 0; rindex < NumSensorsSet; rindex++) {
 		//free(DCOffsetVals[rindex]); DCOffsetVals[rindex] = NULL;
-		fftwf_free(pRadarCalData->pCalData[rindex]);  pRadarCalData->pCalData[rindex] = NULL;
-		free(pRadarCalData->pOffsetsdat[rindex]); pRadarCalData->pOffsetsdat[rindex] = NULL;
+		pRadarCalData->pCalData[rindex] = NULL;		// The memory goes back with gArena
+		pRadarCalData->pOffsetsdat[rindex] = NULL;
 	}
 	return 0;
 }
@@ -32,18 +32,25 @@ typedef struct CalData {
 	bool InBufferFull = false;		// Tell thread that input data is in buffer
 	
 	std::vector<floatdim4> CalXform;// Transform
+	int NumBands = 0;				// IQ correction sub-bands per radar, 0 when there is only CalXform
+	unsigned int BandWidth = 0;		// Range samples per sub-band
+	std::vector<floatdim4> CalXformBand;	// Transform of each sub-band, [radar][NumBands]
 
 	bool Cal_ready=FALSE;					// Flag to indicate cal values are ready.  Used as non-blocking semaphore.
 	float FadeMemVal=0.95f;					// Fading memory update coefficient
 	bool CalDCOnly=TRUE;					// Flag to say how to cal data
 	int CalCount = 0;					// How many calibration blocks have been processed
+	float StartFade = 0.5f;					// Fading memory coefficient for the first StartCount updates
+	int StartCount = 20;
+	int LogEvery = 1;						// Updates between printing the range dependent calibration
 	bool StopRequested=FALSE;
+	bool WarmStart = FALSE;					// History was loaded from the saved state, so don't reset it
 
 	CalData(CPI_Params InParams) :Params(InParams), NumSensorsSet(InParams.NumSensorsSet),
 		DCOffset(InParams.NumSensorsSet), DCOffsetHist(InParams.NumSensorsSet), 
 		DCOffsetHistN(InParams.NumSensorsSet*Nhist), // only use this with particular DC offset cal
 		DCOffsetWRI(InParams.NumSensorsSet), DCOffsetWRIHist(InParams.NumSensorsSet), 
-		R(InParams.NumSensorsSet), Rhist(InParams.NumSensorsSet), CalXform(InParams.NumSensorsSet), 
+		R(InParams.NumSensorsSet), Rhist(InParams.NumSensorsSet), DCOffsetAve(InParams.NumSensorsSet), CalXform(InParams.NumSensorsSet), 
 		Cal_ready(FALSE),FadeMemVal(0.95f), CalDCOnly(TRUE),StopRequested(FALSE)
 	{
 		for (unsigned int i = 0; i < InParams.NumSensorsSet; i++) {
@@ -55,8 +62,24 @@ typedef struct CalData {
 	int initializeCal(CPI_Params Params);
 	//int initializeCal(CPI_Params Params, RTPComplex *DCOffsetVals[], RTPComplex DCOffset[]);
 	void CalibrateFunction(int bob);
+	void initHistory();
+	void updateCal();
+	void updateBlock(const RTPComplex * const Block[], unsigned int NumWRI);
+	void logFinal();
+	int saveState();
+	void queueSave();
+	void startStateWriter();
+	void stopStateWriter();
+	void StateWriterFunction();
+	int loadState();
 	int whitenTransformCholesky();
+	void updateBands();
 	int whitenTransformEigen();
+	void blockStatistics(const RTPComplex * const Data[], unsigned int NumWRI, bool RangeDep);
+	void calStatistics(bool RangeDep);
+	void covarianceFromMoments(bool RangeDep);
+	void benchmarkStatistics();
+	// The separate pass versions, kept as the reference for benchmarkStatistics
 	void complexMean();
 	void covarianceSingleMean();
 	void covarianceRangeDepMean();
@@ -82,10 +105,67 @@ private:
 
 	std::vector<floatdim4> R;
 	std::vector<floatdim4> Rhist;		// Estimated covariance matrix used to calculate transform
+	std::vector<RTPComplex> DCOffsetAve;	// Result of DCAveSingle
+
+	// Work space for calStatistics, sized in initializeCal so nothing is allocated per block
+	std::vector<float> RefRow;			// Reference subtracted from each WRI, interleaved real/imag, per radar
+	std::vector<double> BinSum;			// Sum over the WRIs of the data less the reference, per range sample and radar
+	std::vector<double> Sxx, Syy, Sxy;	// Second moments about the reference, per radar
+	std::vector<double> BinMom;			// Second moments of each range sample, [radar][xx, yy, xy][Samp_Per_WRI], with sub-bands
+	std::vector<floatdim4> RBand, RhistBand;	// Covariance of each sub-band, new and fading memory
+	unsigned long BandFailures = 0;
+	unsigned int StatWRI = 0;			// WRIs in the last pass
+
+	std::string StateFile;				// Where the state is saved, empty when it isn't
+	std::chrono::steady_clock::time_point NextSave;
+	void packState(std::vector<char> &File);
+	int writeState(const std::vector<char> &File);
+	// The streaming calibration runs on the dispatch thread, so its saves are written by StateWriter
+	std::thread StateWriter;
+	std::mutex SaveLock;
+	std::condition_variable SaveHere;
+	std::vector<char> SaveFile;			// Packed state waiting to be written, the latest wins
+	bool SavePending = false, SaveStop = false;
 //	std::vector<floatdim4> CalXform;// Transform
 }  CalData, *pCalData;
 
 
+// One published set of calibration coefficients.  A snapshot is filled in while no one can see it and
+// is not changed again until it has been replaced and its last reader is done with it.
+typedef struct CalSnapshot {
+	unsigned long Version = 0;			// Counts up with each publication, 0 is the configured values
+	RTPComplex DCOffset[MaxRadars];		// DC offset of each radar
+	floatdim4 CalXform[MaxRadars];		// IQ gain and correlation transform of each radar
+	RTPComplex *DCOffsetArr = NULL;		// DC offset of each range sample, [radar][Samp_Per_WRI]
+	float *XformBins = NULL;			// Sub-band transforms spread out to each range sample, [radar][4][Samp_Per_WRI]. NULL without sub-bands.
+	std::atomic<int> Readers;			// Workers using this snapshot now
+} CalSnapshot;
+
+// Hands the calibration from the dispatch thread to the workers without locks or copies (read-copy-update).
+// The publisher fills a free snapshot and swaps the current pointer.  A worker takes the current
+// snapshot at the start of each CPI and gives it back after calibrating the data.  There is one more
+// snapshot than can be in use at once (in virtual time a whole batch is pinned), so publishing never waits.
+typedef struct CalPublisher {
+	int initialize(CPI_Params Params, int NumThreads);
+	void publish(const RTPComplex DCOffset[], const floatdim4 CalXform[], RTPComplex * const DCOffsetArr[],
+		const floatdim4 BandXform[]);
+	const CalSnapshot *acquire();
+	void release(const CalSnapshot *Snap);
+	void cleanup();
+private:
+	CalSnapshot *Slots = NULL;
+	int NumSlots = 0;
+	std::atomic<CalSnapshot *> Current;
+	unsigned long Version = 0;
+	unsigned int NumSensors = 0, Samp_Per_WRI = 0, BandWidth = 0;
+	bool ZeroDC = FALSE;				// The MTI has already removed the DC offset
+	void zeroDC(CalSnapshot &Snap);
+} CalPublisher;
+
+unsigned int calBandWidth(unsigned int SampPerWRI);
+
+extern CalPublisher gCalPublished;
+
 // In calibration.cpp
 //int initializeCal(pCalData pRadarCalData, CPI_Params Params, RTPComplex *DCOffsetVals[], RTPComplex DCOffset[]);
 
@@ -0,0 +1,220 @@
+// Constant false alarm rate (CFAR) detection on the range-Doppler power map.
+// Each worker thread owns a CFARData so no locking is needed.  The detector finds the local peaks that
+// rise above the noise estimated from the surrounding training cells and returns a bounded list,
+// strongest first.
+// Three noise estimates are supported:
+//    CA - mean of the training cells. Best in uniform noise.
+//    GO - greater of the means in front of and behind the cell in range.  Holds false alarms down at clutter edges.
+//    OS - k-th smallest training cell.  Keeps a nearby strong target from masking a weaker one.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "radarc.h"
+#include "cfar.h"
+#include <algorithm>
+
+// Copy the settings read from the ini file
+void CFARConfigure(CFARData &Cfar)
+{
+	Cfar.Method = (CFARMethod)gRadarConfig.CFARType;
+	Cfar.GuardRange = gRadarConfig.CFARGuardRange;
+	Cfar.TrainRange = gRadarConfig.CFARTrainRange;
+	Cfar.GuardDoppler = gRadarConfig.CFARGuardDoppler;
+	Cfar.TrainDoppler = gRadarConfig.CFARTrainDoppler;
+	Cfar.ThresholdScale = (float)pow(10.0, gRadarConfig.CFARThresholddB / 10.0);
+	Cfar.OSRank = (float)gRadarConfig.CFAROSRank;
+	Cfar.MaxDets = MIN(MAX(gRadarConfig.CFARMaxDetections, 1), MaxDetections);
+}
+
+int CFARData::initialize(CPI_Params InitParams)
+{
+	Nr = InitParams.Samp_Per_WRI;
+	Nd = InitParams.Num_WRI;
+	if (Method == CFAROff) return 0;
+
+	// The window has to fit in the map, so shrink the training region if needed
+	GuardRange = MAX(GuardRange, 0);
+	GuardDoppler = MAX(GuardDoppler, 0);
+	TrainRange = MAX(MIN(TrainRange, ((int)Nr - 1) / 2 - GuardRange), 0);
+	TrainDoppler = MAX(MIN(TrainDoppler, ((int)Nd - 1) / 2 - GuardDoppler), 0);
+	if (TrainRange < 1) {	// The GO and OS pre-screen split the training cells in range, so at least one is needed
+		log_message("Warning: CFAR window does not fit in a %d x %d map. CFAR is off.", Nr, Nd);
+		Method = CFAROff;
+		return -1;
+	}
+	Wr = GuardRange + TrainRange;
+	Wd = GuardDoppler + TrainDoppler;
+	SATPitch = Nr + 2 * Wr + 1;
+
+	pPower = (float*)malloc(Nr*Nd * sizeof(pPower[0]));
+	pSAT = (double*)malloc(SATPitch*(Nd + 2 * Wd + 1) * sizeof(pSAT[0]));
+	pOSWork = (float*)malloc((2 * Wr + 1)*(2 * Wd + 1) * sizeof(pOSWork[0]));
+	if ((pPower == NULL) || (pSAT == NULL) || (pOSWork == NULL)) {
+		log_message("Error %d: Allocation of CFAR memory blocks failed.  Exiting", GetLastError());
+		exit(8);
+	}
+	// First row of the table is always zero
+	for (unsigned int i = 0; i < SATPitch; i++) pSAT[i] = 0.0;
+	return 0;
+}
+
+void CFARData::cleanup()
+{
+	free(pPower);
+	free(pSAT);
+	free(pOSWork);
+	pPower = NULL;
+	pSAT = NULL;
+	pOSWork = NULL;
+}
+
+// Sum of the power over an inclusive rectangle, in the coordinates of the wrapped (extended) map
+inline double CFARData::RectSum(int r0, int r1, int d0, int d1) const
+{
+	return pSAT[(d1 + 1)*SATPitch + r1 + 1] - pSAT[d0*SATPitch + r1 + 1]
+		- pSAT[(d1 + 1)*SATPitch + r0] + pSAT[d0*SATPitch + r0];
+}
+
+// Keep the strongest MaxDets detections
+void CFARData::addDetection(DetectionList &List, int r, int d, float Amplitude, float SNR)
+{
+	int slot = List.NumDetections;
+	if (List.NumDetections >= MaxDets) {
+		List.NumDropped++;
+		slot = 0;
+		for (int i = 1; i < List.NumDetections; i++)
+			if (List.Det[i].Amplitude < List.Det[slot].Amplitude) slot = i;
+		if (Amplitude <= List.Det[slot].Amplitude) return;
+	}
+	else {
+		List.NumDetections++;
+	}
+	RadarDetection &det = List.Det[slot];
+	det.RangeIndex = r;
+	det.DopplerIndex = d;
+	det.RangeFrac = 0.0f;
+	det.DopplerFrac = 0.0f;
+	det.Amplitude = Amplitude;
+	det.SNR = SNR;
+}
+
+int CFARData::detect(const fftwf_complex *pData, const float *pRDIPower, DetectionList &List)
+{
+	List.NumDetections = 0;
+	List.NumDropped = 0;
+	if (Method == CFAROff) return 0;
+
+	const int nr = (int)Nr, nd = (int)Nd;
+	for (int i = 0; i < nr*nd; i++)
+		pPower[i] = pData[i][0] * pData[i][0] + pData[i][1] * pData[i][1];
+
+	// Summed-area table of the map extended by the window half width on every side, wrapping around
+	const int Er = nr + 2 * Wr, Ed = nd + 2 * Wd;
+	for (int de = 0; de < Ed; de++) {
+		int d = de - Wd;
+		if (d < 0) d += nd;
+		else if (d >= nd) d -= nd;
+		const float *prow = &pPower[d*nr];
+		double *pS = &pSAT[(de + 1)*SATPitch];
+		const double *pSprev = &pSAT[de*SATPitch];
+		double rowsum = 0.0;
+		pS[0] = 0.0;
+		for (int re = 0; re < Er; re++) {
+			int r = re - Wr;
+			if (r < 0) r += nr;
+			else if (r >= nr) r -= nr;
+			rowsum += prow[r];
+			pS[re + 1] = pSprev[re + 1] + rowsum;
+		}
+	}
+
+	const int Gr = GuardRange, Gd = GuardDoppler;
+	const double ntrain = (double)((2 * Wr + 1)*(2 * Wd + 1) - (2 * Gr + 1)*(2 * Gd + 1));
+	const double nhalf = (double)(Wr*(2 * Wd + 1) - Gr * (2 * Gd + 1));
+	const int osIndex = MAX(0, MIN((int)(OSRank*(float)(ntrain - 1) + 0.5f), (int)ntrain - 1));
+
+	for (int d = 0; d < nd; d++) {
+		const int dm = (d == 0) ? nd - 1 : d - 1;
+		const int dp = (d == nd - 1) ? 0 : d + 1;
+		for (int r = 0; r < nr; r++) {
+			const float p = pPower[d*nr + r];
+			const int rm = (r == 0) ? nr - 1 : r - 1;
+			const int rp = (r == nr - 1) ? 0 : r + 1;
+
+			// Only report the peak of each return. Ties go to the first cell in the scan.
+			if ((p <= pPower[dm*nr + rm]) || (p <= pPower[dm*nr + r]) || (p <= pPower[dm*nr + rp]) ||
+				(p <= pPower[d*nr + rm]) || (p < pPower[d*nr + rp]) ||
+				(p < pPower[dp*nr + rm]) || (p < pPower[dp*nr + r]) || (p < pPower[dp*nr + rp]))
+				continue;
+
+			// The cell under test is at (r+Wr, d+Wd) in the extended map
+			const int re = r + Wr, de = d + Wd;
+			double noise;
+			if (Method == CFARCellAverage) {
+				noise = (RectSum(re - Wr, re + Wr, de - Wd, de + Wd) - RectSum(re - Gr, re + Gr, de - Gd, de + Gd)) / ntrain;
+			}
+			else {
+				// Training cells in front of and behind the cell under test in range
+				double lead = RectSum(re - Wr, re - 1, de - Wd, de + Wd);
+				double lag = RectSum(re + 1, re + Wr, de - Wd, de + Wd);
+				if (Gr > 0) {
+					lead -= RectSum(re - Gr, re - 1, de - Gd, de + Gd);
+					lag -= RectSum(re + 1, re + Gr, de - Gd, de + Gd);
+				}
+				if (Method == CFARGreatestOf) {
+					noise = MAX(lead, lag) / nhalf;
+				}
+				else {
+					// OS pre-screen uses the smaller half so a strong neighbor on one side doesn't hide the cell
+					if (p < 0.25*ThresholdScale*MIN(lead, lag) / nhalf) continue;
+					int n = 0;
+					for (int dd = -Wd; dd <= Wd; dd++) {
+						int dw = d + dd;
+						if (dw < 0) dw += nd;
+						else if (dw >= nd) dw -= nd;
+						for (int rr = -Wr; rr <= Wr; rr++) {
+							if ((abs(rr) <= Gr) && (abs(dd) <= Gd)) continue;
+							int rw = r + rr;
+							if (rw < 0) rw += nr;
+							else if (rw >= nr) rw -= nr;
+							pOSWork[n++] = pPower[dw*nr + rw];
+						}
+					}
+					std::nth_element(pOSWork, pOSWork + osIndex, pOSWork + n);
+					noise = pOSWork[osIndex];
+				}
+			}
+			noise = MAX(noise, 1e-30);
+			if (p > ThresholdScale*noise)
+				addDetection(List, r, d, pRDIPower[d*nr + r], 10.0f*(float)log10(p / noise));
+		}
+	}
+
+	// Strongest first
+	for (int i = 1; i < List.NumDetections; i++) {
+		RadarDetection tmp = List.Det[i];
+		int j = i - 1;
+		while ((j >= 0) && (List.Det[j].Amplitude < tmp.Amplitude)) {
+			List.Det[j + 1] = List.Det[j];
+			j--;
+		}
+		List.Det[j + 1] = tmp;
+	}
+	return List.NumDetections;
+}
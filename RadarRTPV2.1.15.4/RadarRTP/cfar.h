@@ -0,0 +1,80 @@
+#pragma once
+// Constant false alarm rate (CFAR) detection header file
+// The detector runs in each worker thread on the range-Doppler power map and produces a short list
+// of detections per CPI, so that more than the single strongest return can be reported.
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+#include "CPIParameters.h"
+extern "C" {
+#include <fftw3.h>
+}
+
+// Largest number of detections kept per radar per CPI.  The strongest are kept when there are more.
+#define MaxDetections 32
+
+enum CFARMethod {
+	CFAROff = 0,
+	CFARCellAverage,		// CA-CFAR: mean of all training cells
+	CFAROrderedStat,		// OS-CFAR: the k-th smallest training cell
+	CFARGreatestOf			// GO-CFAR: larger of the means of the training cells before and after the cell in range
+};
+
+typedef struct RadarDetection {
+	int RangeIndex = 0;				// Range bin
+	int DopplerIndex = 0;			// Doppler bin (before fftshift, same as index_max_d)
+	float RangeFrac = 0.0f;			// Fractional range bin offset
+	float DopplerFrac = 0.0f;		// Fractional Doppler bin offset
+	float Amplitude = -2000.0f;		// Power in dB
+	float SNR = 0.0f;				// Power above the CFAR noise estimate in dB
+} RadarDetection;
+
+typedef struct DetectionList {
+	int NumDetections = 0;
+	int NumDropped = 0;				// Detections found beyond what the list could hold
+	RadarDetection Det[MaxDetections];	// Sorted, strongest first
+} DetectionList;
+
+// Range-Doppler CFAR.  The training window is a rectangle of (2*(Guard+Train)+1) cells on a side in
+// each dimension with the guard rectangle (2*Guard+1) removed from the middle.  Both axes wrap around,
+// as the FFT output is periodic.
+// CA and GO use a summed-area table of the linear power so the cost per cell does not depend on the
+// window size.  OS needs the sorted training cells, so it is only evaluated at local peaks that pass a
+// smallest-of pre-screen 6dB below the threshold.
+typedef struct CFARData {
+	CFARMethod Method = CFAROff;
+	int GuardRange = 2, TrainRange = 8;		// Cells either side of the cell under test in range
+	int GuardDoppler = 2, TrainDoppler = 4;	// and in Doppler
+	float ThresholdScale = 20.0f;			// Linear threshold multiplier on the noise estimate
+	float OSRank = 0.75f;					// Fraction of the training cells below the OS estimate
+	int MaxDets = MaxDetections;			// Size of the list to keep, up to MaxDetections
+
+	int initialize(CPI_Params InitParams);
+	int detect(const fftwf_complex *pData, const float *pRDIPower, DetectionList &List);
+	void cleanup();
+private:
+	unsigned int Nr = 0, Nd = 0;	// Range and Doppler bins
+	int Wr = 0, Wd = 0;				// Half width of the whole window, guard+train
+	unsigned int SATPitch = 0;		// Row length of the summed-area table
+	float *pPower = NULL;			// Linear power [Nd][Nr]
+	double *pSAT = NULL;			// Summed-area table over the wrapped map [Nd+2Wd+1][Nr+2Wr+1]
+	float *pOSWork = NULL;			// Training cells for the OS estimate
+	inline double RectSum(int r0, int r1, int d0, int d1) const;
+	void addDetection(DetectionList &List, int r, int d, float Amplitude, float SNR);
+} CFARData;
+
+// Read from the ini file
+void CFARConfigure(CFARData &Cfar);
@@ -84,6 +84,7 @@ int ConsoleKeyMonitor(std::atomic<bool> &exitflag)
 		if (exitflag) break;
 #endif
 		key = _getch();  // Built-in function for windows, defined for Linux
+		if (key == EOF) break;	// stdin is closed or not a terminal (a batch or CI run), nothing more will come
 		int retval = interpretKey(key, exitflag);
 
 #ifndef _RTP_Headless
@@ -149,6 +150,33 @@ int interpretKey(int key, std::atomic<bool> &exitflag)
 			close_all_open_files();
 			break;
 		}
+		// Transmit changes take effect at the next audio callback
+		case 'M':
+		{ // Modulation on/off
+			gRadarState.TransmitModOn = !gRadarState.TransmitModOn;
+			log_message("Console transmit modulation %s", gRadarState.TransmitModOn ? "on" : "off");
+			update_waveform();
+			break;
+		}
+		case 'U':
+		case 'D':
+		{ // Modulation amplitude up or down
+			gRadarState.TransmitModAmp = MIN(MAX(gRadarState.TransmitModAmp + ((key == 'U') ? 0.1 : -0.1), 0.0), 1.0);
+			log_message("Console transmit modulation amplitude %.2f", gRadarState.TransmitModAmp);
+			update_waveform();
+			break;
+		}
+		case 'L':
+		{ // Long sweep.  The sonar processing is set up for one or the other at the start.
+			if (gRadarConfig.Sonar) {
+				log_message("Long sweep can't be changed while the sonar is running");
+				break;
+			}
+			gRadarState.TransmitLongSweep = !gRadarState.TransmitLongSweep;
+			log_message("Console transmit long sweep %s", gRadarState.TransmitLongSweep ? "on" : "off");
+			update_waveform();
+			break;
+		}
  
 		default:
 		{
@@ -0,0 +1,347 @@
+// Multi-radar fusion of the pendulum measurements
+// Each radar measures the radial speed of the bob (from Doppler) and, when the radar is swept, its range.
+// None of them alone gives the position of the bob in the plane of the swing, but together (and with
+// the pendulum's equation of motion) they do.
+//
+// The fusion runs on its own thread after the output gather thread.  The radars' measurements are put
+// in time order by Data_TOVtt and an extended Kalman filter is propagated to each one in turn.  The state
+// is the bob position and velocity, x y vx vy, and the motion model is the linearized pendulum
+// (a 2-D harmonic oscillator) with white acceleration noise.  All of the radars' measurements at the
+// same time are applied as a sequence of scalar updates, which is the same as one stacked least squares
+// update when the measurement errors are independent.
+// For each radar the measurement used is whichever of the strongest peak and the CFAR detections is
+// closest to the predicted return, within a gate, so clutter doesn't pull the estimate around.
+//
+// The direction of the major axis of the swing comes from the state: for a harmonic oscillator the
+// matrix  w^2 r r' + v v'  is constant over a swing and its main eigenvector lies along the major axis.
+// The precession rate is the slope of a fading memory least squares line through that angle.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "radarc.h"
+#include "fusion.h"
+#include <thread>
+#include <chrono>
+
+#define FUSION_BOB_RADIUS 0.22		// Same as PendSimParms::BobRadius. Range is measured to the near side of the bob.
+#define FUSION_AXIS_SIGMA 0.1		// Position uncertainty (m) below which the swing direction is used
+
+static FusionData Fusion;
+static std::thread FusionThread;
+static bool FusionRunning = FALSE;
+
+
+int FusionData::initialize(CPI_Params InitParams)
+{
+	Params = InitParams;
+	WorkParams = InitParams;
+	RadarLocations(InitParams.NumSensorsSet, RadarX, RadarY);
+	Omega = sqrt(GEARTH / gRadarConfig.PendLength);
+	// Swept radar: one range bin is c/2B.  CW radar has no range.
+	RangeBin = (gRadarConfig.Bandwidth > 0.0) ? VLIGHT / (2.0*gRadarConfig.Bandwidth) : 0.0;
+	UseRange = gRadarConfig.FusionUseRange && (RangeBin > 0.0);
+	InBufferFull = false;
+	Working = false;
+	StopRequested = false;
+	Overruns = 0;
+	Started = false;
+	AxisValid = false;
+	AxisFit.reset((gRadarConfig.FusionPrecessionMemory > 0.0) ?
+		exp(-(double)gRadarConfig.NWRIPerBlock*gRadarConfig.NSamplesPerWRI / gRadarConfig.SampleRate / gRadarConfig.FusionPrecessionMemory) : 1.0);
+	Updates = 0;
+	UpdateTimeTotal = 0.0;
+	return 0;
+}
+
+// Copy the latest results in for the fusion thread.  If the previous set hasn't been used yet it is replaced,
+// except in virtual time where this waits until the fusion has finished with it.
+int FusionData::loadFrame()
+{
+	std::unique_lock<std::mutex> bufferlock(OwnBuffers);
+	if (InBufferFull) Overruns++;
+	Params = gProcessedData.Params;
+	for (unsigned int rindex = 0; rindex < Params.NumSensorsSet; rindex++) {
+		Peak[rindex].RangeIndex = gProcessedData.index_max_r[rindex];
+		Peak[rindex].DopplerIndex = gProcessedData.index_max_d[rindex];
+		Peak[rindex].RangeFrac = gProcessedData.index_frac_r[rindex];
+		Peak[rindex].DopplerFrac = gProcessedData.index_frac_d[rindex];
+		Peak[rindex].Amplitude = gProcessedData.peakAmplitude[rindex];
+		Detections[rindex] = gProcessedData.Detections[rindex];
+		TOVtt[rindex] = gProcessedData.RadarTOVtt[rindex];
+	}
+	InBufferFull = true;
+	bufferlock.unlock();
+	DataHere.notify_one();
+	// In virtual time this CPI's fusion reports go into the data file before the next CPI's results, on every run
+	if (gRadarConfig.VirtualTime) {
+		bufferlock.lock();
+		while ((InBufferFull || Working) && !StopRequested)
+			DataHere.wait_for(bufferlock, std::chrono::milliseconds(1000));
+	}
+	return 0;
+}
+
+void FusionData::FusionFunction()
+{
+	setThreadRole(ThreadRecorder);
+	log_message("Fusion thread started.");
+	while (!StopRequested) {
+		std::unique_lock<std::mutex> bufferlock(OwnBuffers);
+		while (!InBufferFull && !StopRequested) {
+			DataHere.wait_for(bufferlock, std::chrono::milliseconds(1000));
+		}
+		if (StopRequested) break;
+		WorkParams = Params;
+		for (unsigned int rindex = 0; rindex < Params.NumSensorsSet; rindex++) {
+			WorkPeak[rindex] = Peak[rindex];
+			WorkDets[rindex] = Detections[rindex];
+			WorkTOVtt[rindex] = TOVtt[rindex];
+		}
+		InBufferFull = false;
+		Working = true;
+		bufferlock.unlock();
+
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		update();
+		UpdateTimeTotal += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		Updates++;
+		bufferlock.lock();
+		Working = false;
+		bufferlock.unlock();
+		DataHere.notify_all();
+	}
+	log_message("Fusion stopped. Updates %lu, average update %.3f ms, overruns %lu. Precession %.2f deg/hr (Foucault rate at %.1f deg latitude is %.2f deg/hr)",
+		Updates, (Updates > 0) ? 1000.0*UpdateTimeTotal / Updates : 0.0, Overruns, AxisFit.slope() * 360.0 / (TWOPI) * 3600.0,
+		gRadarConfig.PendLatitude, 360.0 / 24.0 * sin(gRadarConfig.PendLatitude * 3.14159265358979 / 180.0));
+}
+
+// Propagate the state to a new time with the pendulum motion
+void FusionData::predict(DataTics TOV)
+{
+	double dt = std::chrono::duration<double>(TOV - StateTOV).count();
+	if (dt <= 0.0) return;
+	StateTOV = TOV;
+
+	double c = cos(Omega*dt), s = sin(Omega*dt);
+	double F[4][4] = {
+		{ c, 0.0, s / Omega, 0.0 },
+		{ 0.0, c, 0.0, s / Omega },
+		{ -Omega * s, 0.0, c, 0.0 },
+		{ 0.0, -Omega * s, 0.0, c } };
+	double Xn[4], FP[4][4];
+	for (int i = 0; i < 4; i++) {
+		Xn[i] = 0.0;
+		for (int k = 0; k < 4; k++) Xn[i] += F[i][k] * X[k];
+	}
+	for (int i = 0; i < 4; i++) {
+		X[i] = Xn[i];
+		for (int j = 0; j < 4; j++) {
+			FP[i][j] = 0.0;
+			for (int k = 0; k < 4; k++) FP[i][j] += F[i][k] * P[k][j];
+		}
+	}
+	double q = gRadarConfig.FusionAccelNoise * gRadarConfig.FusionAccelNoise;
+	double Qpp = q * dt*dt*dt / 3.0, Qpv = q * dt*dt / 2.0, Qvv = q * dt;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			double sum = 0.0;
+			for (int k = 0; k < 4; k++) sum += FP[i][k] * F[j][k];
+			P[i][j] = sum;
+		}
+	}
+	P[0][0] += Qpp; P[1][1] += Qpp; P[2][2] += Qvv; P[3][3] += Qvv;
+	P[0][2] += Qpv; P[2][0] += Qpv; P[1][3] += Qpv; P[3][1] += Qpv;
+}
+
+void FusionData::scalarUpdate(const double H[4], double Innov, double MeasVar)
+{
+	double PH[4], S = MeasVar;
+	for (int i = 0; i < 4; i++) {
+		PH[i] = 0.0;
+		for (int k = 0; k < 4; k++) PH[i] += P[i][k] * H[k];
+		S += H[i] * PH[i];
+	}
+	for (int i = 0; i < 4; i++) X[i] += PH[i] * Innov / S;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++) P[i][j] -= PH[i] * PH[j] / S;
+}
+
+// Pick the return from this radar that best fits the prediction and apply it.  Returns true if one was used.
+bool FusionData::measure(int RadarChan)
+{
+	const double vamb = gRadarConfig.UAmbDoppler;
+	const double dvar = gRadarConfig.FusionDopplerNoise * gRadarConfig.FusionDopplerNoise;
+	const double rvar = gRadarConfig.FusionRangeNoise * gRadarConfig.FusionRangeNoise;
+
+	double dx = X[0] - RadarX[RadarChan], dy = X[1] - RadarY[RadarChan];
+	double d = MAX(sqrt(dx*dx + dy * dy), 1e-3);
+	double vpred = (dx*X[2] + dy * X[3]) / d;
+	double Hd[4] = { X[2] / d - dx * vpred / (d*d), X[3] / d - dy * vpred / (d*d), dx / d, dy / d };
+	double Hr[4] = { dx / d, dy / d, 0.0, 0.0 };
+	double Sd = dvar, Sr = rvar;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++) {
+			Sd += Hd[i] * P[i][j] * Hd[j];
+			Sr += Hr[i] * P[i][j] * Hr[j];
+		}
+
+	const RadarDetection *best = NULL;
+	double bestnis = gRadarConfig.FusionGate, bestdinnov = 0.0, bestrinnov = 0.0;
+	const DetectionList &dets = WorkDets[RadarChan];
+	for (int k = -1; k < dets.NumDetections; k++) {
+		const RadarDetection &cand = (k < 0) ? WorkPeak[RadarChan] : dets.Det[k];
+		double vr = RadialSpeed(cand.DopplerIndex + cand.DopplerFrac, WorkParams.Num_WRI, vamb);
+		double dinnov = vr - vpred;
+		dinnov -= 2.0*vamb*floor(dinnov / (2.0*vamb) + 0.5);
+		double nis = dinnov * dinnov / Sd;
+		double rinnov = 0.0;
+		if (UseRange) {
+			double range = (cand.RangeIndex + cand.RangeFrac - gRadarConfig.TxRxSampleOffset)*RangeBin + FUSION_BOB_RADIUS;
+			rinnov = range - d;
+			nis += rinnov * rinnov / Sr;
+		}
+		if (nis < bestnis) {
+			bestnis = nis;
+			best = &cand;
+			bestdinnov = dinnov;
+			bestrinnov = rinnov;
+		}
+	}
+	if (best == NULL) return false;
+
+	scalarUpdate(Hd, bestdinnov, dvar);
+	if (UseRange) {
+		// Relinearize about the state after the Doppler update
+		dx = X[0] - RadarX[RadarChan];
+		dy = X[1] - RadarY[RadarChan];
+		double dnew = MAX(sqrt(dx*dx + dy * dy), 1e-3);
+		double Hr2[4] = { dx / dnew, dy / dnew, 0.0, 0.0 };
+		scalarUpdate(Hr2, bestrinnov + d - dnew, rvar);
+	}
+	return true;
+}
+
+// Direction of the swing and the fading memory line fit through it
+void FusionData::updateAxis(double t)
+{
+	if (sqrt(P[0][0] + P[1][1]) > FUSION_AXIS_SIGMA) return;
+	double w2 = Omega * Omega;
+	double Axx = w2 * X[0] * X[0] + X[2] * X[2];
+	double Ayy = w2 * X[1] * X[1] + X[3] * X[3];
+	double Axy = w2 * X[0] * X[1] + X[2] * X[3];
+	double tr = Axx + Ayy, diff = sqrt((Axx - Ayy)*(Axx - Ayy) + 4.0*Axy*Axy);
+	if ((tr <= 0.0) || (diff < 0.2*tr)) return;		// Nearly circular, so no clear direction
+	double theta = 0.5*atan2(2.0*Axy, Axx - Ayy);
+	if (AxisValid) {	// The axis is a line, so it is only known modulo pi
+		while (theta - AxisAngle > TWOPI / 4.0) theta -= TWOPI / 2.0;
+		while (theta - AxisAngle < -TWOPI / 4.0) theta += TWOPI / 2.0;
+	}
+	AxisAngle = theta;
+	AxisValid = true;
+	AxisFit.add(t, theta);
+}
+
+void FusionData::update()
+{
+	const unsigned int nrad = WorkParams.NumSensorsSet;
+	// Time order of the radars' measurements
+	int order[MaxRadars];
+	for (unsigned int i = 0; i < nrad; i++) {
+		int j = i;
+		while ((j > 0) && (WorkTOVtt[order[j - 1]] > WorkTOVtt[i])) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	if (!Started) {
+		// Start at rest in the middle, with an uncertainty the size of the swing
+		double A = MAX(gRadarConfig.PendMajorAxis, 0.1);
+		for (int i = 0; i < 4; i++) {
+			X[i] = 0.0;
+			for (int j = 0; j < 4; j++) P[i][j] = 0.0;
+		}
+		P[0][0] = P[1][1] = A * A;
+		P[2][2] = P[3][3] = A * A*Omega*Omega;
+		StateTOV = WorkTOVtt[order[0]];
+		FirstTOV = StateTOV;
+		Started = true;
+	}
+
+	int used = 0;
+	for (unsigned int i = 0; i < nrad; i++) {
+		predict(WorkTOVtt[order[i]]);
+		if (measure(order[i])) used++;
+	}
+	// Keep the covariance symmetric
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < i; j++) P[i][j] = P[j][i] = 0.5*(P[i][j] + P[j][i]);
+
+	double t = std::chrono::duration<double>(StateTOV - FirstTOV).count();
+	updateAxis(t);
+
+	if (gRadarState.DataRecording == TRUE) {
+		FusionReport Rep;
+		Rep.BlockID = WorkParams.block_id;
+		Rep.Time = std::chrono::duration<double>(StateTOV).count();
+		Rep.X = X[0];
+		Rep.Y = X[1];
+		Rep.VX = X[2];
+		Rep.VY = X[3];
+		Rep.SigX = sqrt(MAX(P[0][0], 0.0));
+		Rep.SigY = sqrt(MAX(P[1][1], 0.0));
+		double axis = fmod(AxisAngle, TWOPI / 2.0);
+		if (axis > TWOPI / 4.0) axis -= TWOPI / 2.0;
+		if (axis <= -TWOPI / 4.0) axis += TWOPI / 2.0;
+		Rep.AxisAngle = AxisValid ? axis * 360.0 / (TWOPI) : 0.0;
+		Rep.PrecessionRate = AxisFit.slope() * 360.0 / (TWOPI) * 3600.0;
+		Rep.RadarsUsed = used;
+		save_fusion_data(Rep);
+	}
+}
+
+
+int startFusion(CPI_Params Params)
+{
+	if (!gRadarConfig.FusionOn) return 0;
+	Fusion.initialize(Params);
+	FusionThread = std::thread(&FusionData::FusionFunction, &Fusion);
+	FusionRunning = TRUE;
+	log_message("Fusion started for %d radars, %s", Params.NumSensorsSet,
+		gRadarConfig.FusionUseRange && (gRadarConfig.Bandwidth > 0.0) ? "range and Doppler" : "Doppler only");
+	return 0;
+}
+
+void stopFusion()
+{
+	if (!FusionRunning) return;
+	std::unique_lock<std::mutex> bufferlock(Fusion.OwnBuffers);
+	Fusion.StopRequested = true;
+	bufferlock.unlock();
+	Fusion.DataHere.notify_all();
+	if (FusionThread.joinable()) FusionThread.join();
+	FusionRunning = FALSE;
+}
+
+int FusionLoadFrame(void)
+{
+	if (!FusionRunning) return 0;
+	return Fusion.loadFrame();
+}
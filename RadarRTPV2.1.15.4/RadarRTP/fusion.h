@@ -0,0 +1,92 @@
+#pragma once
+// Multi-radar fusion header file
+// Combines the range and Doppler measured by each radar into the position and velocity of the
+// pendulum bob in the plane of the swing, and follows the rotation (precession) of the swing.
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+#include "stdafx.h"
+#include "cfar.h"
+#include "precession.h"
+#include <mutex>
+#include <condition_variable>
+
+// What is recorded after each fusion update
+typedef struct FusionReport {
+	unsigned int BlockID;
+	double Time;				// Seconds since the stream started (Data_TOVtt)
+	double X, Y;				// Bob position, m, in the radar coordinates (origin at the pendulum rest point)
+	double VX, VY;				// Bob velocity, m/s
+	double SigX, SigY;			// Standard deviation of the position estimate, m
+	double AxisAngle;			// Direction of the major axis of the swing, degrees from the x axis
+	double PrecessionRate;		// Rate the major axis turns, degrees per hour
+	int RadarsUsed;				// Radars that contributed a measurement this CPI
+} FusionReport;
+
+typedef struct FusionData {
+	CPI_Params Params;
+	// Input, loaded by the output gather thread
+	RadarDetection Peak[MaxRadars];		// Strongest return of each radar
+	DetectionList Detections[MaxRadars];	// and the CFAR detections
+	DataTics TOVtt[MaxRadars];			// Time of validity of each radar's CPI
+	// C++11 constructs
+	std::condition_variable DataHere;
+	std::mutex OwnBuffers;
+	bool InBufferFull = false;
+	bool Working = false;				// Update in progress
+	bool StopRequested = false;
+	unsigned long Overruns = 0;
+
+	int initialize(CPI_Params InitParams);
+	int loadFrame();					// Called by the gather thread with gProcessedData complete, never blocks
+	void FusionFunction();
+private:
+	// Working copy of the input
+	CPI_Params WorkParams;
+	RadarDetection WorkPeak[MaxRadars];
+	DetectionList WorkDets[MaxRadars];
+	DataTics WorkTOVtt[MaxRadars];
+
+	double RadarX[MaxRadars], RadarY[MaxRadars];	// Radar locations, m
+	double Omega = 1.0;				// Pendulum radian frequency
+	double RangeBin = 0.0;			// m per range bin, 0 if the radar is CW (no range measurement)
+	bool UseRange = false;
+
+	// Extended Kalman filter.  State is x, y, vx, vy
+	double X[4];
+	double P[4][4];
+	DataTics StateTOV;
+	bool Started = false;
+
+	// Fading memory least squares line through the unwrapped axis angle, for the precession rate
+	double AxisAngle = 0.0;			// radians, unwrapped
+	bool AxisValid = false;
+	PrecessionFit AxisFit;			// Angle in radians against time in seconds
+	DataTics FirstTOV;
+
+	unsigned long Updates = 0;
+	double UpdateTimeTotal = 0.0;
+
+	void update();
+	void predict(DataTics TOV);
+	bool measure(int RadarChan);
+	void scalarUpdate(const double H[4], double Innov, double MeasVar);
+	void updateAxis(double t);
+} FusionData;
+
+int startFusion(CPI_Params Params);
+void stopFusion();
+int FusionLoadFrame(void);
@@ -36,13 +36,19 @@ time_t tfileraw;
 
 /* Global variables */
 // The following holds the transmitted waveform. VCO modulation for radar, samples for sonar
-float * WaveData;  /* Waveform data.  Memory allocated elsewhere, this is the pointer to the data */
+WaveTable gWaveTable;  /* Double buffered transmit table, see waveform.cpp */
 RTPComplex *  WaveformReplica; // Storage for sonar time series -> freq domain
 RTPComplex *  DownConvertWF;  // Complex exponential to downconvert the sonar to baseband
+RTPComplex *  LongSweepReplica;  // Baseband sonar sweep over a whole block, when TransmitLongSweep
 
 RadarConfig gRadarConfig; /* Radar configuration information */
 RadarState gRadarState;		/* Radar state information */
 ProcessedRadarData gProcessedData; /* Data to communicate between processing and display */
+CalPublisher gCalPublished;		/* Latest calibration for the workers */
+SimScenario gScenario;		/* Scene for the radar simulation, see scenario.h */
+NumaLayout gNuma;		/* Worker and buffer placement on NUMA nodes, see threads.cpp */
+BufferArena gArena;		/* The block the processing buffers are taken from, see arena.cpp */
+OverloadControl gOverload;	/* Sheds work when the processing falls behind, see overload.cpp */
 
 // The following is for the ring buffer between the data input thread and the radar processing dispatch thread
 float *Buff_Data[NBUFF];					// storage for ringbuffer data
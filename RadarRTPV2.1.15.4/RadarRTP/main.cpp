@@ -97,6 +97,7 @@ int main()
 #ifdef _FLTKGUI
 	log_message("Starting fltk GUI");
 	std::thread fltkthread = std::thread(RunFLTKGui, std::ref(ConsoleExitProgramFlag));
+	setThreadRole(fltkthread, ThreadDisplay);
 #endif
 
 #ifdef _WINGUI
@@ -126,12 +127,14 @@ int main()
 #endif
 #endif
 	// With windows GUI, the program will not get to this point until it is exiting
-	while (!ConsoleExitProgramFlag) {
+	// A virtual time run with SimFrames set also stops on its own
+	while (!ConsoleExitProgramFlag && !simRunDone()) {
 		std::this_thread::sleep_for(std::chrono::milliseconds(50));
 		// This thread could be doing something else.  Blinking a status light, monitoring other processes, etc.
 	}
 	log_message("Stop Radar");
 	stop_radar();
+	int status = check_golden_file();
 	log_message("Stop Display");
 #ifndef _RTP_Headless
 	StopRadarDisp();
@@ -156,10 +159,11 @@ int main()
 	StopConsoleMonitor();
 	if( consolethread.joinable())
 		consolethread.join();
+	gArena.release();	// Nothing is using the processing buffers now
 	log_message("Radar RTP terminated normally.");
 	close_log_file();
 	closeDebugDataFile();
 
-	return 0 ;  // would be (int) msg.wparam if only WIn32
+	return status ;  // would be (int) msg.wparam if only WIn32
 
 }
@@ -0,0 +1,134 @@
+// Long sweep matched filter
+// With TransmitLongSweep the sonar chirp lasts the whole block, so it can't be compressed one WRI at a
+// time.  This correlates the stream with the chirp by overlap-save fast convolution:
+//		y[n] = sum over m of x[n+m] conj(h[m]),  m = 0 .. SweepLen-1
+// For n in the previous block, x[n+m] reaches at most SweepLen-1 samples into the new block, so the
+// circular correlation of [previous block, new block] with the zero padded replica has no wrap around
+// in its first SweepLen outputs.
+// The transmit repeats every sweep and the sweeps start with the blocks, so output n is the echo
+// from n samples of delay.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "radarc.h"
+#include "matchedFilter.h"
+
+
+// Replica is the baseband (mixed down) sweep, SweepLenIn samples
+int LongSweepFilter::initialize(CPI_Params InitParams, unsigned int SweepLenIn, const RTPComplex *Replica)
+{
+	SweepLen = SweepLenIn;
+	NFFT = 2 * SweepLen;
+	NumRadars = InitParams.NumSensorsSet;
+	Buf = (fftwf_complex *)fftwf_malloc(NFFT * sizeof(fftwf_complex));
+	if (Buf == NULL) {
+		log_message("Error %d: Can't allocate memory for the long sweep matched filter, exiting", GetLastError());
+		exit(9L);
+	}
+
+	std::unique_lock<std::mutex> fftwPlanLockU(fftwPlanLock);
+	Forward = fftwf_plan_dft_1d(NFFT, Buf, Buf, FFTW_FORWARD, fftwPlanFlags());
+	Inverse = fftwf_plan_dft_1d(NFFT, Buf, Buf, FFTW_BACKWARD, fftwPlanFlags());
+	if ((Forward == NULL) || (Inverse == NULL)) {
+		log_message("Error %d: Creating fftw plan failed in %s : line %d , exiting...", GetLastError(), __FILE__, __LINE__);
+		exit(4);
+	}
+	fftwPlanLockU.unlock();
+
+	// Spectrum of the replica padded to twice its length.  Conjugated for correlation and scaled for
+	// the inverse FFT.
+	for (unsigned int k = 0; k < NFFT; k++) {
+		Buf[k][0] = (k < SweepLen) ? Replica[k].real() : 0.0f;
+		Buf[k][1] = (k < SweepLen) ? Replica[k].imag() : 0.0f;
+	}
+	fftwf_execute(Forward);
+	ReplicaSpec.resize(NFFT);
+	const float scale = 1.0f / (float)NFFT;
+	for (unsigned int k = 0; k < NFFT; k++) ReplicaSpec[k] = RTPComplex(Buf[k][0] * scale, -Buf[k][1] * scale);
+
+	Mixer.resize(SweepLen);
+	for (unsigned int k = 0; k < SweepLen; k++)
+		Mixer[k] = (RTPComplex)exp(std::complex<double>(0.0, -(TWOPI)*((double)k)*gRadarConfig.SonarFreq / gRadarConfig.SampleRate));
+	BlockStep = (RTPComplex)exp(std::complex<double>(0.0, -(TWOPI)*((double)SweepLen)*gRadarConfig.SonarFreq / gRadarConfig.SampleRate));
+	Last.assign(NumRadars * SweepLen, RTPComplex(0.0f, 0.0f));
+	Primed.assign(NumRadars, false);
+	log_message("Long sweep matched filter: %u sample sweep, %u point FFTs", SweepLen, NFFT);
+	return 0;
+}
+
+// In is one block (SweepLen samples) of raw data.  The first NumLags delays of the previous sweep's
+// range profile are written to Profile.
+void LongSweepFilter::filterBlock(const RTPComplex *In, RTPComplex *Profile, unsigned int NumLags, unsigned int Radar)
+{
+	RTPComplex *last = &Last[Radar * SweepLen];
+	float *buf = &Buf[0][0];
+	const float *x = reinterpret_cast<const float *>(In), *lo = reinterpret_cast<const float *>(&Mixer[0]);
+	float *prev = reinterpret_cast<float *>(last);
+	const float sr = BlockStep.real(), si = BlockStep.imag();
+
+	// [previous block, new block mixed to baseband], and the new block is kept for next time.  Mixer
+	// starts over with each block, so the new half is rotated on by one block to carry on the phase of
+	// the previous half.  The copy kept is on its own block's time, ready to be the previous half.
+	memcpy(buf, prev, SweepLen * sizeof(RTPComplex));
+	for (unsigned int k = 0; k < SweepLen; k++) {
+		float br = x[2 * k] * lo[2 * k] - x[2 * k + 1] * lo[2 * k + 1];
+		float bi = x[2 * k] * lo[2 * k + 1] + x[2 * k + 1] * lo[2 * k];
+		prev[2 * k] = br;
+		prev[2 * k + 1] = bi;
+		buf[2 * (SweepLen + k)] = br * sr - bi * si;
+		buf[2 * (SweepLen + k) + 1] = br * si + bi * sr;
+	}
+	if (!Primed[Radar]) {	// Nothing before the first block
+		Primed[Radar] = true;
+		for (unsigned int k = 0; k < NumLags; k++) Profile[k] = RTPComplex(0.0f, 0.0f);
+		return;
+	}
+
+	fftwf_execute(Forward);
+	const float *h = reinterpret_cast<const float *>(&ReplicaSpec[0]);
+	for (unsigned int k = 0; k < NFFT; k++) {
+		float xr = buf[2 * k], xi = buf[2 * k + 1];
+		buf[2 * k] = xr * h[2 * k] - xi * h[2 * k + 1];
+		buf[2 * k + 1] = xr * h[2 * k + 1] + xi * h[2 * k];
+	}
+	fftwf_execute(Inverse);
+	memcpy((void *)Profile, buf, MIN(NumLags, SweepLen) * sizeof(RTPComplex));
+}
+
+void LongSweepFilter::restart()
+{
+	Primed.assign(Primed.size(), false);
+}
+
+void LongSweepFilter::cleanup()
+{
+	std::unique_lock<std::mutex> fftwPlanLockU(fftwPlanLock);
+	if (Forward != NULL) fftwf_destroy_plan(Forward);
+	if (Inverse != NULL) fftwf_destroy_plan(Inverse);
+	Forward = Inverse = NULL;
+	fftwPlanLockU.unlock();
+	if (Buf != NULL) fftwf_free(Buf);
+	Buf = NULL;
+}
+
+bool longSweepOn()
+{
+	return gRadarConfig.Sonar && (gRadarConfig.ProcessingMode == SonarRangeDoppler) &&
+		gRadarState.TransmitLongSweep && (LongSweepReplica != NULL);
+}
@@ -0,0 +1,50 @@
+#pragma once
+// Long sweep matched filter header file
+// Streaming fast convolution (overlap-save) of the received data with a chirp that lasts a whole block.
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+#include "CPIParameters.h"
+#include <vector>
+extern "C" {
+#include <fftw3.h>
+}
+
+// Correlates each radar's stream with the replica of one sweep, SweepLen = NSamplesPerWRI*NWRIPerBlock
+// samples.  Each block is mixed to baseband and FFT'd together with the block before it (2*SweepLen
+// points), multiplied by the replica spectrum and transformed back, which gives the correlation for
+// every delay of the sweep that started with the previous block.  So there is one block of latency,
+// and the output of each block is the range profile of one sweep.
+// The plans, the replica spectrum and the mixer are made once.  The last block of each radar is kept
+// for the next one.  Runs on the dispatch thread.
+typedef struct LongSweepFilter {
+	int initialize(CPI_Params InitParams, unsigned int SweepLenIn, const RTPComplex *Replica);
+	void filterBlock(const RTPComplex *In, RTPComplex *Profile, unsigned int NumLags, unsigned int Radar);
+	void restart();		// After a gap in the data, the previous block isn't the one before the next
+	void cleanup();
+private:
+	unsigned int SweepLen = 0, NFFT = 0, NumRadars = 0;
+	fftwf_complex *Buf = NULL;				// FFT work space, NFFT points
+	fftwf_plan Forward = NULL, Inverse = NULL;
+	std::vector<RTPComplex> ReplicaSpec;	// Conjugate of the replica spectrum, scaled for the inverse FFT
+	std::vector<RTPComplex> Mixer;			// Down conversion over one sweep
+	RTPComplex BlockStep;					// Mixer phase advance over one sweep
+	std::vector<RTPComplex> Last;			// Previous block of each radar at baseband, [radar][SweepLen]
+	std::vector<bool> Primed;
+} LongSweepFilter;
+
+// True when the sonar sweep is the whole block and there is a replica for it
+bool longSweepOn();
@@ -0,0 +1,101 @@
+// Moving target indicator
+// Stationary returns are the same from one WRI to the next at each range sample, so a filter along slow
+// time with a zero at zero Doppler removes them before the Doppler FFT.  The filter is linear and the
+// same for every range sample, so it can be applied before the range FFT and the IQ calibration.  A DC
+// offset is stationary too, so it is removed along with the clutter (see CalPublisher).
+// The two and three pulse cancellers have a wide notch.  The recursive clutter map has a notch whose
+// width is set by MTITimeConstant, so it keeps the slow parts of the swing, but takes a few time
+// constants to settle after start up.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "radarc.h"
+#include "mti.h"
+
+
+int MTIFilter::initialize(CPI_Params InitParams, unsigned int NWRIPerBlockIn)
+{
+	Method = (MTIMethod)gRadarConfig.MTIType;
+	Samp_Per_WRI = InitParams.Samp_Per_WRI;
+	NWRIPerBlock = NWRIPerBlockIn;
+	Hist1.assign(2 * Samp_Per_WRI * InitParams.NumSensorsSet, 0.0f);
+	Hist2.assign(2 * Samp_Per_WRI * InitParams.NumSensorsSet, 0.0f);
+	Primed.assign(InitParams.NumSensorsSet, false);
+
+	double TWRI = Samp_Per_WRI / gRadarConfig.SampleRate;
+	Beta = (gRadarConfig.MTITimeConstant > 0.0) ? (float)(1.0 - exp(-TWRI / gRadarConfig.MTITimeConstant)) : 1.0f;
+	switch (Method) {
+	case MTITwoPulse: log_message("MTI: two pulse canceller"); break;
+	case MTIThreePulse: log_message("MTI: three pulse canceller"); break;
+	case MTIRecursive: log_message("MTI: recursive clutter map, time constant %.2f s", gRadarConfig.MTITimeConstant); break;
+	default: break;
+	}
+	return 0;
+}
+
+void MTIFilter::restart()
+{
+	Primed.assign(Primed.size(), false);
+}
+
+// Filters one block of NWRIPerBlock WRIs for one radar.  In and Out must not overlap.
+void MTIFilter::filterBlock(const RTPComplex *In, RTPComplex *Out, unsigned int Radar)
+{
+	const unsigned int nf = 2 * Samp_Per_WRI;
+	float *h1 = &Hist1[Radar * nf], *h2 = &Hist2[Radar * nf];
+	const float beta = Beta;
+
+	if (!Primed[Radar]) {	// Start as if the clutter had always been there, so the first output is zero
+		const float *x = reinterpret_cast<const float *>(In);
+		for (unsigned int j = 0; j < nf; j++) h1[j] = h2[j] = x[j];
+		Primed[Radar] = true;
+	}
+
+	for (unsigned int w = 0; w < NWRIPerBlock; w++) {
+		const float *x = reinterpret_cast<const float *>(&In[w * Samp_Per_WRI]);
+		float *y = reinterpret_cast<float *>(&Out[w * Samp_Per_WRI]);
+		switch (Method) {
+		case MTITwoPulse:
+			for (unsigned int j = 0; j < nf; j++) {
+				float v = x[j];
+				y[j] = v - h1[j];
+				h1[j] = v;
+			}
+			break;
+		case MTIThreePulse:
+			for (unsigned int j = 0; j < nf; j++) {
+				float v = x[j];
+				y[j] = v - 2.0f * h1[j] + h2[j];
+				h2[j] = h1[j];
+				h1[j] = v;
+			}
+			break;
+		case MTIRecursive:
+			for (unsigned int j = 0; j < nf; j++) {
+				float d = x[j] - h1[j];
+				y[j] = d;
+				h1[j] += beta * d;
+			}
+			break;
+		default:
+			memcpy(y, x, nf * sizeof(float));
+			break;
+		}
+	}
+}
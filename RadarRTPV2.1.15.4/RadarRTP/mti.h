@@ -0,0 +1,46 @@
+#pragma once
+// Moving target indicator (MTI) header file
+// Removes the stationary clutter (walls, the pendulum frame) that otherwise fills the zero Doppler row.
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+#include "CPIParameters.h"
+#include <vector>
+
+enum MTIMethod {
+	MTIOff = 0,
+	MTITwoPulse,		// y[n] = x[n] - x[n-1]
+	MTIThreePulse,		// y[n] = x[n] - 2x[n-1] + x[n-2]
+	MTIRecursive		// y[n] = x[n] - c[n-1], with c a fading memory average of x (clutter map)
+};
+
+// Slow time filter applied to each range sample.  It runs on the dispatch thread on each new block
+// as it arrives, so the filter state carries on from one block to the next and only the new WRIs are
+// filtered.  The workers get the filtered CPI.  Every range sample of a WRI is filtered the same way,
+// so the inner loops run along the WRI and vectorize.
+// The cancellers aren't scaled: white noise comes out 3dB (two pulse) or 7.8dB (three pulse) higher.
+typedef struct MTIFilter {
+	MTIMethod Method = MTIOff;
+
+	int initialize(CPI_Params InitParams, unsigned int NWRIPerBlockIn);
+	void filterBlock(const RTPComplex *In, RTPComplex *Out, unsigned int Radar);
+	void restart();		// After a gap in the data, start again from the next WRI
+private:
+	unsigned int Samp_Per_WRI = 0, NWRIPerBlock = 0;
+	float Beta = 0.0f;					// Clutter map update gain, 1 - exp(-T_WRI / time constant)
+	std::vector<float> Hist1, Hist2;	// Last two WRIs or the clutter map, [radar][2*Samp_Per_WRI]
+	std::vector<bool> Primed;			// Radar has had its first WRI
+} MTIFilter;
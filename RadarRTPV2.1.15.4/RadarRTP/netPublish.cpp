@@ -0,0 +1,681 @@
+// This module publishes processed results to other processes (trackers, loggers, dashboards) over the network.
+// The output gather thread hands each completed set of radar results to NetPublishFrame(), which copies
+// them into a bounded queue of preallocated frames and returns.  A separate thread encodes and sends
+// the frames so that a slow, or missing, consumer never holds up the signal processing.  When the queue
+// is full the newest frame is dropped and counted.
+// Either UDP datagrams or a TCP stream can be used, both on non-blocking sockets.  All of the messages
+// for one CPI are sent together.  The message layout is in netPublish.h.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "radarc.h"
+#include "netPublish.h"
+#include "precession.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <chrono>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET NetSocket;
+#define NET_INVALID_SOCKET INVALID_SOCKET
+#define NetCloseSocket(s) closesocket(s)
+#define NetSocketError() WSAGetLastError()
+#define NetWouldBlock(err) (((err) == WSAEWOULDBLOCK) || ((err) == WSAEINPROGRESS))
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+typedef int NetSocket;
+#define NET_INVALID_SOCKET (-1)
+#define NetCloseSocket(s) close(s)
+#define NetSocketError() errno
+#define NetWouldBlock(err) (((err) == EWOULDBLOCK) || ((err) == EAGAIN) || ((err) == EINPROGRESS))
+#endif
+
+#define NET_SEND_TIMEOUT_MS 50		// Longest a TCP send will wait on a full socket before giving up on the connection
+#define NET_RECONNECT_SEC 2			// Time between TCP connection attempts
+
+// One CPI worth of results waiting to be sent
+typedef struct NetFrame {
+	CPI_Params Params;
+	int NumRecords = 0;
+	NetDetectionRecord Records[MaxRadars*(MaxDetections + 1)];	// Peak and CFAR detections of each radar
+	bool HasRDI = false;
+	std::vector<float> RDI;			// [NumSensorsSet][Samp_Per_WRI*Num_WRI] copy of the RDI power in dB
+} NetFrame;
+
+// State used to code the RDI tiles.  Kept separate from the queue so the loopback test can use its own copy.
+typedef struct NetEncoder {
+	unsigned int NumCells = 0;
+	unsigned int NumSensors = 0;
+	float QuantStep = 0.1f;
+	int KeyFrameInterval = 50;
+	uint32_t FrameSeq = 0;
+	bool NeedKeyFrame = true;
+	std::vector<int16_t> Quant;		// Quantized cells of the radar being coded
+	std::vector<int16_t> Ref;		// [NumSensors][NumCells] cells as last sent, for the frame difference
+	std::vector<uint8_t> Msg;		// One message (datagram)
+	std::vector<uint8_t> Batch;		// All messages for a frame when using TCP
+} NetEncoder;
+
+typedef struct NetSender {
+	NetSocket Sock = NET_INVALID_SOCKET;
+	bool UseTCP = false;
+	bool Connected = false;
+	sockaddr_in Dest;
+	std::chrono::steady_clock::time_point NextConnect;
+	unsigned long DatagramsDropped = 0;
+	unsigned long SendErrors = 0;
+} NetSender;
+
+// Queue between the gather thread and the publisher thread.  Frames are preallocated at startup.
+static std::vector<NetFrame> NetQueue;
+static int NetQueueHead = 0;		// Next frame to send
+static int NetQueueCount = 0;		// Frames waiting
+static std::mutex NetQueueLock;
+static std::condition_variable NetDataHere;
+static bool NetStopRequested = FALSE;
+static bool NetRunning = FALSE;
+static std::thread NetThread;
+static unsigned long NetFramesSent = 0;
+static unsigned long NetFramesDropped = 0;
+static unsigned long NetFramesFailed = 0;	// Frames with a message that didn't go out
+
+static NetEncoder NetEnc;
+static NetSender NetOut;
+
+// Forward declare routines local to this module
+static void NetPublisherFunction();
+static int NetLoopbackSelfTest();
+
+
+// Zig-zag varint helpers for the RDI cell coder
+static inline size_t NetPutVarint(uint32_t val, uint8_t *out)
+{
+	size_t n = 0;
+	while (val >= 0x80) {
+		out[n++] = (uint8_t)(val | 0x80);
+		val >>= 7;
+	}
+	out[n++] = (uint8_t)val;
+	return n;
+}
+
+static inline int NetGetVarint(const uint8_t *in, size_t nbytes, size_t *pos, uint32_t *val)
+{
+	uint32_t result = 0;
+	for (int shift = 0; shift < 32; shift += 7) {
+		if (*pos >= nbytes) return -1;
+		uint8_t byte = in[(*pos)++];
+		result |= ((uint32_t)(byte & 0x7f)) << shift;
+		if (!(byte & 0x80)) {
+			*val = result;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+size_t NetEncodeCells(const int16_t *Cur, int16_t *Ref, unsigned int Count, bool KeyFrame, uint8_t *Out)
+{
+	size_t nbytes = 0;
+	uint32_t zeros = 0;
+	for (unsigned int i = 0; i < Count; i++) {
+		int32_t delta = KeyFrame ? (int32_t)Cur[i] : (int32_t)Cur[i] - (int32_t)Ref[i];
+		Ref[i] = Cur[i];
+		if (delta == 0) {
+			zeros++;
+			continue;
+		}
+		if (zeros) {	// A zero byte introduces a run of unchanged cells
+			Out[nbytes++] = 0;
+			nbytes += NetPutVarint(zeros, &Out[nbytes]);
+			zeros = 0;
+		}
+		nbytes += NetPutVarint(((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31), &Out[nbytes]);
+	}
+	if (zeros) {
+		Out[nbytes++] = 0;
+		nbytes += NetPutVarint(zeros, &Out[nbytes]);
+	}
+	return nbytes;
+}
+
+int NetDecodeCells(const uint8_t *In, size_t NBytes, int16_t *Ref, unsigned int Count, bool KeyFrame)
+{
+	size_t pos = 0;
+	unsigned int cell = 0;
+	uint32_t val;
+	while ((pos < NBytes) && (cell < Count)) {
+		if (In[pos] == 0) {		// Run of unchanged cells
+			pos++;
+			if (NetGetVarint(In, NBytes, &pos, &val)) return -1;
+			if ((val == 0) || (val > Count - cell)) return -1;
+			for (uint32_t k = 0; k < val; k++, cell++) {
+				if (KeyFrame) Ref[cell] = 0;
+			}
+		}
+		else {
+			if (NetGetVarint(In, NBytes, &pos, &val)) return -1;
+			int32_t delta = (int32_t)(val >> 1) ^ -(int32_t)(val & 1);
+			Ref[cell] = (int16_t)(KeyFrame ? delta : (int32_t)Ref[cell] + delta);
+			cell++;
+		}
+	}
+	if ((cell != Count) || (pos != NBytes)) return -1;
+	return 0;
+}
+
+
+static int NetSetNonBlocking(NetSocket sock)
+{
+#ifdef _WIN32
+	u_long mode = 1;
+	return (ioctlsocket(sock, FIONBIO, &mode) == 0) ? 0 : -1;
+#else
+	int flags = fcntl(sock, F_GETFL, 0);
+	if (flags < 0) return -1;
+	return fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+// Wait up to timeout_ms for the socket to become writable. Returns 1 if writable.
+static int NetWaitWritable(NetSocket sock, int timeout_ms)
+{
+	fd_set wset;
+	FD_ZERO(&wset);
+	FD_SET(sock, &wset);
+	timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	return select((int)sock + 1, NULL, &wset, NULL, &tv);
+}
+
+static void NetCloseSender(NetSender &S)
+{
+	if (S.Sock != NET_INVALID_SOCKET) {
+		NetCloseSocket(S.Sock);
+		S.Sock = NET_INVALID_SOCKET;
+	}
+	S.Connected = false;
+	S.NextConnect = std::chrono::steady_clock::now() + std::chrono::seconds(NET_RECONNECT_SEC);
+}
+
+static int NetOpenSender(NetSender &S, const char *host, int port, bool useTCP)
+{
+	S.UseTCP = useTCP;
+	memset(&S.Dest, 0, sizeof(S.Dest));
+	S.Dest.sin_family = AF_INET;
+	S.Dest.sin_port = htons((unsigned short)port);
+	if (inet_pton(AF_INET, host, &S.Dest.sin_addr) != 1) {
+		log_message("Warning: Network publisher address '%s' is not a valid IPv4 address", host);
+		return -1;
+	}
+	S.Sock = socket(AF_INET, useTCP ? SOCK_STREAM : SOCK_DGRAM, useTCP ? IPPROTO_TCP : IPPROTO_UDP);
+	if (S.Sock == NET_INVALID_SOCKET) {
+		log_message("Warning: Unable to create network publisher socket, %d", NetSocketError());
+		return -1;
+	}
+	if (NetSetNonBlocking(S.Sock)) {
+		log_message("Warning: Unable to make network publisher socket non-blocking, %d", NetSocketError());
+		NetCloseSender(S);
+		return -1;
+	}
+	if (!useTCP) {
+		S.Connected = true;
+		return 0;
+	}
+	// Non-blocking connect. The connection completes in the background and is checked before the next send
+	if (connect(S.Sock, (sockaddr *)&S.Dest, sizeof(S.Dest)) == 0) {
+		S.Connected = true;
+	}
+	else if (!NetWouldBlock(NetSocketError())) {
+		NetCloseSender(S);
+		return -1;
+	}
+	return 0;
+}
+
+// For TCP make sure a connection exists or is being made.  Returns true when data can be sent.
+static bool NetCheckConnection(NetSender &S, const char *host, int port)
+{
+	if (!S.UseTCP) return (S.Sock != NET_INVALID_SOCKET);
+	if (S.Connected) return true;
+	if (S.Sock == NET_INVALID_SOCKET) {
+		if (std::chrono::steady_clock::now() < S.NextConnect) return false;
+		if (NetOpenSender(S, host, port, true)) return false;
+		if (S.Connected) return true;
+	}
+	if (NetWaitWritable(S.Sock, 0) <= 0) return false;
+	int soerr = 0;
+	socklen_t len = sizeof(soerr);
+	getsockopt(S.Sock, SOL_SOCKET, SO_ERROR, (char *)&soerr, &len);
+	if (soerr != 0) {
+		NetCloseSender(S);
+		return false;
+	}
+	S.Connected = true;
+	log_message("Network publisher connected to %s:%d", host, port);
+	return true;
+}
+
+static void NetSendDatagram(NetSender &S, const uint8_t *buf, size_t nbytes)
+{
+	int sent = (int)sendto(S.Sock, (const char *)buf, (int)nbytes, 0, (sockaddr *)&S.Dest, sizeof(S.Dest));
+	if (sent != (int)nbytes) {
+		if ((sent < 0) && NetWouldBlock(NetSocketError())) S.DatagramsDropped++;
+		else S.SendErrors++;
+	}
+}
+
+// Send the whole buffer on the TCP stream.  A stream can't drop part of a message, so if the consumer
+// stops reading for longer than NET_SEND_TIMEOUT_MS the connection is closed and retried later.
+static int NetSendStream(NetSender &S, const uint8_t *buf, size_t nbytes)
+{
+	size_t done = 0;
+	while (done < nbytes) {
+		int sent = (int)send(S.Sock, (const char *)&buf[done], (int)(nbytes - done), 0);
+		if (sent > 0) {
+			done += sent;
+			continue;
+		}
+		if ((sent < 0) && NetWouldBlock(NetSocketError()) && (NetWaitWritable(S.Sock, NET_SEND_TIMEOUT_MS) > 0))
+			continue;
+		S.SendErrors++;
+		log_message("Warning: Network publisher TCP send failed or timed out, closing connection");
+		NetCloseSender(S);
+		return -1;
+	}
+	return 0;
+}
+
+static size_t NetPutHeader(uint8_t *buf, const NetEncoder &E, const NetFrame &Frame, uint16_t msgType, uint16_t nrec, uint16_t payload)
+{
+	NetFrameHeader hdr;
+	hdr.Magic = NET_MAGIC;
+	hdr.Version = NET_VERSION;
+	hdr.MsgType = msgType;
+	hdr.FrameSeq = E.FrameSeq;
+	hdr.BlockID = Frame.Params.block_id;
+	hdr.TOVusec = (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+		(gStreamSysTimeRef + Frame.Params.Data_TOVtt).time_since_epoch()).count();
+	hdr.SampPerWRI = (uint16_t)Frame.Params.Samp_Per_WRI;
+	hdr.NumWRI = (uint16_t)Frame.Params.Num_WRI;
+	hdr.NumRecords = nrec;
+	hdr.PayloadBytes = payload;
+	memcpy(buf, &hdr, sizeof(hdr));
+	return sizeof(hdr);
+}
+
+// Either send the message now (UDP) or add it to the frame batch (TCP)
+static void NetEmit(NetEncoder &E, NetSender &S, size_t nbytes)
+{
+	if (S.UseTCP)
+		E.Batch.insert(E.Batch.end(), E.Msg.begin(), E.Msg.begin() + nbytes);
+	else
+		NetSendDatagram(S, &E.Msg[0], nbytes);
+}
+
+// Returns false if any message of the frame wasn't sent
+static bool NetEncodeAndSend(NetEncoder &E, NetSender &S, const NetFrame &Frame)
+{
+	const unsigned long Failures = S.DatagramsDropped + S.SendErrors;
+	const size_t hdrSize = sizeof(NetFrameHeader);
+	E.Batch.clear();
+
+	// Detection records, as many to a message as will fit
+	const int recPerMsg = (int)((NET_MAX_DATAGRAM - hdrSize) / sizeof(NetDetectionRecord));
+	for (int first = 0; first < Frame.NumRecords; first += recPerMsg) {
+		int nrec = MIN(recPerMsg, Frame.NumRecords - first);
+		size_t payload = nrec * sizeof(NetDetectionRecord);
+		size_t pos = NetPutHeader(&E.Msg[0], E, Frame, NetMsgDetections, (uint16_t)nrec, (uint16_t)payload);
+		memcpy(&E.Msg[pos], &Frame.Records[first], payload);
+		NetEmit(E, S, pos + payload);
+	}
+
+	// RDI tiles. Each tile is sized so the worst case coding still fits in one datagram
+	if (Frame.HasRDI) {
+		const unsigned long TileFailures = S.DatagramsDropped + S.SendErrors;
+		bool keyFrame = E.NeedKeyFrame || ((E.KeyFrameInterval > 0) && ((E.FrameSeq % E.KeyFrameInterval) == 0));
+		const unsigned int cellsPerTile = (unsigned int)((NET_MAX_DATAGRAM - hdrSize - sizeof(NetTileHeader) - 4) / 3);
+		const float scale = 1.0f / E.QuantStep;
+		for (unsigned int rindex = 0; rindex < E.NumSensors; rindex++) {
+			const float *pRDI = &Frame.RDI[rindex*E.NumCells];
+			for (unsigned int i = 0; i < E.NumCells; i++) {
+				float q = floorf(pRDI[i] * scale + 0.5f);
+				q = MAX(q, -32768.0f);
+				q = MIN(q, 32767.0f);
+				E.Quant[i] = (int16_t)q;
+			}
+			int16_t *pRef = &E.Ref[rindex*E.NumCells];
+			for (unsigned int start = 0; start < E.NumCells; start += cellsPerTile) {
+				unsigned int ncells = MIN(cellsPerTile, E.NumCells - start);
+				size_t pos = hdrSize + sizeof(NetTileHeader);
+				size_t coded = NetEncodeCells(&E.Quant[start], &pRef[start], ncells, keyFrame, &E.Msg[pos]);
+				NetTileHeader tile;
+				tile.RadarChan = (uint8_t)rindex;
+				tile.KeyFrame = keyFrame ? 1 : 0;
+				tile.CellCount = (uint16_t)ncells;
+				tile.CellStart = start;
+				tile.QuantStep = E.QuantStep;
+				tile.EncodedBytes = (uint16_t)coded;
+				tile.Reserved = 0;
+				NetPutHeader(&E.Msg[0], E, Frame, NetMsgRDITile, 1, (uint16_t)(sizeof(NetTileHeader) + coded));
+				memcpy(&E.Msg[hdrSize], &tile, sizeof(tile));
+				NetEmit(E, S, pos + coded);
+			}
+		}
+		// The reference has moved on for every tile, so a tile the consumer never got leaves its
+		// deltas out of step until the next key frame
+		E.NeedKeyFrame = (S.DatagramsDropped + S.SendErrors) != TileFailures;
+	}
+
+	if (S.UseTCP && !E.Batch.empty()) {
+		if (NetSendStream(S, &E.Batch[0], E.Batch.size()))
+			E.NeedKeyFrame = true;	// The consumer will need a key frame when it reconnects
+	}
+	E.FrameSeq++;
+	return (S.DatagramsDropped + S.SendErrors) == Failures;
+}
+
+static void NetInitEncoder(NetEncoder &E, CPI_Params Params, float QuantStep, int KeyFrameInterval)
+{
+	E.NumCells = Params.Samp_Per_WRI*Params.Num_WRI;
+	E.NumSensors = Params.NumSensorsSet;
+	E.QuantStep = (QuantStep > 0.0f) ? QuantStep : 0.1f;
+	E.KeyFrameInterval = KeyFrameInterval;
+	E.FrameSeq = 0;
+	E.NeedKeyFrame = true;
+	E.Quant.assign(E.NumCells, 0);
+	E.Ref.assign(E.NumCells*E.NumSensors, 0);
+	E.Msg.assign(NET_MAX_DATAGRAM, 0);
+	E.Batch.clear();
+	E.Batch.reserve(NET_MAX_DATAGRAM * 4);
+}
+
+
+int startNetPublisher(CPI_Params Params)
+{
+	if (!gRadarConfig.NetPublish) return 0;
+
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+		log_message("Warning: Unable to start Winsock. Network publisher is off.");
+		return -1;
+	}
+#endif
+	if (gRadarConfig.NetSelfTest) NetLoopbackSelfTest();
+
+	// Preallocate the queue so that nothing is allocated while running
+	int depth = MAX(gRadarConfig.NetQueueDepth, 2);
+	NetQueue.resize(depth);
+	for (int i = 0; i < depth; i++) {
+		NetQueue[i].Params = Params;
+		if (gRadarConfig.NetSendRDI)
+			NetQueue[i].RDI.assign(Params.NumSensorsSet*Params.Samp_Per_WRI*Params.Num_WRI, 0.0f);
+	}
+	NetQueueHead = 0;
+	NetQueueCount = 0;
+	NetFramesSent = 0;
+	NetFramesDropped = 0;
+	NetFramesFailed = 0;
+	NetInitEncoder(NetEnc, Params, (float)gRadarConfig.NetRDIQuantdB, gRadarConfig.NetKeyFrameInterval);
+
+	NetOut = NetSender();
+	if (NetOpenSender(NetOut, gRadarConfig.NetHost.c_str(), gRadarConfig.NetPort, gRadarConfig.NetUseTCP)) {
+		log_message("Warning: Network publisher could not open socket to %s:%d. Will keep trying (TCP) or stay off (UDP).",
+			gRadarConfig.NetHost.c_str(), gRadarConfig.NetPort);
+	}
+
+	NetStopRequested = FALSE;
+	NetThread = std::thread(NetPublisherFunction);
+	NetRunning = TRUE;
+	log_message("Network publisher started: %s %s:%d, RDI tiles %s, queue depth %d",
+		gRadarConfig.NetUseTCP ? "TCP" : "UDP", gRadarConfig.NetHost.c_str(), gRadarConfig.NetPort,
+		gRadarConfig.NetSendRDI ? "on" : "off", depth);
+	return 0;
+}
+
+void stopNetPublisher()
+{
+	if (!NetRunning) return;
+	std::unique_lock<std::mutex> queuelock(NetQueueLock);
+	NetStopRequested = TRUE;
+	queuelock.unlock();
+	NetDataHere.notify_all();
+	if (NetThread.joinable()) NetThread.join();
+	NetCloseSender(NetOut);
+	NetRunning = FALSE;
+#ifdef _WIN32
+	WSACleanup();
+#endif
+	log_message("Network publisher stopped. Frames sent %lu, frames dropped (queue full) %lu, frames not sent in full %lu, "
+		"datagrams dropped %lu, send errors %lu",
+		NetFramesSent, NetFramesDropped, NetFramesFailed, NetOut.DatagramsDropped, NetOut.SendErrors);
+}
+
+// Called by the output gather thread once a full set of radar results is in gProcessedData.
+// The gather thread is the only writer of gProcessedData, so it is safe to read here without the lock.
+// Never blocks: if the publisher has fallen behind the frame is dropped.
+int NetPublishFrame(void)
+{
+	if (!NetRunning) return 0;
+
+	std::unique_lock<std::mutex> queuelock(NetQueueLock);
+	if (NetQueueCount >= (int)NetQueue.size()) {
+		NetFramesDropped++;
+		return 1;
+	}
+	int slot = (NetQueueHead + NetQueueCount) % (int)NetQueue.size();
+	queuelock.unlock();	// The slot is not visible to the publisher until the count is incremented
+
+	NetFrame &Frame = NetQueue[slot];
+	Frame.Params = gProcessedData.Params;
+	Frame.NumRecords = 0;
+	for (unsigned int rindex = 0; rindex < gProcessedData.Params.NumSensorsSet; rindex++) {
+		NetDetectionRecord &rec = Frame.Records[Frame.NumRecords++];
+		rec.RadarChan = (uint8_t)rindex;
+		rec.Flags = 0;
+		rec.RangeIndex = (uint16_t)gProcessedData.index_max_r[rindex];
+		rec.DopplerIndex = (uint16_t)gProcessedData.index_max_d[rindex];
+		rec.Reserved = 0;
+		rec.RangeFrac = gProcessedData.index_frac_r[rindex];
+		rec.DopplerFrac = gProcessedData.index_frac_d[rindex];
+		rec.Doppler = (float)RadialSpeed(rec.DopplerIndex + rec.DopplerFrac, Frame.Params.Num_WRI, gRadarConfig.UAmbDoppler);
+		rec.Amplitude = gProcessedData.peakAmplitude[rindex];
+
+		const DetectionList &dets = gProcessedData.Detections[rindex];
+		for (int k = 0; k < dets.NumDetections; k++) {
+			NetDetectionRecord &crec = Frame.Records[Frame.NumRecords++];
+			crec.RadarChan = (uint8_t)rindex;
+			crec.Flags = NetFlagCFAR;
+			crec.RangeIndex = (uint16_t)dets.Det[k].RangeIndex;
+			crec.DopplerIndex = (uint16_t)dets.Det[k].DopplerIndex;
+			crec.Reserved = 0;
+			crec.RangeFrac = dets.Det[k].RangeFrac;
+			crec.DopplerFrac = dets.Det[k].DopplerFrac;
+			crec.Doppler = (float)RadialSpeed(crec.DopplerIndex + crec.DopplerFrac, Frame.Params.Num_WRI, gRadarConfig.UAmbDoppler);
+			crec.Amplitude = dets.Det[k].Amplitude;
+		}
+	}
+	Frame.HasRDI = gRadarConfig.NetSendRDI;
+	if (Frame.HasRDI) {
+		unsigned int ncells = Frame.Params.Samp_Per_WRI*Frame.Params.Num_WRI;
+		for (unsigned int rindex = 0; rindex < Frame.Params.NumSensorsSet; rindex++)
+			memcpy(&Frame.RDI[rindex*ncells], gProcessedData.pRDIPower[rindex], ncells * sizeof(float));
+	}
+
+	queuelock.lock();
+	NetQueueCount++;
+	queuelock.unlock();
+	NetDataHere.notify_one();
+	return 0;
+}
+
+static void NetPublisherFunction()
+{
+	setThreadRole(ThreadRecorder);
+	log_message("Network publisher thread started.");
+	while (TRUE) {
+		std::unique_lock<std::mutex> queuelock(NetQueueLock);
+		while ((NetQueueCount == 0) && !NetStopRequested) {
+			NetDataHere.wait_for(queuelock, std::chrono::milliseconds(500));
+		}
+		if (NetStopRequested) break;
+		int slot = NetQueueHead;
+		queuelock.unlock();
+
+		if (NetCheckConnection(NetOut, gRadarConfig.NetHost.c_str(), gRadarConfig.NetPort)) {
+			if (NetEncodeAndSend(NetEnc, NetOut, NetQueue[slot])) NetFramesSent++;
+			else NetFramesFailed++;
+		}
+		else {
+			NetEnc.NeedKeyFrame = true;  // Nobody is listening, start over with a key frame
+			NetEnc.FrameSeq++;
+		}
+
+		queuelock.lock();
+		NetQueueHead = (NetQueueHead + 1) % (int)NetQueue.size();
+		NetQueueCount--;
+		queuelock.unlock();
+	}
+	log_message("Network publisher thread exiting.");
+}
+
+
+// Loopback test of the publisher using a stand-in receiver on 127.0.0.1.
+// Two synthetic frames (a key frame and a difference frame) are coded and sent over UDP, then received,
+// decoded and compared with what was sent.
+static int NetLoopbackSelfTest()
+{
+	log_message("Network publisher loopback self test starting.");
+	int result = -1;
+	NetSocket rx = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (rx == NET_INVALID_SOCKET) {
+		log_message("Warning: Network self test could not create the receive socket, %d", NetSocketError());
+		return -1;
+	}
+	sockaddr_in rxaddr;
+	memset(&rxaddr, 0, sizeof(rxaddr));
+	rxaddr.sin_family = AF_INET;
+	rxaddr.sin_port = 0;	// Any free port
+	inet_pton(AF_INET, "127.0.0.1", &rxaddr.sin_addr);
+	socklen_t alen = sizeof(rxaddr);
+	if ((bind(rx, (sockaddr *)&rxaddr, sizeof(rxaddr)) != 0) || (getsockname(rx, (sockaddr *)&rxaddr, &alen) != 0)) {
+		log_message("Warning: Network self test could not bind the receive socket, %d", NetSocketError());
+		NetCloseSocket(rx);
+		return -1;
+	}
+
+	// A small synthetic CPI with two radars
+	CPI_Params tp;
+	tp.Samp_Per_WRI = 64;
+	tp.Num_WRI = 32;
+	tp.NumSensorsSet = 2;
+	tp.block_id = 7;
+	tp.Data_TOVtt = DataTics(0);
+	unsigned int ncells = tp.Samp_Per_WRI*tp.Num_WRI;
+
+	NetEncoder txEnc;
+	NetInitEncoder(txEnc, tp, 0.1f, 0);
+	NetSender tx;
+	char txhost[INET_ADDRSTRLEN];
+	inet_ntop(AF_INET, &rxaddr.sin_addr, txhost, sizeof(txhost));
+	if (NetOpenSender(tx, txhost, ntohs(rxaddr.sin_port), false)) {
+		NetCloseSocket(rx);
+		return -1;
+	}
+
+	NetFrame frame;
+	frame.Params = tp;
+	frame.HasRDI = true;
+	frame.RDI.resize(tp.NumSensorsSet*ncells);
+	frame.NumRecords = tp.NumSensorsSet;
+	for (unsigned int r = 0; r < tp.NumSensorsSet; r++) {
+		memset(&frame.Records[r], 0, sizeof(NetDetectionRecord));
+		frame.Records[r].RadarChan = (uint8_t)r;
+		frame.Records[r].RangeIndex = (uint16_t)(10 + r);
+		frame.Records[r].Amplitude = -20.0f;
+	}
+
+	std::vector<int16_t> rxRef(tp.NumSensorsSet*ncells, 0), expect(tp.NumSensorsSet*ncells, 0);
+	std::vector<uint8_t> rxbuf(NET_MAX_DATAGRAM + 64);
+	bool ok = true;
+	int recordsSeen = 0;
+	for (int pass = 0; (pass < 2) && ok; pass++) {
+		// Noise floor with a target that moves one range bin between passes
+		for (unsigned int r = 0; r < tp.NumSensorsSet; r++)
+			for (unsigned int i = 0; i < ncells; i++) {
+				float val = -90.0f + (float)((i * 7 + r) % 13) * 0.1f;
+				if (i % tp.Samp_Per_WRI == (10 + r + pass)) val = -20.0f;
+				frame.RDI[r*ncells + i] = val;
+				expect[r*ncells + i] = (int16_t)floorf(val * 10.0f + 0.5f);
+			}
+		NetEncodeAndSend(txEnc, tx, frame);
+
+		// Drain everything that was sent for this frame
+		while (TRUE) {
+			fd_set rset;
+			FD_ZERO(&rset);
+			FD_SET(rx, &rset);
+			timeval tv;
+			tv.tv_sec = 0;
+			tv.tv_usec = 200000;
+			if (select((int)rx + 1, &rset, NULL, NULL, &tv) <= 0) break;
+			int n = (int)recv(rx, (char *)&rxbuf[0], (int)rxbuf.size(), 0);
+			if (n < (int)sizeof(NetFrameHeader)) { ok = false; break; }
+			NetFrameHeader hdr;
+			memcpy(&hdr, &rxbuf[0], sizeof(hdr));
+			if ((hdr.Magic != NET_MAGIC) || (hdr.PayloadBytes + sizeof(hdr) != (size_t)n)) { ok = false; break; }
+			if (hdr.MsgType == NetMsgDetections) {
+				recordsSeen += hdr.NumRecords;
+			}
+			else if (hdr.MsgType == NetMsgRDITile) {
+				NetTileHeader tile;
+				memcpy(&tile, &rxbuf[sizeof(hdr)], sizeof(tile));
+				if ((tile.RadarChan >= tp.NumSensorsSet) || (tile.CellStart + tile.CellCount > ncells) ||
+					NetDecodeCells(&rxbuf[sizeof(hdr) + sizeof(tile)], tile.EncodedBytes,
+						&rxRef[tile.RadarChan*ncells + tile.CellStart], tile.CellCount, tile.KeyFrame != 0)) {
+					ok = false;
+					break;
+				}
+			}
+		}
+		if (ok && (rxRef != expect)) ok = false;
+	}
+	if (ok && (recordsSeen == 2 * (int)tp.NumSensorsSet)) result = 0;
+
+	NetCloseSender(tx);
+	NetCloseSocket(rx);
+	if (result == 0)
+		log_message("Network publisher loopback self test passed.");
+	else
+		log_message("Warning: Network publisher loopback self test FAILED. Records received %d", recordsSeen);
+	return result;
+}
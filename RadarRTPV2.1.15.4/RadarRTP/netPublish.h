@@ -0,0 +1,82 @@
+#pragma once
+// Network publication of processed results
+// This header defines the binary records sent by the publisher in netPublish.cpp.  It is meant to be
+// usable by a remote consumer (tracker, logger, dashboard) without linking against the rest of RadarRTP.
+// All fields are little endian, the native order of every machine this has been run on.
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+#include <stdint.h>
+#include <stddef.h>
+
+#define NET_MAGIC 0x50545252u		// "RRTP" when read as bytes
+#define NET_VERSION 1
+#define NET_MAX_DATAGRAM 1472		// Largest UDP payload that fits an ethernet frame without fragmenting
+#define NetFlagCFAR 0x01
+
+enum NetMsgType {
+	NetMsgDetections = 1,			// Payload is NumRecords NetDetectionRecord
+	NetMsgRDITile = 2				// Payload is one NetTileHeader followed by the encoded cells
+};
+
+#pragma pack(push, 1)
+// Every datagram (UDP) or message (TCP) starts with this header
+typedef struct NetFrameHeader {
+	uint32_t Magic;				// NET_MAGIC
+	uint16_t Version;			// NET_VERSION
+	uint16_t MsgType;			// NetMsgType
+	uint32_t FrameSeq;			// Publisher frame counter. All messages from one CPI share the same value
+	uint32_t BlockID;			// Processing block counter from CPI_Params
+	int64_t  TOVusec;			// Time of validity, microseconds since 1970 (GMT)
+	uint16_t SampPerWRI;		// Range bins in the RDI
+	uint16_t NumWRI;			// Doppler bins in the RDI
+	uint16_t NumRecords;		// Detection records or tiles in this message
+	uint16_t PayloadBytes;		// Bytes following this header
+} NetFrameHeader;
+
+typedef struct NetDetectionRecord {
+	uint8_t  RadarChan;			// Radar that made the detection
+	uint8_t  Flags;				// NetFlagCFAR set for a CFAR detection, clear for the strongest peak in the RDI
+	uint16_t RangeIndex;		// Integer range bin
+	uint16_t DopplerIndex;		// Integer Doppler bin (before fftshift)
+	uint16_t Reserved;
+	float    RangeFrac;			// Fractional range bin offset
+	float    DopplerFrac;		// Fractional Doppler bin offset
+	float    Doppler;			// Speed in m/s
+	float    Amplitude;			// Peak power in dB
+} NetDetectionRecord;
+
+// The RDI for one radar is sent as a number of tiles, each a contiguous run of cells in the same
+// order as the pRDIPower array (range varies fastest).  Cells are quantized to QuantStep dB and
+// then coded as the difference from the same cell in the previous frame (or from zero for a key frame).
+// Differences are zig-zag mapped and written as base-128 varints, with a zero byte followed by a varint
+// count standing in for a run of unchanged cells.  See NetDecodeCells().
+typedef struct NetTileHeader {
+	uint8_t  RadarChan;
+	uint8_t  KeyFrame;			// 1 when the cells are coded relative to zero
+	uint16_t CellCount;			// Number of cells in this tile
+	uint32_t CellStart;			// Index of the first cell in the RDI
+	float    QuantStep;			// dB per count
+	uint16_t EncodedBytes;		// Bytes of coded cells following this header
+	uint16_t Reserved;
+} NetTileHeader;
+#pragma pack(pop)
+
+// Cell coder shared by the publisher and any receiver.  NetEncodeCells updates Ref to Cur as it goes.
+// Worst case output is 3 bytes per cell plus 4 bytes.
+size_t NetEncodeCells(const int16_t *Cur, int16_t *Ref, unsigned int Count, bool KeyFrame, uint8_t *Out);
+// Returns 0 on success, -1 if the coded data is malformed.  Ref is updated in place to the decoded cells.
+int NetDecodeCells(const uint8_t *In, size_t NBytes, int16_t *Ref, unsigned int Count, bool KeyFrame);
@@ -0,0 +1,131 @@
+// Gaussian noise for the simulated ADC
+// std::normal_distribution on the default engine draws one sample at a time, with a rejection loop,
+// and can't keep up with several channels at MHz sample rates.  This uses the Philox4x32-10 counter
+// based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC11): the four words
+// for counter n are a fixed function of the key and n.  A batch of counters is run through the ten
+// rounds together and the uniforms are turned into Gaussian pairs with Box-Muller, using polynomial
+// log, sin and cos so that the loops have no calls or branches and vectorize.  The polynomials are good
+// to about 1e-7, below the float resolution of the 24 bit uniforms.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "noise.h"
+#include <chrono>
+#include <string.h>
+#include <math.h>
+
+#define NoiseBatch 64	// Counters worked on together, 4 samples each
+
+void GaussNoise::seed(uint64_t Seed, uint32_t Stream)
+{
+	if (Seed == 0)
+		Seed = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+	Key[0] = (uint32_t)Seed;
+	Key[1] = (uint32_t)(Seed >> 32);
+	StreamID = Stream;
+	Counter = 0;
+}
+
+// ln(x) for x in (0,1]: x = m 2^e with m in [sqrt(1/2), sqrt(2)), ln(m) = 2 atanh((m-1)/(m+1))
+static inline float fastLog(float x)
+{
+	uint32_t b;
+	memcpy(&b, &x, sizeof(b));
+	b -= 0x3F3504F3u;	// sqrt(1/2), so the mantissa left is in [sqrt(1/2), sqrt(2))
+	int e = (int)b >> 23;
+	b = (b & 0x007FFFFFu) + 0x3F3504F3u;
+	float m;
+	memcpy(&m, &b, sizeof(m));
+	float t = (m - 1.0f) / (m + 1.0f), t2 = t * t;
+	float s = t * (2.0f + t2 * (0.6666666667f + t2 * (0.4f + t2 * (0.2857142857f + t2 * 0.2222222222f))));
+	return (float)e * 0.69314718056f + s;
+}
+
+// sin and cos of 2 pi u for u in [0,1): the quadrant is taken from u, the rest is a polynomial on
+// [-pi/4, pi/4] rotated by the middle of the quadrant.
+static inline void fastSinCos2Pi(float u, float &s, float &c)
+{
+	const float h = 0.70710678119f;
+	float v = u * 4.0f;
+	int q = (int)v;
+	float a = (v - (float)q - 0.5f) * 1.5707963268f, a2 = a * a;
+	float sa = a * (1.0f - a2 * (1.6666666667e-1f - a2 * (8.3333333333e-3f - a2 * (1.9841269841e-4f - a2 * 2.7557319224e-6f))));
+	float ca = 1.0f - a2 * (0.5f - a2 * (4.1666666667e-2f - a2 * (1.3888888889e-3f - a2 * 2.4801587302e-5f)));
+	// cos and sin of q pi/2 + pi/4, signs from the bits of q so there is no branch
+	float cb = h - 2.0f * h * (float)((q ^ (q >> 1)) & 1);
+	float sb = h - 2.0f * h * (float)(q >> 1);
+	c = cb * ca - sb * sa;
+	s = sb * ca + cb * sa;
+}
+
+void GaussNoise::fill(float *Out, size_t N, float StdDev)
+{
+	uint32_t c0[NoiseBatch], c1[NoiseBatch], c2[NoiseBatch], c3[NoiseBatch];
+	float R2[2 * NoiseBatch], Cos[2 * NoiseBatch], Sin[2 * NoiseBatch];
+	float Last[4 * NoiseBatch];
+
+	for (size_t done = 0; done < N; ) {
+		// Philox4x32-10 on NoiseBatch counters
+		for (int j = 0; j < NoiseBatch; j++) {
+			uint64_t n = Counter + j;
+			c0[j] = (uint32_t)n;
+			c1[j] = (uint32_t)(n >> 32);
+			c2[j] = StreamID;
+			c3[j] = 0;
+		}
+		uint32_t k0 = Key[0], k1 = Key[1];
+		for (int round = 0; round < 10; round++) {
+			for (int j = 0; j < NoiseBatch; j++) {
+				uint64_t p0 = (uint64_t)0xD2511F53u * c0[j];
+				uint64_t p1 = (uint64_t)0xCD9E8D57u * c2[j];
+				uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1[j] ^ k0;
+				uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3[j] ^ k1;
+				c1[j] = (uint32_t)p1;
+				c3[j] = (uint32_t)p0;
+				c0[j] = n0;
+				c2[j] = n2;
+			}
+			k0 += 0x9E3779B9u;
+			k1 += 0xBB67AE85u;
+		}
+		Counter += NoiseBatch;
+
+		// Box-Muller on (c0,c1) and (c2,c3).  The radius uses u in (0,1] so the log is finite.  The
+		// square root is in a loop of its own since its errno check keeps a loop from vectorizing.
+		for (int j = 0; j < NoiseBatch; j++) {
+			R2[2 * j] = -2.0f * fastLog((float)((c0[j] >> 8) + 1) * 5.9604644775e-8f);
+			R2[2 * j + 1] = -2.0f * fastLog((float)((c2[j] >> 8) + 1) * 5.9604644775e-8f);
+			fastSinCos2Pi((float)(c1[j] >> 8) * 5.9604644775e-8f, Sin[2 * j], Cos[2 * j]);
+			fastSinCos2Pi((float)(c3[j] >> 8) * 5.9604644775e-8f, Sin[2 * j + 1], Cos[2 * j + 1]);
+		}
+		size_t n = N - done;
+		float *o = (n >= 4 * NoiseBatch) ? &Out[done] : Last;
+		for (int j = 0; j < 2 * NoiseBatch; j++) {
+			float r = StdDev * sqrtf(R2[j]);
+			o[2 * j] = r * Cos[j];
+			o[2 * j + 1] = r * Sin[j];
+		}
+		if (o == Last) {	// Part of a batch at the end, the rest is dropped
+			memcpy(&Out[done], Last, n * sizeof(float));
+			done = N;
+		}
+		else
+			done += 4 * NoiseBatch;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+// Gaussian noise generator header file
+// Counter based random numbers (Philox4x32-10) turned into Gaussian samples with a Box-Muller transform.
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+#include <stdint.h>
+#include <stddef.h>
+
+// Each block of four random words is Philox(Key, Counter), so there is no state to carry from one
+// word to the next and a whole batch of counters is worked on at once (the loops vectorize).  The same
+// seed gives the same noise, and different streams of one seed don't overlap.
+typedef struct GaussNoise {
+	void seed(uint64_t Seed, uint32_t Stream = 0);	// Seed 0 takes one from the clock
+	void fill(float *Out, size_t N, float StdDev);		// N samples, zero mean
+	uint64_t position() const { return Counter; }		// Counters used so far (4 samples each)
+private:
+	uint32_t Key[2] = { 0, 0 };
+	uint32_t StreamID = 0;
+	uint64_t Counter = 0;
+} GaussNoise;
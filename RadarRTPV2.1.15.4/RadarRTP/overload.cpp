@@ -0,0 +1,176 @@
+// Overload control.
+// When the machine can't keep up, the ring buffer between the ADC and the dispatcher fills and blocks are lost
+// in over-runs (buff_mark_used).  A CPI made across the lost blocks has a jump in it, and isn't the data the
+// radar saw.  So the dispatcher watches the load and sheds work before that happens, in steps:
+//	1. CPIs are made from every 2nd, 4th, ... block, down to CPIs that no longer overlap
+//	2. Only 1 in OverloadDecimate frames is formatted for display
+//	3. The calibration is given 1 in OverloadDecimate blocks (or cal runs)
+//	4. The CPIs of a block are dropped, whole, while the load stays high
+// The load is the larger of the ring buffer occupancy and the time the dispatcher spent handing the last
+// block's CPIs to the workers (waiting for them to be free) over the time of a block.  After
+// OverloadStepBlocks blocks in a row over OverloadHigh it takes the next step, and after
+// OverloadRecoverBlocks blocks in a row under OverloadLow it takes the last one back.
+// Each step is logged, and the counts are reported when the processing stops.
+// If blocks are lost anyway, no CPIs are made until the CPI is clear of the gap, and the MTI and the long
+// sweep filter start again.  The gap is found and counted even when the control is off.
+// The control is off unless OverloadOn is set, and always off in virtual time, where the simulated ADC
+// waits and nothing is lost.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "radarc.h"
+
+static const char *StepNames[] = { "none", "CPI overlap", "display", "calibration", "drop CPIs" };	// By OverloadStep
+
+void OverloadControl::initialize(const CPI_Params &Params, bool LongSweep)
+{
+	On = gRadarConfig.OverloadOn && !gRadarConfig.VirtualTime;
+	NumRadars = MAX((int)Params.NumSensorsSet, 1);
+	BlockTime = (double)Params.Samp_Per_WRI * gRadarConfig.NWRIPerBlock / gRadarConfig.SampleRate;
+	// With the long sweep each block is one WRI (row) of the CPI
+	const int WRIPerBlock = LongSweep ? 1 : MAX(gRadarConfig.NWRIPerBlock, 1);
+	CPIBlocks = MAX(((int)Params.Num_WRI + WRIPerBlock - 1) / WRIPerBlock, 1);
+	MaxStride = 1;
+	while (2 * MaxStride <= CPIBlocks) MaxStride *= 2;
+
+	Step = OverloadNone;
+	Stride = 1;
+	LastFrame = -1;
+	Refill = SinceCPI = HighBlocks = LowBlocks = 0;
+	Load = PeakLoad = 0.0;
+	Frames = 0;
+	BlocksLost = CPIsSkipped = CPIsDropped = CPIsGap = FramesNotShown = CalBlocksSkipped = 0;
+	StepsUp = StepsDown = 0;
+	HighestStep = OverloadNone;
+	if (gRadarConfig.OverloadOn && gRadarConfig.VirtualTime) log_message("Overload control is off in virtual time");
+	else if (On) log_message("Overload control: shedding work at load %.2f, taking it back at %.2f. CPIs from every 1 to %d blocks",
+		gRadarConfig.OverloadHigh, gRadarConfig.OverloadLow, MaxStride);
+}
+
+// Blocks lost before this one, from the gap in the ADC frame counts.  The CPIs that would take in the gap aren't made.
+int OverloadControl::lostBlocks(int Frame)
+{
+	int Lost = (LastFrame >= 0) ? Frame - LastFrame - 1 : 0;
+	LastFrame = Frame;
+	if (Lost <= 0) return 0;	// Less than none when the ADC has been restarted
+	BlocksLost += Lost;
+	Refill = CPIBlocks - 1;		// This block is the first after the gap
+	log_message("Overload: %d blocks lost in a ring buffer over-run. No CPIs for %d blocks, until they are past the gap",
+		Lost, Refill);
+	return Lost;
+}
+
+bool OverloadControl::dispatch(int RingDepth, double WorkerWait)
+{
+	Load = MIN(MAX((double)RingDepth / (NBUFF - 1), WorkerWait / BlockTime), 1.0);
+	PeakLoad = MAX(PeakLoad, Load);
+	if (On) {
+		HighBlocks = (Load >= gRadarConfig.OverloadHigh) ? HighBlocks + 1 : 0;
+		LowBlocks = (Load <= gRadarConfig.OverloadLow) ? LowBlocks + 1 : 0;
+		if ((HighBlocks >= gRadarConfig.OverloadStepBlocks) && stepUp()) {
+			HighBlocks = 0;
+			log_message("Overload: load %.2f, ring buffer %d of %d blocks, %.1f ms for the workers. Shedding: %s",
+				Load, RingDepth, NBUFF - 1, 1e3 * WorkerWait, stepText().c_str());
+		}
+		else if ((LowBlocks >= gRadarConfig.OverloadRecoverBlocks) && stepDown()) {
+			LowBlocks = 0;
+			log_message("Overload: load %.2f. Back to: %s. %lu CPIs skipped, %lu dropped so far",
+				Load, stepText().c_str(), CPIsSkipped.load(), CPIsDropped.load());
+		}
+	}
+
+	SinceCPI++;
+	if (Refill > 0) {
+		Refill--;
+		CPIsGap += NumRadars;
+		return false;
+	}
+	if (SinceCPI < Stride) {
+		CPIsSkipped += NumRadars;
+		return false;
+	}
+	if ((Step >= OverloadDrop) && (Load >= gRadarConfig.OverloadHigh)) {
+		CPIsDropped += NumRadars;
+		return false;
+	}
+	SinceCPI = 0;
+	return true;
+}
+
+bool OverloadControl::calBlock(unsigned int n)
+{
+	if ((Step < OverloadCal) || ((n % gRadarConfig.OverloadDecimate) == 0)) return true;
+	CalBlocksSkipped++;
+	return false;
+}
+
+bool OverloadControl::showFrame()
+{
+	bool Show = (Step < OverloadDisplay) || ((Frames % gRadarConfig.OverloadDecimate) == 0);
+	Frames++;
+	if (!Show) FramesNotShown++;
+	return Show;
+}
+
+// Overlap first, halving it until the CPIs just touch, then the other steps in order
+bool OverloadControl::stepUp()
+{
+	if ((Step <= OverloadOverlap) && (Stride < MaxStride)) {
+		Stride *= 2;
+		Step = OverloadOverlap;
+	}
+	else if (Step < OverloadDrop) Step = MAX(Step + 1, (int)OverloadDisplay);
+	else return false;	// Nothing more to shed
+	StepsUp++;
+	HighestStep = MAX(HighestStep, Step.load());
+	return true;
+}
+
+bool OverloadControl::stepDown()
+{
+	if (Step > OverloadDisplay) Step = Step - 1;
+	else if (Step == OverloadDisplay) Step = (Stride > 1) ? OverloadOverlap : OverloadNone;
+	else if (Stride > 1) {
+		Stride /= 2;
+		if (Stride == 1) Step = OverloadNone;
+	}
+	else return false;	// Nothing shed
+	StepsDown++;
+	return true;
+}
+
+std::string OverloadControl::stepText() const
+{
+	if (Step == OverloadNone) return "CPIs from every block";
+	std::stringstream msgstr;
+	msgstr << "CPIs from every " << Stride << " blocks";
+	if (Step >= OverloadDisplay) msgstr << ", 1 in " << gRadarConfig.OverloadDecimate << " frames displayed";
+	if (Step >= OverloadCal) msgstr << ", 1 in " << gRadarConfig.OverloadDecimate << " blocks calibrated";
+	if (Step >= OverloadDrop) msgstr << ", CPIs dropped while the load is over " << gRadarConfig.OverloadHigh;
+	return msgstr.str();
+}
+
+void OverloadControl::report() const
+{
+	if (!On && (BlocksLost == 0)) return;
+	log_message("Overload control: peak load %.2f, %lu steps up, %lu back, furthest step %s. %lu blocks lost in over-runs. "
+		"CPIs not made: %lu with less overlap, %lu dropped, %lu across lost blocks. %lu frames not displayed, %lu not calibrated",
+		PeakLoad, StepsUp, StepsDown, StepNames[HighestStep], BlocksLost.load(), CPIsSkipped.load(), CPIsDropped.load(),
+		CPIsGap.load(), FramesNotShown.load(), CalBlocksSkipped.load());
+}
@@ -0,0 +1,99 @@
+// Sub-bin peak refinement in range and Doppler
+// A peak in the range-Doppler map is split between bins unless the target falls exactly on a bin.
+// The fractional offset along each axis is estimated from the complex values of the peak bin and its
+// two neighbors on that axis, following "Fast, Accurate Frequency Estimators" IEEE SP mag May 2007:
+//		delta = Cal * Re { (y1 - y3)/(2 y2 - y1 - y3) }
+// Both axes are FFT outputs, so the neighbors wrap around at the edges.
+// The constant Cal depends on the window.  Rather than using a tabulated value (0.60 was used for
+// Hamming) it is fitted for each window as loaded, since windows can come from files.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "radarc.h"
+#include "peakRefine.h"
+
+// Least squares fit of Cal over tones offset from -0.45 to 0.45 bins.  The DFT of the windowed tone is
+// only needed at the three bins around the peak so it is done directly.
+float PeakWindowCal(const float *win, unsigned int n)
+{
+	if (n < 4) return 1.0f;
+	double num = 0.0, den = 0.0;
+	for (int step = -9; step <= 9; step++) {
+		if (step == 0) continue;
+		double delta = 0.05*step;
+		std::complex<double> X[3];
+		for (int m = -1; m <= 1; m++) {
+			std::complex<double> sum(0.0, 0.0);
+			for (unsigned int i = 0; i < n; i++)
+				sum += (double)win[i] * std::polar(1.0, TWOPI*(delta - m)*(double)i / (double)n);
+			X[m + 1] = sum;
+		}
+		double est = ((X[0] - X[2]) / (2.0*X[1] - X[0] - X[2])).real();
+		num += delta * est;
+		den += est * est;
+	}
+	if (den <= 0.0) return 1.0f;
+	return (float)(num / den);
+}
+
+int PeakRefiner::initialize(CPI_Params InitParams, const float *win_wri, const float *win_cpi)
+{
+	Nr = InitParams.Samp_Per_WRI;
+	Nd = InitParams.Num_WRI;
+	CalRange = PeakWindowCal(win_wri, Nr);
+	CalDoppler = PeakWindowCal(win_cpi, Nd);
+	return 0;
+}
+
+void PeakRefiner::refine(const fftwf_complex *pData, RadarDetection Dets[], int NumDets)
+{
+	for (int first = 0; first < NumDets; first += MaxDetections) {
+		const int n = MIN(MaxDetections, NumDets - first);
+		RadarDetection *pDet = &Dets[first];
+
+		// Gather the three points on each axis
+		for (int k = 0; k < n; k++) {
+			unsigned int r = (unsigned int)pDet[k].RangeIndex, d = (unsigned int)pDet[k].DopplerIndex;
+			unsigned int rm = (r == 0) ? Nr - 1 : r - 1, rp = (r == Nr - 1) ? 0 : r + 1;
+			unsigned int dm = (d == 0) ? Nd - 1 : d - 1, dp = (d == Nd - 1) ? 0 : d + 1;
+			const float *b = pData[d*Nr + r];
+			const float *a = pData[d*Nr + rm], *c = pData[d*Nr + rp];
+			Ar[k] = a[0]; Ai[k] = a[1]; Br[k] = b[0]; Bi[k] = b[1]; Cr[k] = c[0]; Ci[k] = c[1];
+			Cal[k] = CalRange;
+			a = pData[dm*Nr + r];
+			c = pData[dp*Nr + r];
+			Ar[n + k] = a[0]; Ai[n + k] = a[1]; Br[n + k] = b[0]; Bi[n + k] = b[1]; Cr[n + k] = c[0]; Ci[n + k] = c[1];
+			Cal[n + k] = CalDoppler;
+		}
+
+		// Estimate. No branches so the compiler can vectorize this loop.
+		for (int k = 0; k < 2 * n; k++) {
+			float nr = Ar[k] - Cr[k], ni = Ai[k] - Ci[k];
+			float dr = 2.0f*Br[k] - Ar[k] - Cr[k], di = 2.0f*Bi[k] - Ai[k] - Ci[k];
+			float f = Cal[k] * (nr*dr + ni * di) / (dr*dr + di * di + 1e-30f);
+			f = (f > 0.5f) ? 0.5f : f;
+			Frac[k] = (f < -0.5f) ? -0.5f : f;
+		}
+
+		for (int k = 0; k < n; k++) {
+			pDet[k].RangeFrac = Frac[k];
+			pDet[k].DopplerFrac = Frac[n + k];
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+// Sub-bin peak refinement header file
+// Oct 2026 Initial version, replaces the Doppler only PeakEstimate in processWorkers.cpp
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+#include "cfar.h"
+
+// Calibration constant of the three point estimator for a window of length n.  Found once at start up
+// by fitting the estimator to tones with known offsets, so any loaded window is handled.
+float PeakWindowCal(const float *win, unsigned int n);
+
+typedef struct PeakRefiner {
+	float CalRange = 1.0f;		// Estimator constant for the range (fast time) window
+	float CalDoppler = 1.0f;	// and for the Doppler (slow time) window
+
+	int initialize(CPI_Params InitParams, const float *win_wri, const float *win_cpi);
+	// Fill in RangeFrac and DopplerFrac for each detection from the complex range-Doppler map
+	void refine(const fftwf_complex *pData, RadarDetection Dets[], int NumDets);
+private:
+	unsigned int Nr = 0, Nd = 0;
+	// Structure of arrays work space so the estimator loop vectorizes. Range entries first, then Doppler.
+	float Ar[2 * MaxDetections], Ai[2 * MaxDetections];
+	float Br[2 * MaxDetections], Bi[2 * MaxDetections];
+	float Cr[2 * MaxDetections], Ci[2 * MaxDetections];
+	float Cal[2 * MaxDetections], Frac[2 * MaxDetections];
+} PeakRefiner;
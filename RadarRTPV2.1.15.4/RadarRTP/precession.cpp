@@ -0,0 +1,250 @@
+// Foucault precession estimator
+// Each radar sees the radial component of the bob velocity, vr_i = u_i . v, where u_i is the unit vector
+// from radar i toward the pendulum.  Averaged over one period of the swing,
+//		E[vr_i vr_j] = u_i' M u_j,		M = E[v v']
+// so the three numbers of M follow from the products of the radars' peak speeds by least squares (two
+// radars that aren't in line are enough).  The main eigenvector of M is along the major axis of the
+// swing.  Only the peak Doppler of each CPI is needed, and the peak amplitude is used to leave out CPIs
+// where a radar has lost the bob.
+// One angle is produced per swing and goes into a recursive least squares line fit against time, so
+// the precession rate and its confidence interval are available at any time without keeping history.
+// The expected rate is 360 sin(latitude) degrees per (sidereal) day.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "radarc.h"
+#include "precession.h"
+
+static PrecessionData Precession;
+static bool PrecessionRunning = FALSE;
+
+
+void PrecessionFit::reset(double ForgetFactor)
+{
+	Lambda = ForgetFactor;
+	W = W2 = 0.0;
+	MeanT = MeanA = 0.0;
+	Ctt = Cta = Caa = 0.0;
+	N = 0;
+}
+
+void PrecessionFit::add(double t, double a)
+{
+	// The old samples are weighted down by Lambda and the new one gets weight 1
+	Ctt *= Lambda;
+	Cta *= Lambda;
+	Caa *= Lambda;
+	W = Lambda * W + 1.0;
+	W2 = Lambda * Lambda * W2 + 1.0;
+	double dt = t - MeanT, da = a - MeanA;
+	MeanT += dt / W;
+	MeanA += da / W;
+	Ctt += dt * (t - MeanT);
+	Cta += dt * (a - MeanA);
+	Caa += da * (a - MeanA);
+	N++;
+}
+
+double PrecessionFit::slope() const
+{
+	return (Ctt > 0.0) ? Cta / Ctt : 0.0;
+}
+
+double PrecessionFit::slopeStdError() const
+{
+	if ((Ctt <= 0.0) || (W2 <= 0.0)) return -1.0;
+	double neff = W * W / W2;		// Effective number of samples
+	if (neff <= 2.5) return -1.0;
+	double rss = MAX(Caa - Cta * Cta / Ctt, 0.0);
+	double s2 = rss / W * neff / (neff - 2.0);
+	return sqrt(s2 * W2 / (W * Ctt));
+}
+
+
+int PrecessionData::initialize(CPI_Params InitParams)
+{
+	NumRadars = InitParams.NumSensorsSet;
+	double RadarX[MaxRadars], RadarY[MaxRadars];
+	RadarLocations(NumRadars, RadarX, RadarY);
+	for (int i = 0; i < NumRadars; i++) {
+		double d = MAX(sqrt(RadarX[i] * RadarX[i] + RadarY[i] * RadarY[i]), 1e-6);
+		Ux[i] = -RadarX[i] / d;
+		Uy[i] = -RadarY[i] / d;
+	}
+
+	// Normal equations for Mxx, Myy, Mxy over all of the radar pairs
+	double A[3][3] = { { 0.0 } };
+	for (int i = 0; i < NumRadars; i++) {
+		for (int j = i; j < NumRadars; j++) {
+			double h[3] = { Ux[i] * Ux[j], Uy[i] * Uy[j], Ux[i] * Uy[j] + Uy[i] * Ux[j] };
+			for (int r = 0; r < 3; r++)
+				for (int c = 0; c < 3; c++) A[r][c] += h[r] * h[c];
+		}
+	}
+	double det = A[0][0] * (A[1][1] * A[2][2] - A[1][2] * A[2][1]) - A[0][1] * (A[1][0] * A[2][2] - A[1][2] * A[2][0])
+		+ A[0][2] * (A[1][0] * A[2][1] - A[1][1] * A[2][0]);
+	if (fabs(det) < 1e-9) {
+		log_message("Warning: Precession estimate needs at least two radars at different angles. It is off.");
+		return -1;
+	}
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			int r1 = (c + 1) % 3, r2 = (c + 2) % 3, c1 = (r + 1) % 3, c2 = (r + 2) % 3;
+			NormInv[r][c] = (A[r1][c1] * A[r2][c2] - A[r1][c2] * A[r2][c1]) / det;
+		}
+	}
+
+	PeriodSec = TWOPI / sqrt(GEARTH / gRadarConfig.PendLength);
+	// Forgetting factor per swing from the memory in hours
+	double lambda = 1.0;
+	if (gRadarConfig.PrecessionMemory > 0.0) lambda = exp(-PeriodSec / (3600.0*gRadarConfig.PrecessionMemory));
+	Fit.reset(lambda);
+	for (int i = 0; i < MaxRadars; i++)
+		for (int j = 0; j < MaxRadars; j++) VV[i][j] = 0.0;
+	SumT = 0.0;
+	Count = 0;
+	Started = false;
+	AxisValid = false;
+	NextReport = gRadarConfig.PrecessionReportInterval;
+	Skipped = 0;
+	return 0;
+}
+
+void PrecessionData::addFrame(const CPI_Params &FrameParams, const float DopplerBin[], const float Amplitude[])
+{
+	if (!Started) {
+		SwingStart = FrameParams.Data_TOVtt;
+		FirstTOV = FrameParams.Data_TOVtt;
+		Started = true;
+	}
+
+	bool good = true;
+	for (int i = 0; i < NumRadars; i++) good = good && (Amplitude[i] >= gRadarConfig.PrecessionMinAmplitude);
+	if (good) {
+		double vr[MaxRadars];
+		for (int i = 0; i < NumRadars; i++) vr[i] = RadialSpeed(DopplerBin[i], FrameParams.Num_WRI, gRadarConfig.UAmbDoppler);
+		for (int i = 0; i < NumRadars; i++)
+			for (int j = i; j < NumRadars; j++) VV[i][j] += vr[i] * vr[j];
+		SumT += std::chrono::duration<double>(FrameParams.Data_TOVtt - FirstTOV).count();
+		Count++;
+	}
+	else Skipped++;
+
+	if (std::chrono::duration<double>(FrameParams.Data_TOVtt - SwingStart).count() >= PeriodSec) {
+		endSwing(FrameParams);
+		SwingStart = FrameParams.Data_TOVtt;
+	}
+}
+
+// One swing is complete.  Find its direction and add it to the fit.
+void PrecessionData::endSwing(const CPI_Params &FrameParams)
+{
+	int n = Count;
+	double tmid = (n > 0) ? SumT / n : 0.0;
+	double b[3] = { 0.0, 0.0, 0.0 };
+	for (int i = 0; i < NumRadars; i++) {
+		for (int j = i; j < NumRadars; j++) {
+			double e = (n > 0) ? VV[i][j] / n : 0.0;
+			b[0] += Ux[i] * Ux[j] * e;
+			b[1] += Uy[i] * Uy[j] * e;
+			b[2] += (Ux[i] * Uy[j] + Uy[i] * Ux[j]) * e;
+			VV[i][j] = 0.0;
+		}
+	}
+	SumT = 0.0;
+	Count = 0;
+	// Need most of the swing to get its direction
+	if (n * (double)gRadarConfig.NWRIPerBlock * gRadarConfig.NSamplesPerWRI / gRadarConfig.SampleRate < 0.5*PeriodSec) return;
+
+	double m[3];
+	for (int r = 0; r < 3; r++) m[r] = NormInv[r][0] * b[0] + NormInv[r][1] * b[1] + NormInv[r][2] * b[2];
+	double tr = m[0] + m[1], diff = sqrt((m[0] - m[1])*(m[0] - m[1]) + 4.0*m[2] * m[2]);
+	if ((tr <= 0.0) || (diff < 0.2*tr)) return;		// Nearly circular, no clear direction
+
+	double theta = 0.5*atan2(2.0*m[2], m[0] - m[1]);
+	if (AxisValid) {	// The axis is a line, so it is only known modulo pi
+		while (theta - AxisAngle > TWOPI / 4.0) theta -= TWOPI / 2.0;
+		while (theta - AxisAngle < -TWOPI / 4.0) theta += TWOPI / 2.0;
+	}
+	AxisAngle = theta;
+	AxisValid = true;
+	Fit.add(tmid / 3600.0, theta);
+
+	const double todeg = 360.0 / (TWOPI);
+	double se = Fit.slopeStdError();
+	PrecessionReport Rep;
+	Rep.BlockID = FrameParams.block_id;
+	Rep.Time = std::chrono::duration<double>(FrameParams.Data_TOVtt).count();
+	double axis = fmod(theta, TWOPI / 2.0);
+	if (axis > TWOPI / 4.0) axis -= TWOPI / 2.0;
+	if (axis <= -TWOPI / 4.0) axis += TWOPI / 2.0;
+	Rep.AxisAngle = axis * todeg;
+	Rep.Rate = Fit.slope()*todeg;
+	Rep.Rate95 = (se >= 0.0) ? 1.96*se*todeg : -1.0;
+	Rep.Swings = Fit.N;
+	if (gRadarState.DataRecording == TRUE) save_precession_data(Rep);
+
+	double elapsed = std::chrono::duration<double>(FrameParams.Data_TOVtt - FirstTOV).count();
+	if ((gRadarConfig.PrecessionReportInterval > 0.0) && (elapsed >= NextReport) && (se >= 0.0)) {
+		log_message("Precession %.3f +/- %.3f deg/hr (95%%) after %.2f hr, %lu swings. Axis %.2f deg",
+			Rep.Rate, Rep.Rate95, elapsed / 3600.0, Rep.Swings, Rep.AxisAngle);
+		NextReport = elapsed + gRadarConfig.PrecessionReportInterval;
+	}
+}
+
+void PrecessionData::finish()
+{
+	const double todeg = 360.0 / (TWOPI);
+	double se = Fit.slopeStdError();
+	double expected = 360.0 / 24.0 * sin(gRadarConfig.PendLatitude * (TWOPI) / 360.0);
+	if (se < 0.0) {
+		log_message("Precession: not enough swings for an estimate (%lu). Expected %.3f deg/hr.", Fit.N, expected);
+		return;
+	}
+	log_message("Precession %.3f +/- %.3f deg/hr (95%%) from %lu swings, %lu CPIs skipped. Foucault rate at %.2f deg latitude is %.3f deg/hr.",
+		Fit.slope()*todeg, 1.96*se*todeg, Fit.N, Skipped, gRadarConfig.PendLatitude, expected);
+}
+
+
+int startPrecession(CPI_Params Params)
+{
+	if (!gRadarConfig.PrecessionOn) return 0;
+	if (Precession.initialize(Params) != 0) return -1;
+	PrecessionRunning = TRUE;
+	log_message("Precession estimate started for %d radars", Params.NumSensorsSet);
+	return 0;
+}
+
+void stopPrecession()
+{
+	if (!PrecessionRunning) return;
+	PrecessionRunning = FALSE;
+	Precession.finish();
+}
+
+// Called by the gather thread with gProcessedData complete
+int PrecessionLoadFrame(void)
+{
+	if (!PrecessionRunning) return 0;
+	float bin[MaxRadars];
+	for (unsigned int rindex = 0; rindex < gProcessedData.Params.NumSensorsSet; rindex++)
+		bin[rindex] = (float)gProcessedData.index_max_d[rindex] + gProcessedData.index_frac_d[rindex];
+	Precession.addFrame(gProcessedData.Params, bin, gProcessedData.peakAmplitude);
+	return 0;
+}
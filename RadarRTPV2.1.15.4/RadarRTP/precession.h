@@ -0,0 +1,87 @@
+#pragma once
+// Foucault precession estimator header file
+// Measures how fast the plane of the swing turns, with a confidence interval, over hours or days of
+// data.  Nothing is kept from the past except running sums, so the memory used doesn't grow with time.
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+#include "stdafx.h"
+#include "CPIParameters.h"
+
+// Radial speed, m/s and positive going away, for a Doppler bin of the unshifted slow time FFT.
+// Bins past the middle are negative speeds.
+inline double RadialSpeed(double DopplerBin, unsigned int NumWRI, double UAmbDoppler)
+{
+	double nd = (double)NumWRI;
+	DopplerBin -= nd * floor(DopplerBin / nd + 0.5);
+	return UAmbDoppler * 2.0 * DopplerBin / nd;
+}
+
+// Recursive least squares straight line a = a0 + rate * t, with optional exponential forgetting.
+// The running means and centered cross products are updated in place (Welford's method), which
+// stays accurate after days of samples where raw sums of t and t^2 would lose precision.
+typedef struct PrecessionFit {
+	double Lambda = 1.0;		// Forgetting factor per sample, 1 keeps everything
+	double W = 0.0, W2 = 0.0;	// Sum of the weights and of their squares
+	double MeanT = 0.0, MeanA = 0.0;
+	double Ctt = 0.0, Cta = 0.0, Caa = 0.0;
+	unsigned long N = 0;
+
+	void reset(double ForgetFactor);
+	void add(double t, double a);
+	double slope() const;
+	double slopeStdError() const;	// Negative until there are enough samples
+} PrecessionFit;
+
+// What is recorded after each swing
+typedef struct PrecessionReport {
+	unsigned int BlockID;
+	double Time;			// Seconds since the stream started (Data_TOVtt)
+	double AxisAngle;		// Direction of the swing over the last period, degrees from the x axis
+	double Rate;			// Precession rate, degrees per hour
+	double Rate95;			// Half width of the 95% confidence interval on the rate, degrees per hour
+	unsigned long Swings;	// Swings in the fit
+} PrecessionReport;
+
+// Runs on the output gather thread.  Every CPI adds the products of the radars' peak radial speeds to
+// per radar running sums.  Over each pendulum period these give the covariance of the bob velocity,
+// whose main axis is the swing direction, and that angle goes into the line fit.
+typedef struct PrecessionData {
+	int initialize(CPI_Params InitParams);
+	void addFrame(const CPI_Params &FrameParams, const float DopplerBin[], const float Amplitude[]);
+	void finish();
+private:
+	int NumRadars = 0;
+	double Ux[MaxRadars], Uy[MaxRadars];		// Unit vector from each radar toward the pendulum
+	double NormInv[3][3];						// Inverse of the normal equations for the velocity covariance
+	double PeriodSec = 1.0;						// Pendulum period
+	double VV[MaxRadars][MaxRadars];			// Running sums of speed products for the current swing
+	double SumT = 0.0;
+	int Count = 0;
+	DataTics SwingStart, FirstTOV;
+	bool Started = false;
+	double AxisAngle = 0.0;						// Unwrapped, radians
+	bool AxisValid = false;
+	double NextReport = 0.0;					// Seconds, for the log
+	unsigned long Skipped = 0;
+	PrecessionFit Fit;							// Angle in radians against time in hours
+
+	void endSwing(const CPI_Params &FrameParams);
+} PrecessionData;
+
+int startPrecession(CPI_Params Params);
+void stopPrecession();
+int PrecessionLoadFrame(void);
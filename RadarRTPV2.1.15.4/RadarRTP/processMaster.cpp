@@ -66,7 +66,7 @@ int startProcessingThread(void)
 	/* Start it up */
 	threadSyncFlag = TRUE;
 	ResumeThread(tproc_thread_id.native_handle());
-#else /* Unix version is not implemented.  Does not seem to be needed.  */
+#else /* Elsewhere the thread sets its own priority and CPUs from [threads], see threads.cpp */
 
 #endif
 
@@ -95,6 +95,24 @@ int stopProcessingThread(void)
 }
 
 
+// Let the worker start on its batch
+static void handOver(pRadar_Data_Flowing Worker)
+{
+	Worker->OwnBuffers.lock();
+	Worker->InBufferFull = TRUE;
+	Worker->OwnBuffers.unlock();
+	Worker->DataHere.notify_all(); // Should only be one process waiting
+}
+
+// And every batch being filled
+static void handOverBatches(pRadar_Data_Flowing *pRadarDataArray, std::vector<int> &OpenWorker)
+{
+	for (int &Worker : OpenWorker) {
+		if (Worker >= 0) handOver(pRadarDataArray[Worker]);
+		Worker = -1;
+	}
+}
+
 // This is the routine that coordinates the signal processing work
 
 // TODO: If I were doing this now, I would use vectors of threads and vectors of smart data structures rather than fixing the number at compile time. 
@@ -118,64 +136,96 @@ int Process_data(void)
 	std::thread hGatherThread;
 	std::thread hCalibrateThread;
 	
-	RTPComplex DCOffset[MaxRadars], *DCOffsetVals[MaxRadars];
-
-	std::vector <RTPComplex> DCOffset1(gRadarState.NumSensorsSet* gRadarConfig.NSamplesPerWRI);
-
 	DataTics TOVtt;  // Time of validity in clock ticks
 
 	double 	phaseinc = 140.0*TWOPI / gRadarConfig.SampleRate;
 	double pendfreqinc = 0.125*TWOPI / gRadarConfig.SampleRate;
 	PendSimParms SimParms;
 	SimParms.RadarSimInit();
+	SimStage Sim;
 	
 	int thisADCFrameCount;  // Buffer count used for simulating the target
 
 	/* initialize */
+	setThreadRole(ThreadDispatcher);
 	log_message("Process Data thread starting.");
+	// Each radar's CPIs go to the workers of one NUMA node (one node, all of the workers, unless NumaOn).
+	// Set up first, so the raw data buffers below go on the dispatcher's node.
+	gNuma.initialize(gRadarConfig.NumThreads, gRadarState.NumSensorsSet);
 	Params.Num_WRI = gRadarConfig.NWRIPerCPI;
 	Params.Samp_Per_WRI = gRadarConfig.NSamplesPerWRI;
 	Params.block_id = 0;
 	Params.Data_TOVtt = std::chrono::duration<int>(0);
 	Params.NumSensorsSet = gRadarState.NumSensorsSet; 
+	Params.myType = (DataType)gRadarConfig.ProcessingMode;
 	RawDataBuffer RadarRawDat(Params, gRadarConfig.NWRIPerBlock, gRadarConfig.ReceiveRealOnly);
+	// With a long sonar sweep each block is matched filtered as it arrives and gives one row (sweep) of the CPI.
+	// Those rows go to the workers from their own buffer, which moves up one row per block.
+	LongSweepFilter LongSweep;
+	RawDataBuffer *pSweepDat = NULL;
+	if (longSweepOn()) {
+		LongSweep.initialize(Params, Params.Samp_Per_WRI * gRadarConfig.NWRIPerBlock, LongSweepReplica);
+		pSweepDat = new RawDataBuffer(Params, 1, FALSE);
+	}
+	// With MTI the workers get the filtered data from a second buffer. The calibration still uses the raw data.
+	MTIFilter Mti;
+	Mti.initialize(Params, gRadarConfig.NWRIPerBlock);
+	if ((pSweepDat != NULL) && (Mti.Method != MTIOff)) {
+		log_message("Warning: MTI is not used with the long sonar sweep");
+		Mti.Method = MTIOff;
+	}
+	RawDataBuffer *pMTIDat = NULL;
+	if (Mti.Method != MTIOff) pMTIDat = new RawDataBuffer(Params, gRadarConfig.NWRIPerBlock, gRadarConfig.ReceiveRealOnly);
+	RawDataBuffer &WorkerDat = (pSweepDat != NULL) ? *pSweepDat : (pMTIDat != NULL) ? *pMTIDat : RadarRawDat;
+	gOverload.initialize(Params, pSweepDat != NULL);
 		
-	sensordata< RTPComplex> SimData(Params);
 	sensordata< RTPComplex> RadarDat((unsigned int)gRadarConfig.NWRIPerCPI, 
 		(unsigned int)gRadarConfig.NSamplesPerWRI,
 		(unsigned int)gRadarState.NumSensorsSet);
 
-	SimData(0, 0, 0) = RTPComplex(0.0, 1.0);
-	//std::cout << "SimData" << SimData(0, 0, 0)<<std::endl;
 
-	std::vector<floatdim4> CalXform1(gRadarState.NumSensorsSet);
-	// load default cal constant to initialize. True values applied later.
-	for (int rindex = 0; rindex < gRadarState.NumSensorsSet; rindex++) {
-		CalXform1[rindex] = gRadarConfig.CalTransForm[rindex];
-	}
+	// The workers take the calibration from here. It starts with the configured values, updates come from the cal.
+	gCalPublished.initialize(Params, gRadarConfig.NumThreads);
+	Sim.initialize(&SimParms, gRadarConfig.SimThreads);
 
 	log_message("Setting up worker threads.");
 
 	// Set up and initialize the worker threads
 	
+	WorkerRoute Route;
+	CPIOrder Order;		// The gather thread takes the results in the order the CPIs are handed out
+	std::vector<int> OpenWorker(gNuma.NumNodes, -1);	// Worker of each node whose batch is being filled
 	StartWorkerThreads(pRadarDataArray, hWorkerThreads, gRadarConfig.NumThreads, Params);
 
 	// The following delay is just to give the threads time to start, which makes the logging look nicer. It is not needed functionally
 	std::this_thread::sleep_for(std::chrono::milliseconds(150));
 
+	// The network publisher (if enabled) takes results from the output thread, so start it first
+	startNetPublisher(Params);
+	startTracker(Params);
+	startFusion(Params);
+	startPrecession(Params);
+
 	// Start up output accumulation thread that merges and aligns the results from the different processing threads
 	OThreadStopRequest = FALSE;
-	hGatherThread = std::thread(OutputWorkerFunction, pRadarDataArray, Params);
+	hGatherThread = std::thread(OutputWorkerFunction, pRadarDataArray, Params, &Order);
 
 	CalData RadarCalDat(Params);
 	RadarCalDat.initializeCal(Params);
 	std::unique_lock <std::mutex> CalBufferlock(RadarCalDat.OwnBuffers, std::defer_lock);  // Declare mutex for buffer
-	hCalibrateThread = std::thread(&CalData::CalibrateFunction, &RadarCalDat, 5);
+	// Streaming calibration is done here as each block arrives, otherwise on its own thread with a CPI now and then
+	if (gRadarConfig.CalStreaming) {
+		RadarCalDat.initHistory();
+		RadarCalDat.startStateWriter();
+	}
+	else hCalibrateThread = std::thread(&CalData::CalibrateFunction, &RadarCalDat, 5);
 
 	log_message("Finished init of processing and worker threads");
 
 	threadSyncFlag = FALSE;  // This will let main processing thread know we have completed initialization.
 	NextThread = 0;
+	std::chrono::steady_clock::time_point RunStart, RunEnd;	// Wall clock time of the virtual time run
+	double WorkerWait = 0.0;	// Time the last block's CPIs took to hand to the workers, see overload.cpp
 	
 	// Loop and dispatch data for processing
 	while (TRUE) {
@@ -213,22 +263,35 @@ int Process_data(void)
 		// and other odd effects.  
 		// Using this as the time refererence introduced a different timing problem since pendulum swings too slowly in
 		// simulation at high (>1MSPS) sample rates. Since it is not observed normally, then I haven't determined why that is
+		// With the simulated ADC the ADC times also come from the sample count, so the two agree.
 		thisADCFrameCount = Buff_count[dataIndex];
+		if (count == 0) RunStart = std::chrono::steady_clock::now();
 		
-		double ADCSimTime = ((double)thisADCFrameCount)*(Params.Samp_Per_WRI*gRadarConfig.NWRIPerBlock) 
-			/ gRadarConfig.SampleRate;
 		buff_free();  /* Free this buffer */
+		// Blocks lost in a ring buffer over-run leave a gap in the data. The MTI and the long sweep filter start again after it.
+		if (gOverload.lostBlocks(thisADCFrameCount) > 0) {
+			Mti.restart();
+			LongSweep.restart();
+		}
 		
 	// Do some checking on whether the sim is on and whether the amplitude is in bounds
 	// Set the simulated signal amplitude to the value from the current configuration
 	// The configuration value is in dBfs, so convert to linear amplitude
 		float SimAmpLin = 0.01f;
 		if (gRadarState.SimOn) {
-			//std::cout << " " << thisADCFrameCount << " " << ADCSimTime;
 			// Generate the simulated data. (TODO: Verify the simulation amplitude is in bounds)
-			SimParms.simTargetData(ADCSimTime, &SimData, gRadarState.SimAmp);
-
-			RadarRawDat.AddSimData(&SimData, offset);
+			const RTPComplex *SimBlock = Sim.next(thisADCFrameCount, gRadarState.SimAmp);
+			for (int rindex = 0; rindex < gRadarState.NumSensorsSet; rindex++)
+				RadarRawDat.AddSimBlock(&SimBlock[rindex * Params.Samp_Per_WRI * gRadarConfig.NWRIPerBlock], rindex, offset);
+		}
+		if (pMTIDat != NULL) {
+			for (int rindex = 0; rindex < gRadarState.NumSensorsSet; rindex++)
+				Mti.filterBlock(RadarRawDat.Block(rindex, offset), pMTIDat->Block(rindex, offset), rindex);
+		}
+		if (pSweepDat != NULL) {
+			for (int rindex = 0; rindex < gRadarState.NumSensorsSet; rindex++)
+				LongSweep.filterBlock(RadarRawDat.Block(rindex, offset), pSweepDat->Block(rindex, Params.Samp_Per_WRI * (Params.Num_WRI - 1)),
+					Params.Samp_Per_WRI, rindex);
 		}
 
 		// This dispatches the data to the processing worker threads.
@@ -238,48 +301,91 @@ int Process_data(void)
 		// As originally written, when this routine skipped an update to avoid buffer over-run, it confused the accumulation thread.
 		// Corrected by using lock() instead of try_lock().  Seems to help, but the logic should be reviewed.
 		// Fill the buffer on the next worker thread and then kick it off.
-		for (int rindex = 0; rindex < gRadarState.NumSensorsSet; rindex++) {
+		// In virtual time nothing may be dropped: wait for the worker to finish its last CPI and for the gather
+		// thread to take the results.  The calibration is also picked here, rather than when the worker gets to it.
+		// Each worker is given a batch of up to BatchCPIs CPIs, which is handed over when it is full.  Until
+		// then it is filled from the blocks queued in the ring buffer, so the batches get bigger when the
+		// processing falls behind and stay at one block's CPIs when it is keeping up.  A batch isn't started on a
+		// worker the gather thread hasn't finished with, as it would mix the CPIs of the two.
+		// When the processing is falling behind, or the CPIs would span lost blocks, this block's aren't made.
+		const int DispatchNode = gNuma.currentNode();
+		const int BatchMax = gRadarConfig.BatchCPIs;
+		const bool Dispatch = gOverload.dispatch(buff_depth(), WorkerWait);
+		std::chrono::steady_clock::time_point DispatchStart = std::chrono::steady_clock::now();
+		for (int rindex = 0; Dispatch && (rindex < gRadarState.NumSensorsSet); rindex++) {
+			const int Node = gNuma.RadarNode[rindex];
+			const bool NewBatch = (OpenWorker[Node] < 0);
+			if (NewBatch) {
+				NextThread = Route.next(rindex);
+				if (gRadarConfig.VirtualTime || (BatchMax > 1)) {
+					std::unique_lock<std::mutex> workerlock(pRadarDataArray[NextThread]->OwnBuffers);
+					if (pRadarDataArray[NextThread]->InBufferFull || pRadarDataArray[NextThread]->OutBufferFull) {
+						// The gather thread may be waiting for a batch that is still being filled
+						workerlock.unlock();
+						handOverBatches(pRadarDataArray, OpenWorker);
+						workerlock.lock();
+					}
+					// A stop request is seen here too, as the worker may never come free
+					while ((pRadarDataArray[NextThread]->InBufferFull || pRadarDataArray[NextThread]->OutBufferFull) && !threadSyncFlag)
+						pRadarDataArray[NextThread]->DataHere.wait_for(workerlock, std::chrono::milliseconds(100));
+					if (threadSyncFlag) break;
+				}
+				OpenWorker[Node] = NextThread;
+			}
+			NextThread = OpenWorker[Node];
 			pRadarDataArray[NextThread]->OwnBuffers.lock(); { // Lock the buffer so I own it.
 			//if (pRadarDataArray[NextThread]->OwnBuffers.try_lock()) { // Lock the buffer so I own it.
-			// Now own the data buffer.  Fill it with data then kickoff processing task.
-
-				RadarRawDat.CopyOut((RTPComplex*) pRadarDataArray[NextThread]->pData, rindex);
-
-				pRadarDataArray[NextThread]->Params.block_id = count;
-				pRadarDataArray[NextThread]->Params.Data_TOVtt = TOVtt;
+			// Now own the data buffer.  Fill the next slot of the batch with data.
+				if (NewBatch) pRadarDataArray[NextThread]->NumSlots = 0;
+				CPISlot &Slot = pRadarDataArray[NextThread]->Slots[pRadarDataArray[NextThread]->NumSlots++];
+
+				WorkerDat.CopyOut((RTPComplex*) Slot.pData, rindex);
+				if (gNuma.NumNodes > 1) {
+					int WorkerNode = gNuma.WorkerNode[NextThread];
+					gNuma.countCopy(DispatchNode, WorkerNode, Params.Samp_Per_WRI * Params.Num_WRI * sizeof(RTPComplex));
+					if ((DispatchNode >= 0) && (DispatchNode != WorkerNode)) gNuma.RemoteCPIs++;
+				}
 
-				pRadarDataArray[NextThread]->RadarChan = rindex;
+				Slot.Params.block_id = count;
+				Slot.Params.Data_TOVtt = TOVtt;
 
-				pRadarDataArray[NextThread]->DCOffset = DCOffset[rindex];
-				pRadarDataArray[NextThread]->CalTransform = CalXform1[rindex]; // Gain and correlation cal constants
+				Slot.RadarChan = rindex;
+				// Calibration coefficients are picked up by the worker from gCalPublished
+				if (gRadarConfig.VirtualTime) Slot.PinnedCal = gCalPublished.acquire();
 
-				pRadarDataArray[NextThread]->InBufferFull = TRUE;
 				pRadarDataArray[NextThread]->OwnBuffers.unlock();
-
-				// Now the persample DC offset
-				if (!gRadarConfig.DC_CalOnly) {
-					for (unsigned int sampIdx = 0; sampIdx < Params.Samp_Per_WRI; sampIdx++)
-						pRadarDataArray[NextThread]->DCOffsetArr[sampIdx] = DCOffsetVals[rindex][sampIdx];
-
-				}
 			}
+			Order.push(NextThread);
 
-			// Wake SP thread item to get started.
-			pRadarDataArray[NextThread]->DataHere.notify_all(); // Should only be one process waiting
-			NextThread++;
-			if (NextThread >= (gRadarConfig.NumThreads)) NextThread = 0;
+			// Wake SP thread item to get started once the batch is full.
+			if (pRadarDataArray[NextThread]->NumSlots >= BatchMax) {
+				handOver(pRadarDataArray[NextThread]);
+				OpenWorker[Node] = -1;
+			}
 		}
+		// Nothing more to add to the batches yet, so don't hold them
+		if (buff_depth() == 0) handOverBatches(pRadarDataArray, OpenWorker);
+		WorkerWait = std::chrono::duration<double>(std::chrono::steady_clock::now() - DispatchStart).count();
 
 		count++;  // Increment processed block counter	
+		RunEnd = std::chrono::steady_clock::now();
 		gRadarState.Current_block_id = count; // Update the counter for the radar state
 
 		if (threadSyncFlag == TRUE) break; // signaled to stop, so break out of loop and stop
-		if (gRadarState.AutoCalOn) {
+		if (gRadarState.AutoCalOn && gRadarConfig.CalStreaming) {
+			// Fold the new block into the calibration. Same data the workers got, including any simulated target.
+			const RTPComplex *Block[MaxRadars];
+			for (int rindex = 0; rindex < gRadarState.NumSensorsSet; rindex++)
+				Block[rindex] = RadarRawDat.Block(rindex, offset);
+			if (gOverload.calBlock(count)) RadarCalDat.updateBlock(Block, gRadarConfig.NWRIPerBlock);
+		}
+		else if (gRadarState.AutoCalOn) {
 			// Kickoff calibration thread 
-			if (((count - 20) % 50) == 0) {  // every so often- currently every 50th CPI, start calibration task
+			if ((((count - 20) % 50) == 0) && gOverload.calBlock((count - 20) / 50)) {  // every so often- currently every 50th CPI, start calibration task
 											  // Grab the calibration data buffer
-
-				if (CalBufferlock.try_lock()) {
+				// In virtual time wait for the cal thread, and below for its result, so it is the same on every run
+				if (gRadarConfig.VirtualTime) CalBufferlock.lock();
+				if (CalBufferlock.owns_lock() || CalBufferlock.try_lock()) {
 					for (int rindex = 0; rindex < gRadarState.NumSensorsSet; rindex++) {
 						//memcpy(&RadarCalDat.pCalData[rindex][0][0], pRadarRawDat[rindex],
 						//	(Params.Samp_Per_WRI*Params.Num_WRI) * sizeof(fftwf_complex));
@@ -288,6 +394,10 @@ int Process_data(void)
 
 					RadarCalDat.Params = Params;
 					RadarCalDat.InBufferFull = TRUE;
+					if (gRadarConfig.VirtualTime) {
+						RadarCalDat.DataHere.notify_one();
+						while (!RadarCalDat.Cal_ready) RadarCalDat.DataHere.wait(CalBufferlock);
+					}
 					CalBufferlock.unlock();
 				}
 				else { log_message("Warning: Cal routine not ready for data, try later..."); }
@@ -297,22 +407,16 @@ int Process_data(void)
 		// Now prepare for next data block - move raw data up in buffer
 		
 		RadarRawDat.MoveUp();
-		// If a previously kicked off cal thread completed the update, then copy and start using it
+		if (pMTIDat != NULL) pMTIDat->MoveUp();
+		if (pSweepDat != NULL) pSweepDat->MoveUp();
+		// If the cal has an update, publish it for the workers to start using
 		if (gRadarState.AutoCalOn) {
-			if (CalBufferlock.try_lock()) {
+			if (gRadarConfig.VirtualTime) CalBufferlock.lock();
+			if (CalBufferlock.owns_lock() || CalBufferlock.try_lock()) {
 				if (RadarCalDat.Cal_ready) {
-					for (int rindex = 0; rindex < gRadarState.NumSensorsSet; rindex++) {
-						DCOffset[rindex] = RadarCalDat.DCOffset[rindex];
-						CalXform1[rindex] = RadarCalDat.CalXform[rindex];
-						
-						if (!RadarCalDat.CalDCOnly) {
-							// Copy per WRI sample DC offset values
-							memcpy(&DCOffsetVals[rindex][0], &RadarCalDat.pOffsetsdat[rindex][0],
-								(Params.Samp_Per_WRI * sizeof(fftwf_complex)));
-							
-						}
-
-					}
+					gCalPublished.publish(&RadarCalDat.DCOffset[0], &RadarCalDat.CalXform[0],
+						RadarCalDat.CalDCOnly ? NULL : &RadarCalDat.pOffsetsdat[0],
+						(RadarCalDat.NumBands > 0) ? &RadarCalDat.CalXformBand[0] : NULL);
 					RadarCalDat.Cal_ready = FALSE;
 				}
 				CalBufferlock.unlock();
@@ -331,14 +435,36 @@ int Process_data(void)
 	RadarCalDat.InBufferFull = TRUE;
 
 	hGatherThread.join();
-	hCalibrateThread.join();
-	cleanupCalThread(&RadarCalDat, &DCOffsetVals[0], &DCOffset[0]);
+	stopNetPublisher();
+	stopTracker();
+	stopFusion();
+	stopPrecession();
+	if (hCalibrateThread.joinable()) hCalibrateThread.join();
+	else {
+		RadarCalDat.stopStateWriter();
+		RadarCalDat.logFinal();
+	}
+	cleanupCalThread(&RadarCalDat, NULL, NULL);
 
 	char logmsg[128];
 	snprintf(logmsg, sizeof(logmsg), "Stopping signal processing. Total data blocks processed = %d", count);
 	log_message((const char *)logmsg);
+	if (gRadarConfig.VirtualTime && (count > 0)) {
+		double WallTime = std::chrono::duration<double>(RunEnd - RunStart).count();
+		double DataTime = count * ((double)Params.Samp_Per_WRI * gRadarConfig.NWRIPerBlock) / gRadarConfig.SampleRate;
+		log_message("Virtual time run: %d blocks, %.3f s of data in %.3f s, %.1f blocks/s, %.2f times real time",
+			count, DataTime, WallTime, count / MAX(WallTime, 1e-9), DataTime / MAX(WallTime, 1e-9));
+	}
+
+	gNuma.report();
+	gOverload.report();
 
 	stopWorkerThreads(pRadarDataArray, hWorkerThreads, 	gRadarConfig.NumThreads);
+	gCalPublished.cleanup();
+	Sim.cleanup();
+	delete pMTIDat;
+	delete pSweepDat;
+	LongSweep.cleanup();
 
 	log_message("All signal processing threads have been signaled");
 	/* stop thread and exit */
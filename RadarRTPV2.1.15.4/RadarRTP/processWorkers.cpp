@@ -56,6 +56,13 @@ bool OThreadStopRequest = FALSE;
 // To stop contention for non-thread-safe fft_plan
 std::mutex fftwPlanLock;
 
+// FFTW_MEASURE times the candidate algorithms, so the plan, and the last bits of the results, can change from
+// one run or one worker to the next.  Virtual time runs are compared bit for bit, so they plan from the sizes.
+unsigned int fftwPlanFlags(void)
+{
+	return gRadarConfig.VirtualTime ? FFTW_ESTIMATE : FFTW_MEASURE;
+}
+
 void hamming(float *vector, int nsamp)
 {
 	float a = 0.53836f, b = 0.46164f;
@@ -121,22 +128,6 @@ void fftshift(float* datarray, const int nrow, const int ncol)
 }
 
 
-// From "Fast, Accurate Frequency Estimators" IEEE SP mag May 2007, 
-// Cal value for the following windows is: Hanning 0.55, Hamming 0.60, Blackman-Harris 0.56
-// Default window is Hamming. Saved windows are Chebychev, so should be similar to BH
-// Curve fit and then interpolate to find more accurate Doppler frequency for peak
-// The equation is delta = Re { (y1 - y2)/(2 y2 - y1 -y3) }
-float PeakEstimate(RTPComplex *a, RTPComplex *b, RTPComplex *c, float cal_val)
-{
-	float index_frac1;
-	RTPComplex ntemp, dtemp;
-	ntemp = (*a) - (*c);
-	dtemp = 2.0f * (*b) + (*a) + (*c);
-	index_frac1 = cal_val* (ntemp / dtemp).real();
-	
-	return(index_frac1);
-}
-
 void stopWorkerThreads(pRadar_Data_Flowing  *pRadarDataArray,
 	std::thread  hWorkerThreads[],
 	int numThreads)
@@ -169,14 +160,9 @@ void stopWorkerThreads(pRadar_Data_Flowing  *pRadarDataArray,
 
 	}
 
-	if (pRadarDataArray[0]->pPRI_WGT) {
-		free(pRadarDataArray[0]->pPRI_WGT); 
-		pRadarDataArray[0]->pPRI_WGT = NULL;
-	}
-	if (pRadarDataArray[0]->pWRI_WGT) { 
-		free(pRadarDataArray[0]->pWRI_WGT); 
-		pRadarDataArray[0]->pWRI_WGT = NULL;
-	}
+	// The windows (and the other buffers) go back with gArena
+	pRadarDataArray[0]->pPRI_WGT = NULL;
+	pRadarDataArray[0]->pWRI_WGT = NULL;
 
 	return;
 }
@@ -198,6 +184,7 @@ void RadarWorkerFunction(pRadar_Data_Flowing MyRadarData,
 	char msg[64];
 	
 	// Initialize this worker thread
+	setThreadRole(ThreadWorker, MyRadarData->MyID);
 	snprintf(msg, sizeof(msg), "Worker thread, %d starting.", MyRadarData->MyID);
 	log_message((const char *)msg);
 
@@ -222,8 +209,14 @@ void RadarWorkerFunction(pRadar_Data_Flowing MyRadarData,
 			break;
 		}
 
-		// Now have data, process it.
-		MyRadarData->calibrate();
+		// Now have data, process it.  Each CPI of the batch is calibrated, their FFTs are done together,
+		// then each is searched for targets.
+		const int NumSlots = MyRadarData->NumSlots;
+		for (int s = 0; s < NumSlots; s++) {
+			MyRadarData->useSlot(s);
+			MyRadarData->calibrate();
+			MyRadarData->Slots[s].CalVersion = MyRadarData->CalVersion;
+		}
 
 		// Data is now calibrated.  Continue processing, but check for stop first.
 		if (MyRadarData->StopRequested == TRUE)
@@ -231,63 +224,62 @@ void RadarWorkerFunction(pRadar_Data_Flowing MyRadarData,
 			bufferlock.unlock();
 			break;
 		}
-		fftwf_execute(MyRadarData->fftwfPlan);
-
-		// Copy frequency domain data into buffer  */
-		// The first for loop section grabs data for Range-Doppler Image(s) 
-		// Then converts it to dB
-		// It puts it into the range-Doppler image with a corner turn and an FFTshift
-		//float maxpval = -2000.0;
-		max_val = -2000.0;
-		unsigned int maxpIndx = 0;
-		for (unsigned int i = 0; i < MyRadarData->Params.Samp_Per_WRI*MyRadarData->Params.Num_WRI; i++) {
-			MyRadarData->pRDIPower[i] = 10.0f*(float)log10((MyRadarData->pData[i][0] * MyRadarData->pData[i][0] +
-				MyRadarData->pData[i][1] * MyRadarData->pData[i][1]) + 1e-15f);
-			if (MyRadarData->pRDIPower[i] > max_val) {
-				max_val = MyRadarData->pRDIPower[i];
-				maxpIndx = i;
+		MyRadarData->compressBatch(NumSlots);
+
+		for (int s = 0; s < NumSlots; s++) {
+			MyRadarData->useSlot(s);
+			// Copy frequency domain data into buffer  */
+			// The first for loop section grabs data for Range-Doppler Image(s) 
+			// Then converts it to dB
+			// It puts it into the range-Doppler image with a corner turn and an FFTshift
+			//float maxpval = -2000.0;
+			max_val = -2000.0;
+			unsigned int maxpIndx = 0;
+			for (unsigned int i = 0; i < MyRadarData->Params.Samp_Per_WRI*MyRadarData->Params.Num_WRI; i++) {
+				MyRadarData->pRDIPower[i] = 10.0f*(float)log10((MyRadarData->pData[i][0] * MyRadarData->pData[i][0] +
+					MyRadarData->pData[i][1] * MyRadarData->pData[i][1]) + 1e-15f);
+				if (MyRadarData->pRDIPower[i] > max_val) {
+					max_val = MyRadarData->pRDIPower[i];
+					maxpIndx = i;
+				}
 			}
-		}
 
-		//fftshift(MyRadarData->pRDIPower, MyRadarData->Params.Samp_Per_WRI, MyRadarData->Params.Num_WRI);
-		// The following is the range index with no corner turn
-		int index_max_r = maxpIndx% MyRadarData->Params.Samp_Per_WRI;
-		// The folliwing is the Doppler index with no corner turn
-		index_max_d = maxpIndx / MyRadarData->Params.Samp_Per_WRI;
-		if (index_max_d >= MyRadarData->Params.Num_WRI) {
-			log_message("Index error");
-			index_max_d = MyRadarData->Params.Num_WRI - 1;
-		}
-		// After corner turn
-		//index_max_d = (index_max_d + MyRadarData->Params.Num_WRI /2 ) % MyRadarData->Params.Num_WRI;
-		//int tmp = ((MyRadarData->Params.Num_WRI / 2) % MyRadarData->Params.Num_WRI)
-		//	* MyRadarData->Params.Samp_Per_WRI
-		//	+ index_max_r;
-	//	log_message("Index %d, range %d, Dopp %d, idxd %d", maxpIndx, index_max_r, index_max_d, tmp);
+			//fftshift(MyRadarData->pRDIPower, MyRadarData->Params.Samp_Per_WRI, MyRadarData->Params.Num_WRI);
+			// The following is the range index with no corner turn
+			int index_max_r = maxpIndx% MyRadarData->Params.Samp_Per_WRI;
+			// The folliwing is the Doppler index with no corner turn
+			index_max_d = maxpIndx / MyRadarData->Params.Samp_Per_WRI;
+			if (index_max_d >= MyRadarData->Params.Num_WRI) {
+				log_message("Index error");
+				index_max_d = MyRadarData->Params.Num_WRI - 1;
+			}
+			// After corner turn
+			//index_max_d = (index_max_d + MyRadarData->Params.Num_WRI /2 ) % MyRadarData->Params.Num_WRI;
+			//int tmp = ((MyRadarData->Params.Num_WRI / 2) % MyRadarData->Params.Num_WRI)
+			//	* MyRadarData->Params.Samp_Per_WRI
+			//	+ index_max_r;
+		//	log_message("Index %d, range %d, Dopp %d, idxd %d", maxpIndx, index_max_r, index_max_d, tmp);
 		
-		//std::cout << index_max_d1 << "\n";
+			//std::cout << index_max_d1 << "\n";
 		
-		MyRadarData->index_max_d = index_max_d;
-		MyRadarData->index_max_r = index_max_r;
-		MyRadarData->peakAmplitude = max_val;
+			MyRadarData->index_max_d = index_max_d;
+			MyRadarData->index_max_r = index_max_r;
+			MyRadarData->peakAmplitude = max_val;
 		
-		// Find the centroid of the peak (in 1-D)
-		float cal_val = 0.60f; // Cal value for the particular window used.  
-
-		// TODO: fix this so it wraps around the edges rather than truncating
-		if ((index_max_d > 0) && (index_max_d < (MyRadarData->Params.Num_WRI - 1))) { // from 1 to NumWRI-2 for this calculation
-			int itmp = index_max_d * MyRadarData->Params.Samp_Per_WRI + index_max_r;
-			MyRadarData->index_frac_d =
-				PeakEstimate((RTPComplex *) &MyRadarData->pData[itmp- MyRadarData->Params.Samp_Per_WRI][0],
-				(RTPComplex *)& MyRadarData->pData[itmp ][0],
-				(RTPComplex *)& MyRadarData->pData[itmp+ MyRadarData->Params.Samp_Per_WRI][0], cal_val);
-		}
-		else {
-			MyRadarData->index_frac_d = 0.0;  // We can't do curve fitting at the edges (but we actually could wrap around with more work)
+			// Look for all of the targets, not just the strongest
+			MyRadarData->Cfar.detect(MyRadarData->pData, MyRadarData->pRDIPower, MyRadarData->Detections);
+
+			// Sub-bin location of the strongest peak and of every detection, in both range and Doppler
+			RadarDetection Peak;
+			Peak.RangeIndex = index_max_r;
+			Peak.DopplerIndex = index_max_d;
+			MyRadarData->PeakInterp.refine(MyRadarData->pData, &Peak, 1);
+			MyRadarData->index_frac_r = Peak.RangeFrac;
+			MyRadarData->index_frac_d = Peak.DopplerFrac;
+			MyRadarData->PeakInterp.refine(MyRadarData->pData, MyRadarData->Detections.Det, MyRadarData->Detections.NumDetections);
+			MyRadarData->saveSlot(s);
 		}
 
-		// Todo: calculate fractional portion of range bin
-		
 		// Results are available.  If a consumer is waiting, wake it.
 		MyRadarData->OutBufferFull = TRUE;
 		bufferlock.unlock();  // Finished with the buffer
@@ -305,17 +297,23 @@ void RadarWorkerFunction(pRadar_Data_Flowing MyRadarData,
 	else {
 		log_message("Warning: fftwfPlan already deleted in thread: %d ", MyRadarData->MyID);
 	}
+	{
+		std::unique_lock<std::mutex> fftwPlanLockU(fftwPlanLock);
+		fftwf_plan *Plans[] = { &MyRadarData->RangePlan, &MyRadarData->RangeInvPlan, &MyRadarData->DopplerPlan,
+			&MyRadarData->DopplerUpPlan, &MyRadarData->DopplerDownPlan };
+		for (fftwf_plan *pPlan : Plans) {
+			if (*pPlan != NULL) fftwf_destroy_plan(*pPlan);
+			*pPlan = NULL;
+		}
+		for (fftwf_plan Plan : MyRadarData->BatchPlans) fftwf_destroy_plan(Plan);
+		MyRadarData->BatchPlans.clear();
+	}
 	log_message("Worker thread %d exiting.", MyRadarData->MyID);
 
-	// The following should be moved into the destructor for the radar data
-	if (!(MyRadarData->pData == NULL)) {
-		fftwf_free(MyRadarData->pData);
-		MyRadarData->pData = NULL;
-	}
-	else {
-		snprintf(msg, sizeof(msg), "pData already deleted in thread %d.", MyRadarData->MyID);
-		log_message((const char *)msg);
-	}
+	// The buffers are in gArena, which is released when the program exits
+	MyRadarData->pData = NULL;
+	MyRadarData->pRDIPower = NULL;
+	MyRadarData->Slots.clear();
 
 	/*
 	if (!(MyRadarData->pTargetLine == NULL)) {
@@ -327,7 +325,7 @@ void RadarWorkerFunction(pRadar_Data_Flowing MyRadarData,
 		log_message((const char *)msg);
 	}
 	*/
-	free(MyRadarData->DCOffsetArr);
+	MyRadarData->Cfar.cleanup();
 
 	return;
 }
@@ -342,42 +340,233 @@ Radar_Data_Flowing::~Radar_Data_Flowing()
 
 int Radar_Data_Flowing::calibrate()
 {
-	float rsamp, isamp, tmpr, tmpi, ar, ai;
-	float window_pt;
-
-	for (unsigned int i = 0; i < Params.Samp_Per_WRI* Params.Num_WRI; i++) {
-		rsamp = pData[i][0];
-		isamp = pData[i][1];
-	
-		// correct the data for IQ mismatch and DC offset */						
-		if (gRadarConfig.DC_CalOnly) {  // Subtract constant DC offset 
-			tmpr = rsamp - DCOffset.real();
-			tmpi = isamp - DCOffset.imag();
-		}
-		else {  				// Subtract time-dependent DC offset 
-			tmpr = rsamp - DCOffsetArr[i % Params.Samp_Per_WRI].real();
-			tmpi = isamp - DCOffsetArr[i % Params.Samp_Per_WRI].imag();
-			//tmpr = rsamp - DCOffset.real();
-			//tmpi = isamp - DCOffset.imag();
-		}
-		
-		ar = CalTransform.value[0] * tmpr + CalTransform.value[1] * tmpi;    // apply calibration coefficients 
-		ai = CalTransform.value[3] * tmpi + CalTransform.value[2] * tmpr;
-
-		// Now prepare for a 2-D FFT like what would be done for stretch range-Doppler processing 
-		window_pt = pPRI_WGT[i % Params.Samp_Per_WRI] * pWRI_WGT[i / Params.Samp_Per_WRI];
-
-		pData[i][0] = (float)window_pt*ar;
-		pData[i][1] = (float)window_pt*ai;
+	// Latest calibration, or the one the dispatcher picked for this CPI. It can't change while this CPI is using it.
+	const CalSnapshot *Cal = (PinnedCal != NULL) ? PinnedCal : gCalPublished.acquire();
+	PinnedCal = NULL;
+	CalVersion = Cal->Version;
+
+	switch (Mode) {
+	case CW: calibrateRows<CW>(Cal); break;
+	case UpDownLFM: calibrateRows<UpDownLFM>(Cal); break;
+	case SonarRangeDoppler: calibrateRows<SonarRangeDoppler>(Cal); break;
+	default: calibrateRows<LFMRangeDoppler>(Cal); break;
 	}
 	if (FALSE && !gRadarConfig.DC_CalOnly)
 		if ((Params.block_id > 0) && (Params.block_id % 50 == 0)) {
 			log_message("Using per sample DC offset");
 			std::cout << "Block ID: " << Params.block_id << " DC_OffsetArr = ";
 			for (unsigned int nnn = 0; nnn < Params.Samp_Per_WRI; nnn++)
-				std::cout << DCOffsetArr[nnn];
+				std::cout << Cal->DCOffsetArr[RadarChan * Params.Samp_Per_WRI + nnn];
 			std::cout << std::endl;
 		}
+	gCalPublished.release(Cal);
+	return 0;
+}
+
+// DC and IQ correction, then the windows, one WRI at a time.  There is a copy of this for each mode, so
+// the tests on M are made by the compiler and the inner loops have no branches:
+//	CW					slow time window only, there is no range FFT
+//	LFMRangeDoppler		both windows, for the 2-D FFT
+//	UpDownLFM			as LFMRangeDoppler.  The slow time window at the even (odd) WRIs tapers the up (down) sweeps.
+//	SonarRangeDoppler	mixed down to baseband, no window, the slow time window goes with the matched filter
+template <DataType M>
+void Radar_Data_Flowing::calibrateRows(const CalSnapshot *Cal)
+{
+	float tmpr, tmpi, ar, ai;
+	const unsigned int ns = Params.Samp_Per_WRI;
+
+	const RTPComplex DCOffset = Cal->DCOffset[RadarChan];
+	const floatdim4 CalTransform = Cal->CalXform[RadarChan];
+	// One DC offset for every sample (stride 0) or one per sample
+	const float dc1[2] = { DCOffset.real(), DCOffset.imag() };
+	const float *dc = DCOnly ? dc1 : reinterpret_cast<const float *>(&Cal->DCOffsetArr[RadarChan * ns]);
+	const unsigned int dcs = DCOnly ? 0 : 2;
+	const float *lo = reinterpret_cast<const float *>(DownConvertWF);
+
+	for (unsigned int w = 0; w < Params.Num_WRI; w++) {
+		float *row = &pData[w * ns][0];
+		const float wri_wgt = pWRI_WGT[w];
+
+		if ((M == SonarRangeDoppler) && LongSweep) {	// Already range compressed and calibrated, just the slow time window
+			for (unsigned int j = 0; j < 2 * ns; j++) row[j] *= wri_wgt;
+			continue;
+		}
+		if ((M != SonarRangeDoppler) && (Cal->XformBins != NULL)) {	// Transform per range sub-band
+			const float *x0 = &Cal->XformBins[(RadarChan * 4) * ns], *x1 = x0 + ns, *x2 = x1 + ns, *x3 = x2 + ns;
+			for (unsigned int k = 0; k < ns; k++) {
+				tmpr = row[2 * k] - dc[dcs * k];
+				tmpi = row[2 * k + 1] - dc[dcs * k + 1];
+				ar = x0[k] * tmpr + x1[k] * tmpi;
+				ai = x3[k] * tmpi + x2[k] * tmpr;
+				const float window_pt = (M == CW) ? wri_wgt : pPRI_WGT[k] * wri_wgt;
+				row[2 * k] = window_pt * ar;
+				row[2 * k + 1] = window_pt * ai;
+			}
+			continue;
+		}
+		for (unsigned int k = 0; k < ns; k++) {
+			// correct the data for IQ mismatch and DC offset */
+			tmpr = row[2 * k] - dc[dcs * k];
+			tmpi = row[2 * k + 1] - dc[dcs * k + 1];
+			ar = CalTransform.value[0] * tmpr + CalTransform.value[1] * tmpi;    // apply calibration coefficients 
+			ai = CalTransform.value[3] * tmpi + CalTransform.value[2] * tmpr;
+
+			if (M == SonarRangeDoppler) {	// Mix down to baseband
+				row[2 * k] = ar * lo[2 * k] - ai * lo[2 * k + 1];
+				row[2 * k + 1] = ar * lo[2 * k + 1] + ai * lo[2 * k];
+			}
+			else {	// Now prepare for a 2-D FFT like what would be done for stretch range-Doppler processing 
+				const float window_pt = (M == CW) ? wri_wgt : pPRI_WGT[k] * wri_wgt;
+				row[2 * k] = window_pt * ar;
+				row[2 * k + 1] = window_pt * ai;
+			}
+		}
+	}
+}
+
+// Range and Doppler processing of the calibrated CPI.  Each mode leaves the data in the layout of the
+// 2-D FFT: Num_WRI rows of Doppler bins, each Samp_Per_WRI range bins.
+int Radar_Data_Flowing::compress()
+{
+	switch (Mode) {
+	case CW: fftwf_execute_dft(DopplerPlan, pData, pData); break;
+	case UpDownLFM: upDownCompress(); break;
+	case SonarRangeDoppler:
+		if (LongSweep) fftwf_execute_dft(DopplerPlan, pData, pData);
+		else pulseCompress();
+		break;
+	default: fftwf_execute_dft(fftwfPlan, pData, pData); break;
+	}
+	return 0;
+}
+
+// The plans are made on slot 0 and run on whichever slot is in pData.  The 2-D FFTs of a batch of
+// LFMRangeDoppler CPIs are done with as few calls as it takes: the biggest batch plan that fits, then the
+// next smaller, so seven CPIs are 4 + 2 + 1.  The other modes have work between their FFTs, so they go
+// one CPI at a time.
+void Radar_Data_Flowing::compressBatch(int n)
+{
+	if ((Mode != LFMRangeDoppler) || BatchPlans.empty()) {
+		for (int s = 0; s < n; s++) {
+			useSlot(s);
+			compress();
+		}
+		return;
+	}
+	int s = 0;
+	for (int p = (int)BatchPlans.size(); p >= 0; p--) {
+		fftwf_plan Plan = (p > 0) ? BatchPlans[p - 1] : fftwfPlan;
+		for (; (n - s) >= (1 << p); s += (1 << p))
+			fftwf_execute_dft(Plan, Slots[s].pData, Slots[s].pData);
+	}
+}
+
+void Radar_Data_Flowing::useSlot(int s)
+{
+	CPISlot &Slot = Slots[s];
+	pData = Slot.pData;
+	pRDIPower = Slot.pRDIPower;
+	RadarChan = Slot.RadarChan;
+	Params = Slot.Params;
+	PinnedCal = Slot.PinnedCal;
+	Slot.PinnedCal = NULL;
+}
+
+void Radar_Data_Flowing::saveSlot(int s)
+{
+	CPISlot &Slot = Slots[s];
+	Slot.index_max_d = index_max_d;
+	Slot.index_frac_d = index_frac_d;
+	Slot.index_max_r = index_max_r;
+	Slot.index_frac_r = index_frac_r;
+	Slot.peakAmplitude = peakAmplitude;
+	Slot.Detections = Detections;
+}
+
+// Sonar processing after calibrate() has the data at baseband.  Each WRI is one
+// period of the transmitted waveform, so the matched filter is a circular correlation with the replica: a batched FFT of
+// every WRI, a multiply by the conjugate of the replica spectrum (with the slow time window and the
+// inverse FFT scaling folded in) and a batched inverse FFT.  The Doppler FFT across the WRIs then
+// leaves the data in the same layout as the radar 2-D FFT, with range in delay samples.
+int Radar_Data_Flowing::pulseCompress()
+{
+	const unsigned int ns = Params.Samp_Per_WRI;
+	const float *rep = reinterpret_cast<const float *>(WaveformReplica);
+	const float scale = 1.0f / (float)ns;
+
+	fftwf_execute_dft(RangePlan, pData, pData);
+	for (unsigned int w = 0; w < Params.Num_WRI; w++) {
+		float *row = &pData[w * ns][0];
+		const float g = pWRI_WGT[w] * scale;
+		for (unsigned int k = 0; k < ns; k++) {
+			float xr = row[2 * k], xi = row[2 * k + 1];
+			float hr = g * rep[2 * k], hi = -g * rep[2 * k + 1];
+			row[2 * k] = xr * hr - xi * hi;
+			row[2 * k + 1] = xr * hi + xi * hr;
+		}
+	}
+	fftwf_execute_dft(RangeInvPlan, pData, pData);
+	fftwf_execute_dft(DopplerPlan, pData, pData);
+	return 0;
+}
+
+// Up/down LFM.  With a stretch LFM the beat frequency of a target is its range plus its Doppler shift, so
+// the range of a moving target is off by its Doppler (by whole bins when the Doppler is aliased).  On the
+// down sweep the range term changes sign and the Doppler doesn't, so after flipping the range axis of the
+// down sweeps the target is at range - Doppler instead of range + Doppler.
+// The up (even) and down (odd) WRIs are each Doppler FFT'd first.  A Doppler of d bins (of Num_WRI/2, over
+// two WRIs) moves the beat by d/Num_WRI range bins, so each Doppler row is shifted back by that before its
+// range FFT, with a phase ramp over the WRI.  The same ramp before the flip moves the up map down in range
+// and the down map up, and both then have the target at the true range.  The two maps are summed in power
+// and the phase is kept from the up sweep map.  A Doppler aliased past Num_WRI/2 bins still leaves the maps
+// apart by the whole bins of the alias.
+// Each sweep direction is sampled every other WRI, so the Doppler map repeats after Num_WRI/2 bins.  It is
+// copied into both halves so the Doppler bins keep the spacing of the other modes.
+int Radar_Data_Flowing::upDownCompress()
+{
+	const unsigned int ns = Params.Samp_Per_WRI, nh = Params.Num_WRI / 2;
+
+	fftwf_execute_dft(DopplerUpPlan, pData, pData);
+	fftwf_execute_dft(DopplerDownPlan, pData + ns, pData + ns);
+	// Doppler bin d of the up (down) map is now in row 2d (2d+1)
+	for (unsigned int d = 1; d < nh; d++) {
+		const int Bin = (2 * d < nh) ? (int)d : (int)d - (int)nh;	// Signed Doppler bin
+		const std::complex<double> Step = std::polar(1.0, -TWOPI * Bin / (2.0 * nh * ns));
+		std::complex<double> Ramp = 1.0;
+		float *up = &pData[2 * d * ns][0], *dn = &pData[(2 * d + 1) * ns][0];
+		for (unsigned int k = 0; k < ns; k++) {
+			const float rr = (float)Ramp.real(), ri = (float)Ramp.imag();
+			float xr = up[2 * k], xi = up[2 * k + 1];
+			up[2 * k] = xr * rr - xi * ri;
+			up[2 * k + 1] = xr * ri + xi * rr;
+			xr = dn[2 * k]; xi = dn[2 * k + 1];
+			dn[2 * k] = xr * rr - xi * ri;
+			dn[2 * k + 1] = xr * ri + xi * rr;
+			Ramp *= Step;
+		}
+	}
+	fftwf_execute_dft(RangePlan, pData, pData);
+	for (unsigned int w = 1; w < Params.Num_WRI; w += 2) {
+		fftwf_complex *row = &pData[w * ns];
+		for (unsigned int k = 1; k < ns - k; k++) {
+			std::swap(row[k][0], row[ns - k][0]);
+			std::swap(row[k][1], row[ns - k][1]);
+		}
+	}
+
+	for (unsigned int d = 0; d < nh; d++) {
+		const float *up = &pData[2 * d * ns][0], *dn = &pData[(2 * d + 1) * ns][0];
+		float *out = reinterpret_cast<float *>(&UpDownMap[d * ns]);
+		for (unsigned int k = 0; k < ns; k++) {
+			float pu = up[2 * k] * up[2 * k] + up[2 * k + 1] * up[2 * k + 1];
+			float pd = dn[2 * k] * dn[2 * k] + dn[2 * k + 1] * dn[2 * k + 1];
+			float g = (pu > 0.0f) ? sqrtf(0.5f * (pu + pd) / pu) : 0.0f;
+			out[2 * k] = g * up[2 * k];
+			out[2 * k + 1] = (pu > 0.0f) ? g * up[2 * k + 1] : sqrtf(0.5f * pd);
+		}
+	}
+	for (unsigned int w = 0; w < Params.Num_WRI; w++)
+		memcpy(&pData[w * ns][0], &UpDownMap[(w % nh) * ns], ns * sizeof(fftwf_complex));
 	return 0;
 }
 
@@ -389,38 +578,87 @@ int Radar_Data_Flowing::initialize(CPI_Params InitParams, float* win_cpi, float*
 	Params = InitParams;
 	pPRI_WGT = win_wri;	// Pointers to window used to control sidelobes
 	pWRI_WGT = win_cpi; // Need to be careful this is not freed while threads are running
-	DCOffset = RTPComplex((float)gRadarConfig.CalDCVal[0], (float)gRadarConfig.CalDCVal[0]);  // Default DC offset cal constants 
-	CalTransform = gRadarConfig.CalTransForm[0];
 	DCOnly = gRadarConfig.DC_CalOnly;
 	RadarChan = 0;
 	InBufferFull = false;		// Tell thread that input data is in buffer
 	OutBufferFull = false;		// Tell following thread that output data is in output buffers
 	StopRequested = false;
 
-	/* allocate memory for buffers.  Using the fftw library function forces block alignment as needed for SIMD instructions*/
-	pData = (fftwf_complex*)
-		fftwf_malloc(sizeof(fftwf_complex) * Params.Samp_Per_WRI*Params.Num_WRI); /* single radar 2-D */
+	/* Buffers come from gArena, which aligns them for SIMD instructions as fftwf_malloc does */
+	/* The CPIs of a batch are one after the other, each single radar 2-D */
+	const int Batch = gRadarConfig.BatchCPIs;
+	const size_t CPISize = Params.Samp_Per_WRI*Params.Num_WRI;
+	fftwf_complex *pBatch = (fftwf_complex*)gArena.take(sizeof(fftwf_complex) * CPISize * Batch, "worker data");
 //	pTargetLine = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * Params.Num_WRI);
 
-	pRDIPower = (float*)malloc(Params.Samp_Per_WRI*Params.Num_WRI * sizeof(pRDIPower[0]));
-	DCOffsetArr=(RTPComplex*)malloc(Params.Samp_Per_WRI * sizeof( DCOffsetArr[0] ));
-
-	if ((pData == NULL)
-		|| (pRDIPower == NULL)
-		|| (DCOffsetArr==NULL) )
-	{
-		log_message("Error %d: Allocation of radar data memory blocks failed.  Exiting", GetLastError());
-		// If the array allocation fails, the system is out of memory so exit
-		exit(6);
+	float *pBatchPower = (float*)gArena.take(CPISize * Batch * sizeof(pRDIPower[0]), "worker power");
+	Slots.assign(Batch, CPISlot());
+	for (int s = 0; s < Batch; s++) {
+		Slots[s].Params = Params;
+		Slots[s].pData = pBatch + s * CPISize;
+		Slots[s].pRDIPower = pBatchPower + s * CPISize;
 	}
-
+	NumSlots = SlotsRead = 0;
+	pData = pBatch;
+	pRDIPower = pBatchPower;
+	CFARConfigure(Cfar);
+	Cfar.initialize(Params);
+	PeakInterp.initialize(Params, win_wri, win_cpi);
+
+	// This runs on the worker, already on its node's CPUs, so its buffers go on its node
+	gNuma.place(pBatch, sizeof(fftwf_complex) * CPISize * Batch, gNuma.WorkerNode[MyID]);
+	gNuma.place(pBatchPower, CPISize * Batch * sizeof(pRDIPower[0]), gNuma.WorkerNode[MyID]);
+
+	// The plans are run on every slot, so they can't count on more alignment than the slots have
+	unsigned int PlanFlags = fftwPlanFlags();
+	if ((Batch > 1) && ((sizeof(fftwf_complex) * CPISize) % BufferArena::AlignBytes)) PlanFlags |= FFTW_UNALIGNED;
 	std::unique_lock<std::mutex> fftwPlanLockU(fftwPlanLock);
 	fftwfPlan =
-		fftwf_plan_dft_2d(Params.Num_WRI, Params.Samp_Per_WRI, pData, pData, FFTW_FORWARD, FFTW_MEASURE);
+		fftwf_plan_dft_2d(Params.Num_WRI, Params.Samp_Per_WRI, pData, pData, FFTW_FORWARD, PlanFlags);
 	if ((fftwfPlan == NULL)) {
 		log_message("Error %d: Creating fftw plan failed in %s : line %d . exiting...", GetLastError(), __FILE__, __LINE__);
 		exit(4);
 	}
+	Mode = Params.myType;
+	if ((Mode == SonarRangeDoppler) && ((WaveformReplica == NULL) || (DownConvertWF == NULL))) {
+		log_message("Warning: Sonar is set but there is no sonar waveform (no output channel?). Using radar processing.");
+		Mode = LFMRangeDoppler;
+	}
+	if ((Mode == UpDownLFM) && (Params.Num_WRI % 2)) {
+		log_message("Warning: Up/down LFM processing needs an even number of WRI. Using LFM processing.");
+		Mode = LFMRangeDoppler;
+	}
+	LongSweep = (Mode == SonarRangeDoppler) && longSweepOn();
+	// Range FFTs of every WRI (rows) and Doppler FFTs of every range sample (columns), in place
+	int n = (int)Params.Samp_Per_WRI, m = (int)Params.Num_WRI, h = m / 2;
+	if ((Mode == SonarRangeDoppler) || (Mode == UpDownLFM))
+		RangePlan = fftwf_plan_many_dft(1, &n, m, pData, NULL, 1, n, pData, NULL, 1, n, FFTW_FORWARD, PlanFlags);
+	if (Mode == SonarRangeDoppler)
+		RangeInvPlan = fftwf_plan_many_dft(1, &n, m, pData, NULL, 1, n, pData, NULL, 1, n, FFTW_BACKWARD, PlanFlags);
+	if ((Mode == CW) || (Mode == SonarRangeDoppler))
+		DopplerPlan = fftwf_plan_many_dft(1, &m, n, pData, NULL, n, 1, pData, NULL, n, 1, FFTW_FORWARD, PlanFlags);
+	if (Mode == UpDownLFM) {	// Every other WRI
+		DopplerUpPlan = fftwf_plan_many_dft(1, &h, n, pData, NULL, 2 * n, 1, pData, NULL, 2 * n, 1, FFTW_FORWARD, PlanFlags);
+		DopplerDownPlan = fftwf_plan_many_dft(1, &h, n, pData + n, NULL, 2 * n, 1, pData + n, NULL, 2 * n, 1, FFTW_FORWARD, PlanFlags);
+		UpDownMap.resize(h * n);
+	}
+	if (Mode == LFMRangeDoppler) {	// 2-D FFTs of 2, 4, 8, ... CPIs, see compressBatch()
+		int dims[2] = { m, n };
+		for (int b = 2; b <= Batch; b *= 2) {
+			fftwf_plan Plan = fftwf_plan_many_dft(2, dims, b, pData, NULL, 1, m * n, pData, NULL, 1, m * n, FFTW_FORWARD, PlanFlags);
+			if (Plan == NULL) {
+				log_message("Error %d: Creating fftw plans failed in %s : line %d . exiting...", GetLastError(), __FILE__, __LINE__);
+				exit(4);
+			}
+			BatchPlans.push_back(Plan);
+		}
+	}
+	if (((Mode == SonarRangeDoppler) && ((RangePlan == NULL) || (RangeInvPlan == NULL) || (DopplerPlan == NULL)))
+		|| ((Mode == CW) && (DopplerPlan == NULL))
+		|| ((Mode == UpDownLFM) && ((RangePlan == NULL) || (DopplerUpPlan == NULL) || (DopplerDownPlan == NULL)))) {
+		log_message("Error %d: Creating fftw plans failed in %s : line %d . exiting...", GetLastError(), __FILE__, __LINE__);
+		exit(4);
+	}
 	fftwPlanLockU.unlock();
 	return(0);
 }
@@ -433,12 +671,8 @@ int StartWorkerThreads(pRadar_Data_Flowing * pRadarDataArray, std::thread hWorke
 
 	// load processing window for all threads
 	// First create storage for windows to weight the data prior to the FFT
-	win_cpi = (float*)malloc(InitParams.Num_WRI * sizeof(float));
-	win_wri = (float*)malloc(InitParams.Samp_Per_WRI * sizeof(float));
-	if ((win_cpi == NULL) || (win_wri == NULL)) {
-		log_message("Error %d: Can't allocate memory for window functions in processing thread. Exiting", GetLastError());
-		exit(1L);
-	}
+	win_cpi = (float*)gArena.take(InitParams.Num_WRI * sizeof(float), "window");
+	win_wri = (float*)gArena.take(InitParams.Samp_Per_WRI * sizeof(float), "window");
 
 	// Then load the windows.  This routine will default to a hamming window end emit warning if parameter file is not found 
 	load_window(win_cpi, InitParams.Num_WRI, 80);  // 60dB sidelobes still results in sidelobes raising the noise level.  So, use 80dB.
@@ -455,13 +689,35 @@ int StartWorkerThreads(pRadar_Data_Flowing * pRadarDataArray, std::thread hWorke
 }
 
 
-void OutputWorkerFunction(pRadar_Data_Flowing pRadarData[], CPI_Params InitParams)
+void CPIOrder::push(int Worker)
+{
+	std::unique_lock<std::mutex> lock(Lock);
+	Workers.push_back(Worker);
+	lock.unlock();
+	Added.notify_one();
+}
+
+int CPIOrder::pop(const bool &StopRequest)
 {
-	int nextThread = 0;
+	std::unique_lock<std::mutex> lock(Lock);
+	while (Workers.empty() && !StopRequest) {
+		std::cv_status cvstat = Added.wait_for(lock, std::chrono::milliseconds(1000));
+		if ((cvstat == std::cv_status::timeout) && !StopRequest) log_message("Processing thread accumulation loop waiting on data timeout");
+	}
+	if (StopRequest) return -1;
+	int Worker = Workers.front();
+	Workers.pop_front();
+	return Worker;
+}
+
+void OutputWorkerFunction(pRadar_Data_Flowing pRadarData[], CPI_Params InitParams, CPIOrder *Order)
+{
+	int nextThread;
 	int CurRadarChan;
 	// char msg[1024];
 
 
+	setThreadRole(ThreadGather);
 	log_message("Output gather thread has started.");
 
 	// Initialize output storage 
@@ -474,18 +730,18 @@ void OutputWorkerFunction(pRadar_Data_Flowing pRadarData[], CPI_Params InitParam
 	// Allocate memory for storing the output Range-Doppler Image (RDI)
 	for (int rindex = 0; rindex < gRadarState.NumSensorsSet; rindex++) {
 		gProcessedData.pRDIPower[rindex] = (float*)
-			malloc(gProcessedData.Params.Samp_Per_WRI*gProcessedData.Params.Num_WRI *
-				sizeof(gProcessedData.pRDIPower[0]));
-		if (gProcessedData.pRDIPower[rindex] == NULL) {
-			log_message("Error %d: Allocation of radar data memory blocks failed in output gather. Exiting", GetLastError());
-			exit(7);  // If the array allocation fails, no way to recover, so exit
-		}
+			gArena.take(gProcessedData.Params.Samp_Per_WRI*gProcessedData.Params.Num_WRI *
+				sizeof(gProcessedData.pRDIPower[0][0]), "gather power");
+		gNuma.place(gProcessedData.pRDIPower[rindex], gProcessedData.Params.Samp_Per_WRI*gProcessedData.Params.Num_WRI *
+			sizeof(gProcessedData.pRDIPower[0][0]), gNuma.currentNode());
 	}
 
 	log_message("Starting processing threads output accumulation loop");
 
 	while (!OThreadStopRequest)  // Loop until stop is requested
 	{
+		// The worker with the next CPI, in the order they were handed out
+		if ((nextThread = Order->pop(OThreadStopRequest)) < 0) break;
 		// Grab the processing worker thread's output buffer
 		std::unique_lock<std::mutex> bufferlock(pRadarData[nextThread]->OwnBuffers);
 		// Indefinite wait for results to be ready		
@@ -501,56 +757,82 @@ void OutputWorkerFunction(pRadar_Data_Flowing pRadarData[], CPI_Params InitParam
 			break;  // stop flag - don't pay attention to flag from individual worker threads
 		}
 
-		CurRadarChan = pRadarData[nextThread]->RadarChan;
+		// The worker's batch is taken in order, one CPI each time round
+		const CPISlot &Slot = pRadarData[nextThread]->Slots[pRadarData[nextThread]->SlotsRead];
+		CurRadarChan = Slot.RadarChan;
 		std::unique_lock<std::mutex> bufferlockOutput(gProcessedData.OwnBuffers);
 		
-		memcpy(gProcessedData.pRDIPower[CurRadarChan], pRadarData[nextThread]->pRDIPower, pRadarData[nextThread]->Params.Num_WRI*
-			pRadarData[nextThread]->Params.Samp_Per_WRI * sizeof(pRadarData[nextThread]->pRDIPower[0]));
+		memcpy(gProcessedData.pRDIPower[CurRadarChan], Slot.pRDIPower, Slot.Params.Num_WRI*
+			Slot.Params.Samp_Per_WRI * sizeof(Slot.pRDIPower[0]));
+		if (gNuma.NumNodes > 1)
+			gNuma.countCopy(gNuma.WorkerNode[nextThread], gNuma.currentNode(), Slot.Params.Num_WRI*
+				Slot.Params.Samp_Per_WRI * sizeof(Slot.pRDIPower[0]));
 
-		gProcessedData.peakDoppler[CurRadarChan] = ((float)gRadarConfig.UAmbDoppler)*((float)pRadarData[nextThread]->index_max_d +
-			pRadarData[nextThread]->index_frac_d - ((float)(pRadarData[nextThread]->Params.Num_WRI / 2)))* 2.0F /
-			(float)pRadarData[nextThread]->Params.Num_WRI;
-		gProcessedData.peakAmplitude[CurRadarChan] = (float) pRadarData[nextThread]->peakAmplitude;
+		gProcessedData.peakDoppler[CurRadarChan] = ((float)gRadarConfig.UAmbDoppler)*((float)Slot.index_max_d +
+			Slot.index_frac_d - ((float)(Slot.Params.Num_WRI / 2)))* 2.0F /
+			(float)Slot.Params.Num_WRI;
+		gProcessedData.peakAmplitude[CurRadarChan] = (float) Slot.peakAmplitude;
 
 		// Copy time of validity and block counter
 		// There should be a check to verify that Params are the same for each radar
-		gProcessedData.Params = pRadarData[nextThread]->Params;
+		gProcessedData.Params = Slot.Params;
 	
 		// Doppler peak
-		gProcessedData.index_max_d[CurRadarChan] = (int) pRadarData[nextThread]->index_max_d;
-		gProcessedData.index_frac_d[CurRadarChan] = (float) pRadarData[nextThread]->index_frac_d;
-		gProcessedData.index_max_r[CurRadarChan] = (int)pRadarData[nextThread]->index_max_r;
-		gProcessedData.index_frac_r[CurRadarChan] = (float)pRadarData[nextThread]->index_frac_r;
-
-		pRadarData[nextThread]->OutBufferFull = FALSE;
+		gProcessedData.index_max_d[CurRadarChan] = (int) Slot.index_max_d;
+		gProcessedData.index_frac_d[CurRadarChan] = (float) Slot.index_frac_d;
+		gProcessedData.index_max_r[CurRadarChan] = (int)Slot.index_max_r;
+		gProcessedData.index_frac_r[CurRadarChan] = (float)Slot.index_frac_r;
+		gProcessedData.Detections[CurRadarChan] = Slot.Detections;
+		gProcessedData.RadarTOVtt[CurRadarChan] = Slot.Params.Data_TOVtt;
+		gProcessedData.CalVersion[CurRadarChan] = Slot.CalVersion;
+
+		// Once the whole batch is taken the worker can have another
+		if (++pRadarData[nextThread]->SlotsRead >= pRadarData[nextThread]->NumSlots) {
+			pRadarData[nextThread]->SlotsRead = 0;
+			pRadarData[nextThread]->OutBufferFull = FALSE;
+		}
 
 		// At this point we have all of the data that is needed and can unlock access to my input buffer
 		// pRadarData[nextThread]->Buflock.unlock();
 		bufferlock.unlock();
 		bufferlockOutput.unlock(); // And output buffer lock can be removed
+		pRadarData[nextThread]->DataHere.notify_all();	// The dispatcher waits for this in virtual time
 
 		if (CurRadarChan == (gRadarState.NumSensorsSet - 1)) {  // Now have the complete, most recent set of processed data
 			//log_message( "Finished processing data. Thread %d.", nextThread);
 
 		   // The following tells the display formatter to prepare the RDI images for display
-			bufferlockOutput.lock();
-			gProcessedData.InBufferFull = TRUE;
-			bufferlockOutput.unlock(); // And output buffer lock can be removed
-			gProcessedData.DataHere.notify_all();
+		   // Under overload only some frames are, see overload.cpp
+			if (gOverload.showFrame()) {
+				bufferlockOutput.lock();
+				gProcessedData.InBufferFull = TRUE;
+				bufferlockOutput.unlock(); // And output buffer lock can be removed
+				gProcessedData.DataHere.notify_all();
+			}
 
 			// Processed data recording called here
 			if (gRadarState.DataRecording == TRUE)  save_processed_data();  // This needs to be more robust
+
+			// Hand a copy to the network publisher. Does not block.
+			NetPublishFrame();
+
+			// And the detections to the tracker thread
+			TrackerLoadFrame();
+
+			// And to the fusion thread
+			FusionLoadFrame();
+
+			// Precession estimate is quick, so it is done here
+			PrecessionLoadFrame();
+			gRadarState.Blocks_output++;
 		}
-		nextThread++;
-		if (nextThread >= gRadarConfig.NumThreads) nextThread = 0;
 
 	}
 	//OutputWorkerCleanup: Falls through to here when StopRequested
 	log_message("Display Interface cleanup started.");
 
-	// Delete memory allocated here
+	// The memory allocated here goes back with gArena
 	for (int rindex = 0; rindex < gRadarState.NumSensorsSet; rindex++) {
-		free(gProcessedData.pRDIPower[rindex]);
 		gProcessedData.pRDIPower[rindex] = NULL;
 	}
 
@@ -28,6 +28,7 @@ See the GNU General Public License for more details, supplied with this source a
 
 #include "stdafx.h"
 #include "INIReader.h"
+#include "tracker.h"
 #ifdef _WIN32
 #include <io.h>
 #define F_OK 04
@@ -81,6 +82,12 @@ int ReadConfiguration(void)
 		gRadarConfig.NumThreads = MaxThreads;
 		log_message("Warning: Number of Signal Processing worker threads in configuration file is greater than allowed maximum of %d", MaxThreads);
 	} 
+	gRadarConfig.BatchCPIs = (int)reader.GetInteger("system", "BatchCPIs", 1);
+	if ((gRadarConfig.BatchCPIs < 1) || (gRadarConfig.BatchCPIs > MaxBatchCPIs)) {
+		log_message("Warning: BatchCPIs %d is not 1 to %d. Using %d", gRadarConfig.BatchCPIs, MaxBatchCPIs,
+			MIN(MAX(gRadarConfig.BatchCPIs, 1), MaxBatchCPIs));
+		gRadarConfig.BatchCPIs = MIN(MAX(gRadarConfig.BatchCPIs, 1), MaxBatchCPIs);
+	}
 	if (gRadarConfig.NumThreads < 2* gRadarConfig.NumRadars) {
 		gRadarConfig.NumThreads = 2 * gRadarConfig.NumRadars;
 		log_message("Warning: Number of Signal Processing worker threads in configuration file is less than minimum of 2*NumRadars, (to allow ping-pong processing) %d. Recommend increasing thread count", 2 * gRadarConfig.NumRadars);
@@ -88,6 +95,37 @@ int ReadConfiguration(void)
 
 	// Interface setup
 	gRadarConfig.ASIOPriority = reader.GetBoolean("system", "ASIOPriority", false);
+	for (int role = 0; role < NumThreadRoles; role++) {
+		std::string key = threadRoleKey((ThreadRole)role);
+		if (parseCPUList(reader.Get("threads", "CPU" + key, ""), gRadarConfig.ThreadCPUs[role]) != 0) {
+			log_message("Warning: [threads] CPU%s should be a list of CPUs like 2,4-7. Ignored.", key.c_str());
+			gRadarConfig.ThreadCPUs[role].clear();
+		}
+		gRadarConfig.ThreadPriority[role] = (int)reader.GetInteger("threads", "Priority" + key, 0);
+	}
+	gRadarConfig.ReserveCPUs = reader.GetBoolean("threads", "ReserveCPUs", false);
+	gRadarConfig.NumaOn = reader.GetBoolean("threads", "NumaOn", false);
+	gRadarConfig.NumaCPUs.clear();
+	for (int node = 0; node < 64; node++) {
+		std::string key = "NumaCPUs" + std::to_string(node);
+		std::vector<int> CPUs;
+		if ((parseCPUList(reader.Get("threads", key, ""), CPUs) != 0) || CPUs.empty()) break;
+		gRadarConfig.NumaCPUs.push_back(CPUs);
+	}
+	gRadarConfig.HugePages = reader.GetBoolean("system", "HugePages", true);
+	// Overload control, see overload.cpp
+	gRadarConfig.OverloadOn = reader.GetBoolean("overload", "OverloadOn", false);
+	gRadarConfig.OverloadHigh = reader.GetReal("overload", "OverloadHigh", 0.5);
+	gRadarConfig.OverloadLow = reader.GetReal("overload", "OverloadLow", 0.125);
+	if ((gRadarConfig.OverloadLow < 0.0) || (gRadarConfig.OverloadLow >= gRadarConfig.OverloadHigh) || (gRadarConfig.OverloadHigh > 1.0)) {
+		log_message("Warning: OverloadLow %.3f and OverloadHigh %.3f must be 0 <= low < high <= 1. Using 0.125 and 0.5",
+			gRadarConfig.OverloadLow, gRadarConfig.OverloadHigh);
+		gRadarConfig.OverloadLow = 0.125;
+		gRadarConfig.OverloadHigh = 0.5;
+	}
+	gRadarConfig.OverloadStepBlocks = MAX((int)reader.GetInteger("overload", "OverloadStepBlocks", 4), 1);
+	gRadarConfig.OverloadRecoverBlocks = MAX((int)reader.GetInteger("overload", "OverloadRecoverBlocks", 64), 1);
+	gRadarConfig.OverloadDecimate = MAX((int)reader.GetInteger("overload", "OverloadDecimate", 4), 1);
 	gRadarConfig.SampleRate= reader.GetReal("system", "SampleRate", 44100.0);
 	gRadarConfig.RxADC_Chan = reader.GetInteger("system", "RxAdcChan", -1);
 	gRadarConfig.TxADC_Chan = reader.GetInteger("system", "TxAdcChan", -1);
@@ -121,6 +159,109 @@ int ReadConfiguration(void)
 	gRadarConfig.Sonar = reader.GetBoolean("system", "Sonar", false);
 	gRadarConfig.SonarFreq = reader.GetReal("system", "SonarFrequency", 12000.0); // Default is 12kHz
 	gRadarConfig.SonarBandwidth = reader.GetReal("system", "SonarBandwidth",5000.0); // Default bandwidth
+	// Processing mode: auto, cw, lfm, updown or sonar.  Auto is sonar for the sonar and lfm otherwise.
+	// There is no arbitrary waveform mode: the radar returns are dechirped by the mixer, so there is no
+	// replica to correlate them with, and the sonar is correlated with its own waveform.
+	std::string procmode = reader.Get("system", "ProcessingMode", "auto");
+	for (auto &c : procmode) c = (char)toupper(c);
+	if (procmode == "CW") gRadarConfig.ProcessingMode = CW;
+	else if (procmode == "LFM") gRadarConfig.ProcessingMode = LFMRangeDoppler;
+	else if (procmode == "UPDOWN") gRadarConfig.ProcessingMode = UpDownLFM;
+	else if (procmode == "SONAR") gRadarConfig.ProcessingMode = SonarRangeDoppler;
+	else {
+		if (procmode == "ARB") log_message("Warning: ProcessingMode arb is not supported. Using auto.");
+		else if (procmode != "AUTO") log_message("Warning: Unknown ProcessingMode %s in configuration file. Using auto.", procmode.c_str());
+		gRadarConfig.ProcessingMode = gRadarConfig.Sonar ? SonarRangeDoppler : LFMRangeDoppler;
+	}
+	if ((gRadarConfig.ProcessingMode == UpDownLFM) &&
+		(gRadarConfig.Sonar || (gRadarConfig.NWRIPerBlock % 2) || (gRadarConfig.NWRIPerCPI % 2))) {
+		log_message("Warning: ProcessingMode updown needs the radar and an even NWRIPerBlock and NWRIPerCPI. Using lfm.");
+		gRadarConfig.ProcessingMode = LFMRangeDoppler;
+	}
+
+	// Publishing processed results over the network
+	gRadarConfig.NetPublish = reader.GetBoolean("network", "NetPublish", false);
+	gRadarConfig.NetUseTCP = reader.GetBoolean("network", "NetUseTCP", false);
+	gRadarConfig.NetHost = reader.Get("network", "NetHost", "127.0.0.1");
+	gRadarConfig.NetPort = (int)reader.GetInteger("network", "NetPort", 5700);
+	gRadarConfig.NetSendRDI = reader.GetBoolean("network", "NetSendRDI", false);
+	gRadarConfig.NetQueueDepth = (int)reader.GetInteger("network", "NetQueueDepth", 8);
+	if (gRadarConfig.NetQueueDepth < 2) gRadarConfig.NetQueueDepth = 2;
+	gRadarConfig.NetKeyFrameInterval = (int)reader.GetInteger("network", "NetKeyFrameInterval", 50);
+	if (gRadarConfig.NetKeyFrameInterval < 0) gRadarConfig.NetKeyFrameInterval = 0;
+	if (!gRadarConfig.NetUseTCP && (gRadarConfig.NetKeyFrameInterval == 0)) {
+		log_message("Warning: NetKeyFrameInterval 0 can't recover a datagram lost on the way over UDP. Using 50.");
+		gRadarConfig.NetKeyFrameInterval = 50;
+	}
+	gRadarConfig.NetRDIQuantdB = reader.GetReal("network", "NetRDIQuantdB", 0.1);
+	if (gRadarConfig.NetRDIQuantdB <= 0.0) gRadarConfig.NetRDIQuantdB = 0.1;
+	gRadarConfig.NetSelfTest = reader.GetBoolean("network", "NetSelfTest", false);
+
+	// CFAR detection. Type is one of off, CA, OS or GO
+	std::string cfartype = reader.Get("cfar", "CFARType", "off");
+	for (auto &c : cfartype) c = (char)toupper(c);
+	if (cfartype == "CA") gRadarConfig.CFARType = CFARCellAverage;
+	else if (cfartype == "OS") gRadarConfig.CFARType = CFAROrderedStat;
+	else if (cfartype == "GO") gRadarConfig.CFARType = CFARGreatestOf;
+	else {
+		if (cfartype != "OFF") log_message("Warning: Unknown CFARType %s in configuration file. CFAR is off.", cfartype.c_str());
+		gRadarConfig.CFARType = CFAROff;
+	}
+	gRadarConfig.CFARGuardRange = (int)reader.GetInteger("cfar", "CFARGuardRange", 2);
+	gRadarConfig.CFARTrainRange = (int)reader.GetInteger("cfar", "CFARTrainRange", 8);
+	gRadarConfig.CFARGuardDoppler = (int)reader.GetInteger("cfar", "CFARGuardDoppler", 2);
+	gRadarConfig.CFARTrainDoppler = (int)reader.GetInteger("cfar", "CFARTrainDoppler", 4);
+	gRadarConfig.CFARThresholddB = reader.GetReal("cfar", "CFARThresholddB", 13.0);
+	gRadarConfig.CFAROSRank = reader.GetReal("cfar", "CFAROSRank", 0.75);
+	gRadarConfig.CFAROSRank = MIN(MAX(gRadarConfig.CFAROSRank, 0.0), 1.0);
+	gRadarConfig.CFARMaxDetections = (int)reader.GetInteger("cfar", "CFARMaxDetections", 16);
+	if ((gRadarConfig.CFARMaxDetections < 1) || (gRadarConfig.CFARMaxDetections > MaxDetections)) {
+		log_message("Warning: CFARMaxDetections must be from 1 to %d", MaxDetections);
+		gRadarConfig.CFARMaxDetections = MIN(MAX(gRadarConfig.CFARMaxDetections, 1), MaxDetections);
+	}
+
+	// MTI clutter cancellation. Type is one of off, 2pulse, 3pulse or recursive
+	std::string mtitype = reader.Get("mti", "MTIType", "off");
+	for (auto &c : mtitype) c = (char)toupper(c);
+	if (mtitype == "2PULSE") gRadarConfig.MTIType = MTITwoPulse;
+	else if (mtitype == "3PULSE") gRadarConfig.MTIType = MTIThreePulse;
+	else if (mtitype == "RECURSIVE") gRadarConfig.MTIType = MTIRecursive;
+	else {
+		if (mtitype != "OFF") log_message("Warning: Unknown MTIType %s in configuration file. MTI is off.", mtitype.c_str());
+		gRadarConfig.MTIType = MTIOff;
+	}
+	gRadarConfig.MTITimeConstant = reader.GetReal("mti", "MTITimeConstant", 10.0);
+
+	// Tracker
+	gRadarConfig.TrackerOn = reader.GetBoolean("tracker", "TrackerOn", false);
+	gRadarConfig.TrackMaxTracks = (int)reader.GetInteger("tracker", "TrackMaxTracks", 256);
+	if ((gRadarConfig.TrackMaxTracks < 1) || (gRadarConfig.TrackMaxTracks > MaxTracks)) {
+		log_message("Warning: TrackMaxTracks must be from 1 to %d", MaxTracks);
+		gRadarConfig.TrackMaxTracks = MIN(MAX(gRadarConfig.TrackMaxTracks, 1), MaxTracks);
+	}
+	gRadarConfig.TrackGate = reader.GetReal("tracker", "TrackGate", 9.21);
+	gRadarConfig.TrackRangeNoise = reader.GetReal("tracker", "TrackRangeNoise", 0.5);
+	gRadarConfig.TrackDopplerNoise = reader.GetReal("tracker", "TrackDopplerNoise", 0.5);
+	gRadarConfig.TrackRangeAccel = reader.GetReal("tracker", "TrackRangeAccel", 5.0);
+	gRadarConfig.TrackDopplerAccel = reader.GetReal("tracker", "TrackDopplerAccel", 5.0);
+	gRadarConfig.TrackConfirmHits = (int)reader.GetInteger("tracker", "TrackConfirmHits", 3);
+	gRadarConfig.TrackMaxMisses = (int)reader.GetInteger("tracker", "TrackMaxMisses", 5);
+	gRadarConfig.TrackRecordTentative = reader.GetBoolean("tracker", "TrackRecordTentative", false);
+
+	// Fusion
+	gRadarConfig.FusionOn = reader.GetBoolean("fusion", "FusionOn", false);
+	gRadarConfig.FusionDopplerNoise = reader.GetReal("fusion", "FusionDopplerNoise", 0.02);
+	gRadarConfig.FusionRangeNoise = reader.GetReal("fusion", "FusionRangeNoise", 0.3);
+	gRadarConfig.FusionAccelNoise = reader.GetReal("fusion", "FusionAccelNoise", 0.05);
+	gRadarConfig.FusionGate = reader.GetReal("fusion", "FusionGate", 9.0);
+	gRadarConfig.FusionUseRange = reader.GetBoolean("fusion", "FusionUseRange", true);
+	gRadarConfig.FusionPrecessionMemory = reader.GetReal("fusion", "FusionPrecessionMemory", 1800.0);
+
+	// Precession
+	gRadarConfig.PrecessionOn = reader.GetBoolean("precession", "PrecessionOn", false);
+	gRadarConfig.PrecessionMinAmplitude = reader.GetReal("precession", "PrecessionMinAmplitude", -200.0);
+	gRadarConfig.PrecessionMemory = reader.GetReal("precession", "PrecessionMemory", 0.0);
+	gRadarConfig.PrecessionReportInterval = reader.GetReal("precession", "PrecessionReportInterval", 600.0);
 
 	// Display control
 	gRadarConfig.DTI_Height= (int) reader.GetInteger("Display", "DTI_Height", 300);
@@ -139,11 +280,41 @@ int ReadConfiguration(void)
 	gRadarConfig.PendMinorAxis = reader.GetReal("target", "PendMinorAxis", 0.0);
 	gRadarConfig.RadarDistance = reader.GetReal("target", "RadarDistance", 1.8);
 	gRadarConfig.PendLatitude = reader.GetReal("target", "RadarLatitude", 35.2);
+	gRadarConfig.SimNumTargets = (int)reader.GetInteger("target", "SimNumTargets", 1);
+	if (gRadarConfig.SimNumTargets < 1) {
+		log_message("Warning: SimNumTargets must be at least 1");
+		gRadarConfig.SimNumTargets = 1;
+	}
+	std::stringstream ssrcs(reader.Get("target", "SimTargetRCS", "0.0"));
+	double rcsval;
+	gRadarConfig.SimTargetRCS.clear();
+	while (ssrcs >> rcsval) gRadarConfig.SimTargetRCS.push_back(rcsval);
+	gRadarConfig.SimThreads = (int)reader.GetInteger("target", "SimThreads", 2);
+	gRadarConfig.SimSeed = reader.GetInteger("target", "SimSeed", 0);
+	gRadarConfig.SimScenario = reader.Get("target", "SimScenario", "");
+	gScenario = SimScenario();
+	if (!gRadarConfig.SimScenario.empty() && (gScenario.load(gRadarConfig.SimScenario) != 0)) {
+		log_message("Warning: Simulating the pendulums in place of scenario %s", gRadarConfig.SimScenario.c_str());
+		gScenario = SimScenario();
+	}
+	gRadarConfig.VirtualTime = reader.GetBoolean("target", "VirtualTime", false);
+	gRadarConfig.SimFrames = (int)reader.GetInteger("target", "SimFrames", 0);
+	gRadarConfig.VirtualEpoch = reader.GetReal("target", "VirtualEpoch", 1577836800.0);
+	gRadarConfig.GoldenFile = reader.Get("target", "GoldenFile", "");
+	if (gRadarConfig.VirtualTime && !gRadarConfig.SimADC) {
+		log_message("Warning: VirtualTime needs SimADC, running in real time");
+		gRadarConfig.VirtualTime = false;
+	}
 	gRadarState.SimOn=reader.GetBoolean("target", "SimOn", false);
 	gRadarState.SimAmp=reader.GetReal("target", "SimAmp", -20.0);
 	//if (gRadarState.SimAmp > 0.0) gRadarState.SimAmp = 0.0; // 0 is the max value for data
 	// Calibration
 	gRadarConfig.DC_CalOnly=reader.GetBoolean("system", "DC_CalOnly", true);
+	gRadarConfig.CalBenchmark = reader.GetBoolean("system", "CalBenchmark", false);
+	gRadarConfig.CalStreaming = reader.GetBoolean("system", "CalStreaming", true);
+	gRadarConfig.CalStateFile = reader.Get("system", "CalStateFile", "calstate.bin");
+	gRadarConfig.CalSaveInterval = reader.GetReal("system", "CalSaveInterval", 60.0);
+	gRadarConfig.CalSubBands = (int)reader.GetInteger("system", "CalSubBands", 0);
 	gRadarState.AutoCalOn = reader.GetBoolean("system", "AutoCalOn", true);
 	std::string CalDCTemp = reader.Get("system", "Cal_DC_Offset", "0.0 0.0 0.0 0.0");
 	std::string CalTransfTemp = reader.Get("system", "Cal_rr_ri_ir_ii", "1.0 0.0 0.0 1.0");
@@ -199,13 +370,12 @@ void DumpConfig(void)
 {
 	std::ostringstream msgstr;
 	
-	char msgtxt[2048];
-	
 	msgstr << "Default/programmed configuration values are:"
 		<< "\n\tPRogname = " << gRadarConfig.ProgramName
 		<< "\n\tVersion = " << gRadarConfig.Version
 		<< "\n\tNumradars = " << gRadarConfig.NumRadars
 		<< "\n\tNumThreads = " << gRadarConfig.NumThreads
+		<< "\n\tBatchCPIs = " << gRadarConfig.BatchCPIs
 		<< "\n\tDataFileRoot = " << gRadarConfig.DataFileRoot
 		<< "\n\tSPWinDir = " << gRadarConfig.SPWinDir
 		<< "\n\tRecordRawDataFromStart = " << gRadarConfig.RecordRawDataFromStart
@@ -222,6 +392,11 @@ void DumpConfig(void)
 		<< "\n\tNWRIPerBlock = " << gRadarConfig.NWRIPerBlock
 		<< "\n\tFadeMemVal = " << gRadarConfig.FadeMemVal
 		<< "\n\tDC_CalOnly = " << gRadarConfig.DC_CalOnly
+		<< "\n\tCalBenchmark = " << gRadarConfig.CalBenchmark
+		<< "\n\tCalStreaming = " << gRadarConfig.CalStreaming
+		<< "\n\tCalStateFile = " << gRadarConfig.CalStateFile
+		<< "\n\tCalSaveInterval = " << gRadarConfig.CalSaveInterval
+		<< "\n\tCalSubBands = " << gRadarConfig.CalSubBands
 		<< "\n\tAutoCalOn = " << gRadarState.AutoCalOn
 		<< "\n\tASIO Priority = " << gRadarConfig.ASIOPriority 
 		<< "\n\tRx ADC Channel = " << gRadarConfig.RxADC_Chan
@@ -232,7 +407,7 @@ void DumpConfig(void)
 		<< "\n\tMinRefLevel = " << gRadarConfig.MinRefLevel
 		<< "\n\tTransmitModAmp = " << gRadarState.TransmitModAmp
 		<< "\n\tTransmitModOn = " << gRadarState.TransmitModOn
-		<< "\n\tTransmitLongSweep = " << gRadarState.TransmitLongSweep << " (record only)"
+		<< "\n\tTransmitLongSweep = " << gRadarState.TransmitLongSweep << " (sonar only)"
 		<< "\n\tTxRxSampleOffset = " << gRadarConfig.TxRxSampleOffset
 		<< "\n\tDispRange = " << gRadarState.DispRange
 		<< "\n\tSimOn = " << gRadarState.SimOn
@@ -245,10 +420,78 @@ void DumpConfig(void)
 		<< "\n\tPendMinorAxis = " << gRadarConfig.PendMinorAxis 
 		<< "\n\tRadarDistance = " << gRadarConfig.RadarDistance
 		<< "\n\tPendLatitude = " << gRadarConfig.PendLatitude
-		<< "\n\tSonar = " << gRadarConfig.Sonar << "(not fully implemented)"
+		<< "\n\tSimNumTargets = " << gRadarConfig.SimNumTargets
+		<< "\n\tSimTargetRCS = " << (gRadarConfig.SimTargetRCS.empty() ? 0.0 : gRadarConfig.SimTargetRCS[0])
+			<< " dB (first of " << gRadarConfig.SimTargetRCS.size() << ")"
+		<< "\n\tSimThreads = " << gRadarConfig.SimThreads
+		<< "\n\tSimSeed = " << gRadarConfig.SimSeed
+		<< "\n\tSimScenario = " << gRadarConfig.SimScenario
+		<< "\n\tVirtualTime = " << gRadarConfig.VirtualTime
+		<< "\n\tSimFrames = " << gRadarConfig.SimFrames
+		<< "\n\tVirtualEpoch = " << (long long)gRadarConfig.VirtualEpoch
+		<< "\n\tGoldenFile = " << gRadarConfig.GoldenFile
+		<< "\n\tSonar = " << gRadarConfig.Sonar
 		<< "\n\tSonarFrequency = " << gRadarConfig.SonarFreq
-		<< "\n\tSonarBandwidth = " << gRadarConfig.SonarBandwidth;
-
+		<< "\n\tSonarBandwidth = " << gRadarConfig.SonarBandwidth
+		<< "\n\tProcessingMode = " << gRadarConfig.ProcessingMode << " (0 CW, 1 LFM, 2 up/down LFM, 3 sonar)"
+		<< "\n\tNetPublish = " << gRadarConfig.NetPublish
+		<< "\n\tNetUseTCP = " << gRadarConfig.NetUseTCP
+		<< "\n\tNetHost = " << gRadarConfig.NetHost
+		<< "\n\tNetPort = " << gRadarConfig.NetPort
+		<< "\n\tNetSendRDI = " << gRadarConfig.NetSendRDI
+		<< "\n\tNetQueueDepth = " << gRadarConfig.NetQueueDepth
+		<< "\n\tNetKeyFrameInterval = " << gRadarConfig.NetKeyFrameInterval
+		<< "\n\tNetRDIQuantdB = " << gRadarConfig.NetRDIQuantdB
+		<< "\n\tNetSelfTest = " << gRadarConfig.NetSelfTest
+		<< "\n\tCFARType = " << gRadarConfig.CFARType << " (0 off, 1 CA, 2 OS, 3 GO)"
+		<< "\n\tCFARGuardRange = " << gRadarConfig.CFARGuardRange
+		<< "\n\tCFARTrainRange = " << gRadarConfig.CFARTrainRange
+		<< "\n\tCFARGuardDoppler = " << gRadarConfig.CFARGuardDoppler
+		<< "\n\tCFARTrainDoppler = " << gRadarConfig.CFARTrainDoppler
+		<< "\n\tCFARThresholddB = " << gRadarConfig.CFARThresholddB
+		<< "\n\tCFAROSRank = " << gRadarConfig.CFAROSRank
+		<< "\n\tCFARMaxDetections = " << gRadarConfig.CFARMaxDetections
+		<< "\n\tMTIType = " << gRadarConfig.MTIType
+		<< "\n\tMTITimeConstant = " << gRadarConfig.MTITimeConstant
+		<< "\n\tTrackerOn = " << gRadarConfig.TrackerOn
+		<< "\n\tTrackMaxTracks = " << gRadarConfig.TrackMaxTracks
+		<< "\n\tTrackGate = " << gRadarConfig.TrackGate
+		<< "\n\tTrackRangeNoise = " << gRadarConfig.TrackRangeNoise
+		<< "\n\tTrackDopplerNoise = " << gRadarConfig.TrackDopplerNoise
+		<< "\n\tTrackRangeAccel = " << gRadarConfig.TrackRangeAccel
+		<< "\n\tTrackDopplerAccel = " << gRadarConfig.TrackDopplerAccel
+		<< "\n\tTrackConfirmHits = " << gRadarConfig.TrackConfirmHits
+		<< "\n\tTrackMaxMisses = " << gRadarConfig.TrackMaxMisses
+		<< "\n\tTrackRecordTentative = " << gRadarConfig.TrackRecordTentative
+		<< "\n\tFusionOn = " << gRadarConfig.FusionOn
+		<< "\n\tFusionDopplerNoise = " << gRadarConfig.FusionDopplerNoise
+		<< "\n\tFusionRangeNoise = " << gRadarConfig.FusionRangeNoise
+		<< "\n\tFusionAccelNoise = " << gRadarConfig.FusionAccelNoise
+		<< "\n\tFusionGate = " << gRadarConfig.FusionGate
+		<< "\n\tFusionUseRange = " << gRadarConfig.FusionUseRange
+		<< "\n\tFusionPrecessionMemory = " << gRadarConfig.FusionPrecessionMemory
+		<< "\n\tPrecessionOn = " << gRadarConfig.PrecessionOn
+		<< "\n\tPrecessionMinAmplitude = " << gRadarConfig.PrecessionMinAmplitude
+		<< "\n\tPrecessionMemory = " << gRadarConfig.PrecessionMemory
+		<< "\n\tPrecessionReportInterval = " << gRadarConfig.PrecessionReportInterval;
+
+	for (int role = 0; role < NumThreadRoles; role++) {
+		msgstr << "\n\tCPU" << threadRoleKey((ThreadRole)role) << " = "
+			<< (gRadarConfig.ThreadCPUs[role].empty() ? "any" : cpuListText(gRadarConfig.ThreadCPUs[role]))
+			<< ", Priority" << threadRoleKey((ThreadRole)role) << " = " << gRadarConfig.ThreadPriority[role];
+	}
+	msgstr << "\n\tReserveCPUs = " << gRadarConfig.ReserveCPUs
+		<< "\n\tNumaOn = " << gRadarConfig.NumaOn;
+	for (size_t node = 0; node < gRadarConfig.NumaCPUs.size(); node++) {
+		msgstr << "\n\tNumaCPUs" << node << " = " << cpuListText(gRadarConfig.NumaCPUs[node]);
+	}
+	msgstr << "\n\tHugePages = " << gRadarConfig.HugePages
+		<< "\n\tOverloadOn = " << gRadarConfig.OverloadOn
+		<< "\n\tOverloadHigh = " << gRadarConfig.OverloadHigh
+		<< "\n\tOverloadLow = " << gRadarConfig.OverloadLow
+		<< "\n\tOverloadStepBlocks = " << gRadarConfig.OverloadStepBlocks
+		<< "\n\tOverloadRecoverBlocks = " << gRadarConfig.OverloadRecoverBlocks
+		<< "\n\tOverloadDecimate = " << gRadarConfig.OverloadDecimate;
 
 		msgstr << "\n\tCalTransform = ";
 	for(int ind=0; ind< gRadarConfig.NumRadars ; ind++){
@@ -271,9 +514,7 @@ void DumpConfig(void)
 		<< "\n\tDataBaseRows = " << gRadarConfig.DataBaseRows;
 #endif
 
-	std::string msgbuf = msgstr.str();
-	snprintf(msgtxt, sizeof(msgtxt),"%s",msgbuf.c_str());  // Roundabout way to log stringstream text.
-	log_message((const char *)msgtxt);
+	log_message(msgstr.str());	// The whole dump is longer than the printf style log_message allows
 
 	return;
 
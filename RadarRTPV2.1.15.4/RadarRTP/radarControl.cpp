@@ -54,6 +54,13 @@ int start_radar()
 	log_message("Creating transmit waveform.");
 	create_waveform();
 
+	// The circular buffers and all of the processing buffers come from one block, sized here from the CPI
+	CPI_Params Params;
+	Params.Num_WRI = gRadarConfig.NWRIPerCPI;
+	Params.Samp_Per_WRI = gRadarConfig.NSamplesPerWRI;
+	Params.NumSensorsSet = gRadarState.NumSensorsSet;
+	gArena.reserve(Params);
+
 	buff_init();	/* Initialize the circular block buffer */
 
 	log_message("Initiating/starting Signal Processing threads.");
@@ -83,6 +90,11 @@ int start_radar()
 
 	gStreamTPTimeRef = std::chrono::steady_clock::now(); // Program time reference in standard clock units
 	gStreamSysTimeRef = std::chrono::system_clock::now(); 
+	if (gRadarConfig.VirtualTime) {		// Same time stamps on every run
+		gStreamSysTimeRef = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+			std::chrono::duration<double>(gRadarConfig.VirtualEpoch)));
+		log_message("Virtual time, the data starts at %.0lf s since 1970", gRadarConfig.VirtualEpoch);
+	}
 	log_message( "Portaudio Stream time reference %lf", gStreamPATimeRef);
 	
 	if (gRadarConfig.RecordProcDataFromStart) open_proc_data_file();
@@ -3,6 +3,8 @@
 //
 // The radar simulation module was not written to be thread-safe. 
 // It assumes that it will only be called from a single thread and will have unrestricted read/write access to the PendSimParms structure.
+// The exception is simRadarBlock(), which only changes the state of its own radar, so SimStage runs it
+// for different radars, and different groups of targets of a radar, on different threads.
 //
 // Simulation of the ADC input noise is accomplished by an independent thread that calls the ADC data callback
 // in place of the normal portAudio ADC callback.
@@ -10,6 +12,9 @@
 // Initial version by Frank Robey
 // Mar 2018	Moved target simulator from process.cpp, added ADC simulation
 // May 2019 Changed arrays of pointers over to use std::vector construct
+// Oct 2026 Several pendulums with their own RCS, made in float a block ahead on the SimStage threads
+// Oct 2026 Virtual time: the simulated ADC is paced by the processing instead of the clock, times from the sample count
+// Oct 2026 Scene from a scenario file: targets on paths, clutter, multipath and the noise of each radar
 
 /*
 RadarRTP - Radar Real time Program (RTP)
@@ -30,8 +35,8 @@ See the GNU General Public License for more details, supplied with this source a
 
 #include "stdafx.h"
 #include "radarc.h"
-#include <random>
 #include <complex>
+#include "noise.h"
 
 // Forward declare routine local to this module
 void fillADCBuffer(float *adcBuff, int nsamples, float ADCStdDev);
@@ -42,12 +47,31 @@ void stopSimADC();
 // Another local variable used to count input ADC buffer callbacks
 int ADCFrameCount = 0;
 volatile bool ADC_SimStopFlag = 0;
+extern bool radar_running;	// In radarControl.cpp
 std::thread ADCSimThread;
-std::default_random_engine generator;
+GaussNoise ADCNoise;		// Seeded from SimSeed in startSimADC
 //FILE * fpFileSimTemp;
 int _tmpSimCount = 0;
 
 
+// The radars are spaced evenly on a half circle of radius RadarDistance around the pendulum rest point,
+// unless the scenario places them.  Used by the simulation and by the fusion, so both place them the same way.
+void RadarLocations(int NumRadars, double RadarX[], double RadarY[])
+{
+	if ((int)gScenario.RadarX.size() >= NumRadars) {
+		for (int rindex = 0; rindex < NumRadars; rindex++) {
+			RadarX[rindex] = gScenario.RadarX[rindex];
+			RadarY[rindex] = gScenario.RadarY[rindex];
+		}
+		return;
+	}
+	double RadarAngle = (double)TWOPI / 2.0 / (double)MAX(NumRadars, 1);
+	for (int rindex = 0; rindex < NumRadars; rindex++) {
+		RadarX[rindex] = gRadarConfig.RadarDistance* cos(RadarAngle*(double)rindex);
+		RadarY[rindex] = gRadarConfig.RadarDistance* sin(RadarAngle*(double)rindex);
+	}
+}
+
 int PendSimParms::RadarSimInit()
 {
 	NumSampPerWRI = gRadarConfig.NSamplesPerWRI;
@@ -72,10 +96,16 @@ int PendSimParms::RadarSimInit()
 	msgstr << "Sim radar base angle & locations:  "<<RadarAngle<<" rad\n ";
 	
 	// The following fills in the member variables needed for the sim
+	double RadarX[MaxRadars], RadarY[MaxRadars];
+	RadarLocations(NumRadars, RadarX, RadarY);
+	const bool Placed = (int)gScenario.RadarX.size() >= NumRadars;
+	if (!gScenario.RadarX.empty() && !Placed)
+		log_message("Warning: Scenario places %d radars but there are %d, using the half circle", (int)gScenario.RadarX.size(), NumRadars);
 	for (int rindex = 0; rindex < NumRadars; rindex++) {
-		RadarXv.push_back(gRadarConfig.RadarDistance* cos(RadarAngle*(double)rindex));
-		RadarYv.push_back( gRadarConfig.RadarDistance* sin(RadarAngle*(double)rindex));
-		msgstr << rindex << " (" << RadarXv[rindex] << " " << RadarYv[rindex] << ") ";
+		RadarXv.push_back(RadarX[rindex]);
+		RadarYv.push_back(RadarY[rindex]);
+		RadarZv.push_back(Placed ? gScenario.RadarZ[rindex] : 0.0);
+		msgstr << rindex << " (" << RadarXv[rindex] << " " << RadarYv[rindex] << " " << RadarZv[rindex] << ") ";
 	}
 	
 	std::string msgbuf = msgstr.str();
@@ -89,23 +119,58 @@ int PendSimParms::RadarSimInit()
 		PendFreq.push_back(TWOPI / 4.0);
 	}
 
+	// The scene from the scenario file, or the pendulums spread evenly through the swing
+	Targets.clear();
+	Clutter.clear();
+	if (gScenario.Loaded) {
+		Targets = gScenario.Targets;
+		Clutter = gScenario.Clutter;
+		Multipath = gScenario.Multipath;
+		GroundZ = gScenario.GroundZ;
+		MultipathCoef = gScenario.MultipathCoef;
+	}
+	else {
+		int NumPend = MAX(gRadarConfig.SimNumTargets, 1);
+		for (int target = 0; target < NumPend; target++) {
+			SimTarget tgt;
+			tgt.SwingPhase = ((double)TWOPI) * target / NumPend;
+			double RCS = gRadarConfig.SimTargetRCS.empty() ? 0.0 :
+				gRadarConfig.SimTargetRCS[MIN(target, (int)gRadarConfig.SimTargetRCS.size() - 1)];
+			tgt.Amp = (float)pow(10.0, RCS / 20.0);
+			Targets.push_back(tgt);
+		}
+		Multipath = false;
+	}
+	NumTargets = (int)Targets.size();
+	ClutterWRI.assign(NumRadars, std::vector<RTPComplex>(NumSampPerWRI));
+	ClutterCW.assign(NumRadars, -1);
+
 	siminit = true;
 	log_message("Initialized radar data simulation");
 	return 0;
 }
 void fillADCBuffer(float *adcBuff, int nsamples, float ADCStdDev)
 {
-	std::normal_distribution<float> ADCDistribution(0.0, ADCStdDev);
-	for (int i = 0; i < nsamples; i++)
-	{
-		adcBuff[i] = ADCDistribution(generator);
-	}
+	ADCNoise.fill(adcBuff, nsamples, ADCStdDev);
 	return;
 }
 
+// Scales the noise of each radar's channels, which are interleaved frame by frame, when the scenario gives
+// the radars different noise levels.  ChanScale holds one value per ADC channel.
+static void scaleADCChannels(float *adcBuff, int nsamples, const std::vector<float> &ChanScale)
+{
+	const int NumChans = (int)ChanScale.size();
+	for (int i = 0; i < nsamples; i += NumChans)
+		for (int c = 0; c < NumChans; c++)
+			adcBuff[i + c] *= ChanScale[c];
+}
+
 // The following is a thread that creates a simulation of the streaming portaudio interface
 // Only noise and timing are simulated
 // It calls the normal portaudio callback
+// The times handed to the callback come from the sample count.  In virtual time there is no pacing: a
+// block is made as soon as there is a free buffer, so the run goes as fast as the processing allows and
+// no block is dropped.  It stops after SimFrames blocks, if set.
 int simADCdata(void)
 {
 	// Allocate and create buffers
@@ -128,6 +193,15 @@ int simADCdata(void)
 	else {
 		stdDev = 1e-4f;
 	}
+	// Noise of each radar relative to stdDev, from the scenario
+	const int ChansPerRadar = gRadarConfig.ReceiveRealOnly ? 1 : 2;
+	std::vector<float> ChanScale;
+	bool ScaleChans = false;
+	for (int rindex = 0; rindex < (int)gRadarConfig.NumRadars && !gScenario.NoisedB.empty(); rindex++) {
+		float scale = (float)pow(10.0, gScenario.radarNoisedB(rindex, 0.0) / 20.0) / stdDev;
+		ScaleChans = ScaleChans || (scale != 1.0f);
+		for (int c = 0; c < ChansPerRadar; c++) ChanScale.push_back(scale);
+	}
 	double timeincr = (double(gRadarConfig.NSamplesPerWRI*gRadarConfig.NWRIPerBlock)) / gRadarConfig.SampleRate;
 	//std::cout << "Time increment is: " << timeincr << " " << gRadarConfig.SampleRate << std::endl;
 	ADCtimeInfo.currentTime = 1e-3;
@@ -135,15 +209,27 @@ int simADCdata(void)
 	ADCtimeInfo.outputBufferDacTime = 2 * timeincr;  // PaTime is in seconds
 	long int timeIncruSec;
 	timeIncruSec = (long int)(timeincr * 1e6);
-	// Wait a bit before starting data flowing.  Should probably wait on a flag instead.
-	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	long long SampleCount = 0;
+	// Wait for start_radar() to finish, so the time references are set and the recording files are open
+	// before the first block.
+	while (!radar_running && !ADC_SimStopFlag)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	x = std::chrono::steady_clock::now();
 	while (!ADC_SimStopFlag) {
+		if (gRadarConfig.VirtualTime) {
+			if ((gRadarConfig.SimFrames > 0) && (framecount >= gRadarConfig.SimFrames)) break;
+			if (!buff_Wait_For_Space()) continue;
+		}
 		fillADCBuffer(&adcBuffer[0], nADCsamps, stdDev);
-		ADCtimeInfo.currentTime += timeincr;
-		ADCtimeInfo.inputBufferAdcTime += timeincr;
-		ADCtimeInfo.outputBufferDacTime += timeincr;
-		x += std::chrono::microseconds(timeIncruSec);
-		std::this_thread::sleep_until(x);
+		if (ScaleChans) scaleADCChannels(&adcBuffer[0], nADCsamps, ChanScale);
+		SampleCount += framesPerBuffer;
+		ADCtimeInfo.inputBufferAdcTime = SampleCount / gRadarConfig.SampleRate;
+		ADCtimeInfo.currentTime = 1e-3 + ADCtimeInfo.inputBufferAdcTime;
+		ADCtimeInfo.outputBufferDacTime = (SampleCount + 2 * framesPerBuffer) / gRadarConfig.SampleRate;
+		if (!gRadarConfig.VirtualTime) {
+			x += std::chrono::microseconds(timeIncruSec);
+			std::this_thread::sleep_until(x);
+		}
 		paWaveCallback(&adcBuffer[0], &dacBuffer[0], framesPerBuffer, &ADCtimeInfo, statusFlags, &framecount);
 	}
 	return 1;
@@ -160,18 +246,30 @@ void startSimADC()
 {
 	ADC_SimStopFlag = false;
 	gRadarState.NumSensorsSet = gRadarConfig.NumRadars;  // Variable used in case actual ADC doesn't have the channels needed.
+	uint64_t Seed = (uint64_t)gRadarConfig.SimSeed;
+	if (gRadarConfig.VirtualTime && (Seed == 0)) {
+		log_message("Virtual time runs need a repeatable noise seed, using SimSeed = 1");
+		Seed = 1;
+	}
+	ADCNoise.seed(Seed);
 	ADCSimThread = std::thread(simADCdata);
 
 }
 
-void PendSimParms::pendPosition(double postime, double pos[3])
+bool simRunDone()
+{
+	return gRadarConfig.VirtualTime && (gRadarConfig.SimFrames > 0) && (gRadarState.Blocks_output >= gRadarConfig.SimFrames);
+}
+
+void PendSimParms::pendPosition(double postime, double pos[3], int target)
 {
 
 	double cosF, sinF;
 	double xi, yi;
 	if (!siminit) RadarSimInit();
-	xi = MajorAxis * cos(postime*PendRadFreq + PendInitPhase+TWOPI/4.0);
-	yi = MinorAxis * sin(postime*PendRadFreq + PendInitPhase + TWOPI / 4.0);
+	double SwingPhase = PendInitPhase + Targets[target].SwingPhase;
+	xi = MajorAxis * cos(postime*PendRadFreq + SwingPhase+TWOPI/4.0);
+	yi = MinorAxis * sin(postime*PendRadFreq + SwingPhase + TWOPI / 4.0);
 
 	cosF = cos(postime *MajorAxisRadFreq + initMajorAxisPhase );
 	sinF = sin(postime *MajorAxisRadFreq + initMajorAxisPhase );
@@ -183,108 +281,331 @@ void PendSimParms::pendPosition(double postime, double pos[3])
 
 }
 
+void PendSimParms::targetPosition(double postime, double pos[3], int target)
+{
+	if (Targets[target].Type == SimTargetPath)
+		Targets[target].pathPosition(postime, pos);
+	else
+		pendPosition(postime, pos, target);
+}
+
 void PendSimParms::pendDistances(double postime, std::vector<double> *distances)
 {
-	double pendpos[3];
 	if (!siminit) RadarSimInit();
-	pendPosition(postime, pendpos);
-
+	if (NumTargets == 0) return;
 	for (int rindex = 0; rindex < NumRadars; rindex++)
-		distances->at(rindex) = sqrt(
-		(RadarXv[rindex] - pendpos[0]) * (RadarXv[rindex] - pendpos[0]) +
-			(RadarYv[rindex] - pendpos[1])*  (RadarYv[rindex] - pendpos[1]))
-		- BobRadius;
-
+		distances->at(rindex) = pendDistance(postime, 0, rindex);
 	return;
+}
 
+// Range from radar rindex to the near side of the target on the direct path
+double PendSimParms::pendDistance(double postime, int target, int rindex)
+{
+	double pos[3], Range[3];
+	float Gain[3];
+	targetPosition(postime, pos, target);
+	rayRanges(pos, rindex, Range, Gain);
+	return Range[0] - ((Targets[target].Type == SimTargetPendulum) ? BobRadius : 0.0);
 }
 
-void PendSimParms::simTargetData(PaTime simTimeStart, sensordata< RTPComplex> *SimData, double SimAmpdB)
+// Ranges and gains of the paths between radar rindex and a point.  The first is the direct path.  With
+// multipath there are also the paths that bounce off the ground going out or coming back, which are the
+// same length and so are one ray of twice the gain, and the path that bounces both ways.  A bounce is the
+// direct path to the image of the point under the ground plane.  Returns the number of rays.
+int PendSimParms::rayRanges(const double pos[3], int rindex, double Range[3], float Gain[3]) const
 {
-	int numpts = NumSampPerWRI * NumWRIperBlock;
-	double simTimeEnd = simTimeStart + ((double)numpts) * samplePeriod;
-	std::vector<double> distanceStart(SimData->sensors);
-	std::vector<double> distanceEnd(SimData->sensors);
-	double SimAmpLin;
-	double omega0 = ((double)TWOPI)*RadarFreq;
-	//std::cout << " " << simTimeStart;
-	if (!siminit) RadarSimInit();
+	double dx = RadarXv[rindex] - pos[0];
+	double dy = RadarYv[rindex] - pos[1];
+	double dz = RadarZv[rindex] - pos[2];
+	Range[0] = sqrt(dx * dx + dy * dy + dz * dz);
+	Gain[0] = 1.0f;
+	if (!Multipath) return 1;
+	dz = RadarZv[rindex] - (2.0 * GroundZ - pos[2]);
+	double Image = sqrt(dx * dx + dy * dy + dz * dz);
+	Range[1] = 0.5 * (Range[0] + Image);
+	Gain[1] = (float)(2.0 * MultipathCoef);
+	Range[2] = Image;
+	Gain[2] = (float)(MultipathCoef * MultipathCoef);
+	return 3;
+}
 
-	if (fabs(gRadarState.SimAmp <= 0.0f))
-		SimAmpLin = pow(10.0, (double)SimAmpdB / 20.0);
-	else
-		SimAmpLin = 1.0;
-	
-	if (gRadarConfig.SimPend) {
-		pendDistances(simTimeStart, &distanceStart);
-		for (int wri = 0; wri < NumWRIperBlock; wri++) {
-			pendDistances(simTimeStart + (1L + wri)*NumSampPerWRI*samplePeriod, &distanceEnd);
-		//	debugPrint("Sim time: %lf, %d, d: %lf", simTimeStart, wri, distanceEnd[0]);
-			if ((!gRadarState.TransmitModOn) || (gRadarState.TransmitModAmp == 0.0)) { // CW operation
-				for (int rindex = 0; rindex < NumRadars; rindex++) {
-					double Delta = 2.0*(distanceEnd[rindex] - distanceStart[rindex]) / (VLIGHT * (double)NumSampPerWRI);
-					double tau0 = 2.0*distanceStart[rindex] / VLIGHT;
-					std::complex<double> PhaseRot;
-					std::complex<double> tempData;
-					PhaseRot = exp(std::complex<double>(0.0, Delta*omega0));
-					int offset = wri * NumSampPerWRI;
-
-					tempData = SimAmpLin * exp(std::complex<double>(0.0, tau0*omega0));
-				
-						for (int i = 0; i < NumSampPerWRI; i++) {
-							(*SimData)(wri,i,rindex) = (RTPComplex)tempData;
-							tempData = tempData * PhaseRot;
-						}
-	
-					distanceStart[rindex] = distanceEnd[rindex];
-				}
+// Adds Amp * exp(j(A + p i + q i(i+1)/2)), i = 0..N-1, to Out.  This is the return of one target over
+// one WRI: the phase steps by p, and for the LFM the step itself steps by q.
+// Done in float on SimLanes samples at once.  Lane j holds sample i0+j and each pass moves every lane on
+// SimLanes samples with its own rotation S_j, which in turn steps by the common G.  The start values
+// are exact (double), and the lanes are pulled back to unit magnitude every few passes, so the float
+// rounding can't build up over a long WRI.  The lanes are kept at unit magnitude and scaled by Amp as
+// they are added, so the step doesn't depend on Amp (a zero or tiny Amp would make it 0/0).
+#define SimLanes 8
+static void addRotation(float *Out, int N, float Amp, double A, double p, double q)
+{
+	if (Amp == 0.0f) return;	// A ray with no gain, such as a bounce with MultipathCoef = 0
+	float zr[SimLanes], zi[SimLanes], sr[SimLanes], si[SimLanes];
+	for (int j = 0; j < SimLanes; j++) {
+		double ph = A + p * j + q * 0.5 * j * (j + 1);
+		zr[j] = (float)cos(ph);
+		zi[j] = (float)sin(ph);
+		ph = p * SimLanes + q * 0.5 * SimLanes * (SimLanes + 1) + q * SimLanes * j;
+		sr[j] = (float)cos(ph);
+		si[j] = (float)sin(ph);
+	}
+	const float gr = (float)cos(q * SimLanes * SimLanes), gi = (float)sin(q * SimLanes * SimLanes);
+
+	int i0 = 0, pass = 0;
+	for (; i0 + SimLanes <= N; i0 += SimLanes) {
+		float *o = &Out[2 * i0];
+		for (int j = 0; j < SimLanes; j++) {
+			o[2 * j] += Amp * zr[j];
+			o[2 * j + 1] += Amp * zi[j];
+			float tr = zr[j] * sr[j] - zi[j] * si[j];
+			zi[j] = zr[j] * si[j] + zi[j] * sr[j];
+			zr[j] = tr;
+			tr = sr[j] * gr - si[j] * gi;
+			si[j] = sr[j] * gi + si[j] * gr;
+			sr[j] = tr;
+		}
+		if ((++pass & 15) == 0) {	// One Newton step towards |z| = 1, |s| = 1
+			for (int j = 0; j < SimLanes; j++) {
+				float gz = 1.5f - 0.5f * (zr[j] * zr[j] + zi[j] * zi[j]);
+				float gs = 1.5f - 0.5f * (sr[j] * sr[j] + si[j] * si[j]);
+				zr[j] *= gz; zi[j] *= gz;
+				sr[j] *= gs; si[j] *= gs;
 			}
-			else {
-				double Delta, tau0, T, delta, argument;
-				double omegaB = RadarBandwidth * ((double)TWOPI);
-				std::complex<double> PhaseRot, PhaseRot2, qRot;
-				std::complex<double> tempData;
-				T = ((double)NumSampPerWRI) * samplePeriod;
-				delta = samplePeriod;
-				for (int rindex = 0; rindex < NumRadars; rindex++) {
-					Delta = 2.0*(distanceEnd[rindex] - distanceStart[rindex]) / (VLIGHT * (double)NumSampPerWRI);
-					tau0 = 2.0*distanceStart[rindex] / VLIGHT;
-
-					argument = ((omega0 - omegaB / 2.0) + omegaB * tau0 / (2.0*T))*tau0;
-					tempData = SimAmpLin * exp(std::complex<double>(0.0, argument));
-					argument = Delta * (omega0 - omegaB / 2.0)
-						- 2.0*omegaB * tau0*(delta + Delta) / T +
-						omegaB * Delta*(2 * delta + Delta) / (2.0* T);
-					PhaseRot = exp(std::complex<double>(0.0, argument));
-					argument = omegaB * Delta*(2 * delta - Delta) / (T);
-					qRot = exp(std::complex<double>(0.0, argument));
-					PhaseRot2 = qRot;
-					int offset = wri * NumSampPerWRI;
-					for (int i = 0; i < NumSampPerWRI; i++) {
-						// Temporary test that cal works
-						// (*SimData)(wri,i,rindex) = (RTPComplex)tempData+RTPComplex((float) (0.001*tempData.imag()), (float) (0.1*tempData.imag()));
-						(*SimData)(wri, i, rindex) = (RTPComplex)tempData;
-						tempData = tempData * PhaseRot*PhaseRot2;
-						PhaseRot2 *= qRot;
-					}
-					distanceStart[rindex] = distanceEnd[rindex];
+		}
+	}
+	for (int j = 0; i0 + j < N; j++) {
+		Out[2 * (i0 + j)] += Amp * zr[j];
+		Out[2 * (i0 + j) + 1] += Amp * zi[j];
+	}
+}
+
+// Phase of a return over one WRI, as A, p and q for addRotation, when the range goes from R0 at the start
+// of the WRI to R1 at the start of the next.  CW gives a tone at the Doppler; the sweep adds the beat of
+// the delay.
+void PendSimParms::wriPhase(double R0, double R1, bool CW, double &A, double &p, double &q) const
+{
+	const double omega0 = ((double)TWOPI)*RadarFreq;
+	const double omegaB = RadarBandwidth * ((double)TWOPI);
+	const double T = ((double)NumSampPerWRI) * samplePeriod;
+	const double delta = samplePeriod;
+	double Delta = 2.0*(R1 - R0) / (VLIGHT * (double)NumSampPerWRI);
+	double tau0 = 2.0*R0 / VLIGHT;
+	if (CW) { // CW operation
+		A = tau0 * omega0;
+		p = Delta * omega0;
+		q = 0.0;
+	}
+	else {
+		A = ((omega0 - omegaB / 2.0) + omegaB * tau0 / (2.0*T))*tau0;
+		p = Delta * (omega0 - omegaB / 2.0)
+			- 2.0*omegaB * tau0*(delta + Delta) / T +
+			omegaB * Delta*(2 * delta + Delta) / (2.0* T);
+		q = omegaB * Delta*(2 * delta - Delta) / (T);
+	}
+}
+
+// The clutter doesn't move, so its return is the same every WRI.  It is made once, at unit amplitude,
+// and made again only if the transmit changes between CW and the sweep.
+void PendSimParms::makeClutterWRI(int rindex, bool CW)
+{
+	std::vector<RTPComplex> &c = ClutterWRI[rindex];
+	std::fill(c.begin(), c.end(), RTPComplex(0.0f, 0.0f));
+	for (const SimScatterer &s : Clutter) {
+		double pos[3] = { s.X, s.Y, s.Z }, Range[3];
+		float Gain[3];
+		int NumRays = rayRanges(pos, rindex, Range, Gain);
+		for (int ray = 0; ray < NumRays; ray++) {
+			double A, p, q;
+			wriPhase(Range[ray], Range[ray], CW, A, p, q);
+			addRotation(reinterpret_cast<float *>(c.data()), NumSampPerWRI, s.Amp * Gain[ray], A, p, q);
+		}
+	}
+	ClutterCW[rindex] = CW ? 1 : 0;
+}
+
+// The simulated returns for one radar over one block, NumWRIperBlock*NumSampPerWRI samples, into Out.
+// Only targets Group, Group+NumGroups, ... are done, so the targets of a radar can be split over threads;
+// group 0 also adds the clutter.  Radars are independent, so different radars can be done on different
+// threads.  The ranges of every target are found once per WRI, and each WRI is then one rotation.
+void PendSimParms::simRadarBlock(PaTime simTimeStart, int rindex, RTPComplex *Out, float SimAmpLin, int Group, int NumGroups)
+{
+	const int numpts = NumSampPerWRI * NumWRIperBlock;
+	float *o = reinterpret_cast<float *>(Out);
+	if (!siminit) RadarSimInit();
+	memset((void *)Out, 0, numpts * sizeof(RTPComplex));
+
+	if (gRadarConfig.SimPend || gScenario.Loaded) {
+		const bool CW = (!gRadarState.TransmitModOn) || (gRadarState.TransmitModAmp == 0.0);
+		const double WRITime = ((double)NumSampPerWRI) * samplePeriod;
+		const int NumEdges = NumWRIperBlock + 1;
+		std::vector<double> Range(3 * NumEdges);	// [ray][start of each WRI and end of the last]
+		float Gain[3];
+		int NumRays = 1;
+		for (int target = Group; target < NumTargets; target += NumGroups) {
+			const double Near = (Targets[target].Type == SimTargetPendulum) ? BobRadius : 0.0;
+			for (int edge = 0; edge < NumEdges; edge++) {
+				double pos[3], R[3];
+				targetPosition(simTimeStart + edge * WRITime, pos, target);
+				NumRays = rayRanges(pos, rindex, R, Gain);
+				for (int ray = 0; ray < NumRays; ray++)
+					Range[ray * NumEdges + edge] = R[ray] - Near;
+			}
+			for (int ray = 0; ray < NumRays; ray++) {
+				const double *R = &Range[ray * NumEdges];
+				const float Amp = SimAmpLin * Targets[target].Amp * Gain[ray];
+				for (int wri = 0; wri < NumWRIperBlock; wri++) {
+					double A, p, q;
+					wriPhase(R[wri], R[wri + 1], CW, A, p, q);
+					addRotation(&o[2 * wri * NumSampPerWRI], NumSampPerWRI, Amp, A, p, q);
 				}
 			}
 		}
-	}
-	else {   // Simple simulation injecting a sine wave varying as a sine wave
-		float SimAmpLinf = (float)SimAmpLin;
-		for (int rindex = 0; rindex < NumRadars; rindex++) {
-			for( int wri=0;wri< NumWRIperBlock;++wri)
-				for( int timesamp=0;timesamp< NumSampPerWRI ; timesamp++){
-			
-				(*SimData)(wri,timesamp,rindex) = 
-					SimAmpLinf * exp(RTPComplex(0.0f, (float)Phase[rindex]));
-				Phase[rindex] += (phaseinc*sin(PendFreq[rindex]));
-				PendFreq[rindex] += pendfreqinc;
+		if ((Group == 0) && !Clutter.empty()) {
+			if (ClutterCW[rindex] != (CW ? 1 : 0)) makeClutterWRI(rindex, CW);
+			const float *c = reinterpret_cast<const float *>(ClutterWRI[rindex].data());
+			for (int wri = 0; wri < NumWRIperBlock; wri++) {
+				float *ow = &o[2 * wri * NumSampPerWRI];
+				for (int i = 0; i < 2 * NumSampPerWRI; i++)
+					ow[i] += SimAmpLin * c[i];
 			}
 		}
 	}
+	else if (Group == 0) {   // Simple simulation injecting a sine wave varying as a sine wave
+		for (int i = 0; i < numpts; i++) {
+			Out[i] = SimAmpLin * exp(RTPComplex(0.0f, (float)Phase[rindex]));
+			Phase[rindex] += (phaseinc*sin(PendFreq[rindex]));
+			PendFreq[rindex] += pendfreqinc;
+		}
+	}
 
 	return;
 }
+
+int SimStage::initialize(PendSimParms *SimIn, int NumThreadsIn)
+{
+	Sim = SimIn;
+	NumThreads = MAX(NumThreadsIn, 0);
+	BlockLen = Sim->NumSampPerWRI * Sim->NumWRIperBlock;
+	// With more threads than radars the targets of each radar are split as well
+	NumGroups = 1;
+	if (NumThreads > Sim->NumRadars)
+		NumGroups = MAX(MIN((NumThreads + Sim->NumRadars - 1) / Sim->NumRadars, Sim->NumTargets), 1);
+	Front.assign(BlockLen * Sim->NumRadars, RTPComplex(0.0f, 0.0f));
+	Back.assign(BlockLen * Sim->NumRadars, RTPComplex(0.0f, 0.0f));
+	Partial.assign(BlockLen * Sim->NumRadars * (NumGroups - 1), RTPComplex(0.0f, 0.0f));
+	Stop = false;
+	Ahead = false;
+	log_message("Target simulation: %d targets, %d clutter scatterers, %d threads, %d target groups per radar",
+		Sim->NumTargets, (int)Sim->Clutter.size(), NumThreads, NumGroups);
+	return 0;
+}
+
+// The threads are started by the first block that is simulated, so they aren't there when SimOn never is
+void SimStage::startThreads()
+{
+	for (int t = 0; t < NumThreads; t++)
+		Threads.push_back(std::thread(&SimStage::run, this, t));
+}
+
+void SimStage::makeJob(int job, PaTime t, float Amp)
+{
+	int rindex = job % Sim->NumRadars;
+	int group = job / Sim->NumRadars;
+	RTPComplex *Out = (group == 0) ? &Back[rindex * BlockLen] :
+		&Partial[(rindex * (NumGroups - 1) + group - 1) * BlockLen];
+	Sim->simRadarBlock(t, rindex, Out, Amp, group, NumGroups);
+}
+
+void SimStage::addGroups()
+{
+	for (int rindex = 0; rindex < Sim->NumRadars; rindex++) {
+		float *o = reinterpret_cast<float *>(&Back[rindex * BlockLen]);
+		for (int group = 1; group < NumGroups; group++) {
+			const float *p = reinterpret_cast<const float *>(&Partial[(rindex * (NumGroups - 1) + group - 1) * BlockLen]);
+			for (unsigned int i = 0; i < 2 * BlockLen; i++)
+				o[i] += p[i];
+		}
+	}
+}
+
+void SimStage::run(int ID)
+{
+	setThreadRole(ThreadSim, ID);
+	unsigned long Seen = 0;
+	std::unique_lock<std::mutex> lock(Lock);
+	while (true) {
+		Go.wait(lock, [&] { return Stop || (Job != Seen); });
+		if (Stop) break;
+		Seen = Job;
+		PaTime t = JobTime;
+		float Amp = JobAmp;
+		lock.unlock();
+		for (int job = ID; job < Sim->NumRadars * NumGroups; job += NumThreads)
+			makeJob(job, t, Amp);
+		lock.lock();
+		if (--Busy == 0) {
+			addGroups();
+			Done.notify_all();
+		}
+	}
+}
+
+void SimStage::launch(int Frame, float Amp)
+{
+	JobFrame = Frame;
+	PaTime t = ((double)Frame) * BlockLen * Sim->samplePeriod;
+	if (NumThreads == 0) {
+		for (int job = 0; job < Sim->NumRadars * NumGroups; job++)
+			makeJob(job, t, Amp);
+		addGroups();
+		JobAmp = Amp;
+		return;
+	}
+	std::unique_lock<std::mutex> lock(Lock);
+	JobTime = t;
+	JobAmp = Amp;
+	Busy = NumThreads;
+	Job++;
+	Go.notify_all();
+}
+
+void SimStage::wait()
+{
+	std::unique_lock<std::mutex> lock(Lock);
+	Done.wait(lock, [&] { return Busy == 0; });
+}
+
+// The block for ADC frame Frame.  It was normally made while the last block was being dispatched; if the
+// frame or the amplitude isn't what was guessed (a dropped buffer) it is made now.  Then the next frame
+// is started.  The block is [radar][NumWRIperBlock*NumSampPerWRI] and stays valid until the next call.
+const RTPComplex *SimStage::next(int Frame, double SimAmpdB)
+{
+	float SimAmpLin;
+	if (gRadarState.SimAmp <= 0.0f)
+		SimAmpLin = (float)pow(10.0, (double)SimAmpdB / 20.0);
+	else
+		SimAmpLin = 1.0f;
+
+	if ((NumThreads > 0) && Threads.empty()) startThreads();
+	wait();
+	if (!Ahead || (JobFrame != Frame) || (JobAmp != SimAmpLin)) {
+		launch(Frame, SimAmpLin);
+		wait();
+	}
+	std::swap(Front, Back);
+	launch(Frame + 1, SimAmpLin);
+	Ahead = true;
+	return Front.data();
+}
+
+void SimStage::cleanup()
+{
+	wait();
+	{
+		std::unique_lock<std::mutex> lock(Lock);
+		Stop = true;
+	}
+	Go.notify_all();
+	for (auto &t : Threads) t.join();
+	Threads.clear();
+}
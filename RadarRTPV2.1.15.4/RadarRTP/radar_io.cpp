@@ -9,6 +9,7 @@ Feb 2018 Added code so that it works on Linux
 Mar 2018 Corrected recording of processed data (along with fixes in the processing chain- see process.cpp)
 Mar 2018 Moved load_windows here
 Mar 2018 Put in flag to avoid thrashing when opening the recording files fail.
+Oct 2026 In virtual time the files are named from the data time. Golden file check of the processed data.
 
 RadarRTP - Radar Real time Program (RTP)
 
@@ -29,6 +30,9 @@ See the GNU General Public License for more details, supplied with this source a
 #include "stdafx.h"
 #include "RadarRTP.h"
 #include "radarc.h"
+#include "tracker.h"
+#include "fusion.h"
+#include "precession.h"
 #ifdef _WIN32
 #include <tchar.h>
 #include <strsafe.h>
@@ -42,6 +46,7 @@ std::mutex raw_file_lock;
 std::mutex proc_file_lock;
 bool __fopenRawFail = 0;	// Don't keep thrashing the file system if unable to open files for recording
 bool __fopenProcFail = 0;
+std::vector<std::string> ProcFileNames;	// Processed data files opened this run, in order, for the golden file check
 
 // These are to write debug info to a file
 FILE * fpDebugFile;
@@ -55,7 +60,7 @@ int open_proc_data_file()
 		close_proc_file();
 	} 
 
-	std::time_t currtime = std::time(nullptr);
+	std::time_t currtime = dataFileTime();
 	std::tm timestruc;
 #ifdef _WIN32
 //#ifdef __STDC_LIB_EXT1__
@@ -84,13 +89,14 @@ int open_proc_data_file()
 	else
 	{
 		__fopenProcFail = FALSE;
+		ProcFileNames.push_back(fname);
 	}
 
 	std::strftime(msg, sizeof(msg), "%Y,%m,%d,%H:%M:%S", &timestruc);
 	fprintf(filedat, "%s,%d,%d,%d,%d,%d\n",msg,gRadarState.NumSensorsSet, gRadarConfig.NSamplesPerWRI, 
 		gRadarConfig.NWRIPerCPI, gRadarConfig.NWRIPerBlock, (const int) gRadarConfig.SampleRate);
 
-	time(&tfiledat);
+	tfiledat = currtime;
 	gRadarState.DataRecording=TRUE;
 	
 	return(0);
@@ -108,7 +114,7 @@ int open_raw_data_file()
 		log_message("Close recording file");
 		close_raw_file();
 	}
-	std::time_t currtime = std::time(nullptr);
+	std::time_t currtime = dataFileTime();
 	std::tm timestruc;
 #ifdef _WIN32
 	//#ifdef __STDC_LIB_EXT1__
@@ -146,7 +152,7 @@ int open_raw_data_file()
 	sf_set_string(fileraw, SF_STR_SOFTWARE, "RadarRTP");
 	sf_set_string(fileraw, SF_STR_COPYRIGHT, "Data is not copyrighted.");
 
-	time(&tfileraw);
+	tfileraw = currtime;
 	raw_file_lock.unlock();
 
 	gRadarState.RawRecording = TRUE;
@@ -268,7 +274,7 @@ int save_raw_data( const float * pData, int num_samps)
 	}
 
 	raw_file_lock.unlock();
-	time(&now);
+	now = dataFileTime();
 	seconds_open = difftime(now,tfileraw);
 	if (seconds_open>(gRadarConfig.MaxRawFileTime)){
 		close_raw_file();
@@ -305,16 +311,33 @@ int save_processed_data(void)
 	for(int radar=0;radar<gRadarConfig.NumRadars;radar++){ 
 		fprintf(filedat, ",%8.5lf,%8.4lf \n",gProcessedData.peakDoppler[radar],gProcessedData.peakAmplitude[radar]); 
 	}
+	// Calibration snapshot version used by each radar: C,block,version,...
+	fprintf(filedat, "C,%d", gProcessedData.Params.block_id);
+	for (int radar = 0; radar < gRadarConfig.NumRadars; radar++)
+		fprintf(filedat, ",%lu", gProcessedData.CalVersion[radar]);
+	fprintf(filedat, "\n");
+	// CFAR detections, one line per radar: D,block,radar,count,then range bin,Doppler bin,amplitude,SNR for each
+	if (gRadarConfig.CFARType != CFAROff) {
+		for (int radar = 0; radar < gRadarConfig.NumRadars; radar++) {
+			DetectionList &dets = gProcessedData.Detections[radar];
+			fprintf(filedat, "D,%d,%d,%d", gProcessedData.Params.block_id, radar, dets.NumDetections);
+			for (int i = 0; i < dets.NumDetections; i++)
+				fprintf(filedat, ",%d,%d,%8.4f,%6.2f", dets.Det[i].RangeIndex, dets.Det[i].DopplerIndex,
+					dets.Det[i].Amplitude, dets.Det[i].SNR);
+			fprintf(filedat, "\n");
+		}
+	}
 	fflush(filedat);
 	proc_file_lock.unlock();
 
-	// Check for length of time file has been open
+	// Check for length of time file has been open.  Not in virtual time: the gather thread can be blocks
+	// behind the block time, so where the file would roll over changes from run to run.
 	time_t now;
 	double seconds_open;
 
-	time(&now);
+	now = dataFileTime();
 	seconds_open = difftime(now, tfiledat);
-	if (seconds_open>(gRadarConfig.MaxProcFileTime)) {
+	if (!gRadarConfig.VirtualTime && (seconds_open>(gRadarConfig.MaxProcFileTime))) {
 		close_proc_file();
 		open_proc_data_file();
 	}
@@ -323,6 +346,111 @@ int save_processed_data(void)
 }
 
 
+static bool read_whole_file(const std::string &Name, std::string &Data)
+{
+	FILE *fp = fopen(Name.c_str(), "rb");
+	if (fp == NULL) return false;
+	char buff[4096];
+	size_t n;
+	while ((n = fread(buff, 1, sizeof(buff), fp)) > 0) Data.append(buff, n);
+	fclose(fp);
+	return true;
+}
+
+// For regression runs in virtual time.  Compares the processed data with GoldenFile, byte for byte.  Turning
+// the recording off and on again starts a new file, so every file of the run is compared, one after the other.
+// If there is no golden file yet, this run's files are copied to make one.  Returns 0 if they match (or the
+// golden file was made), 1 otherwise.
+int check_golden_file(void)
+{
+	if (gRadarConfig.GoldenFile.empty()) return(0);
+	close_all_open_files();
+	if (ProcFileNames.empty()) {
+		log_message("Warning: No processed data was recorded to compare with golden file '%s'", gRadarConfig.GoldenFile.c_str());
+		return(1);
+	}
+	std::string Out, Gold;
+	for (const std::string &Name : ProcFileNames)
+		if (!read_whole_file(Name, Out)) {
+			log_message("Warning: Unable to read processed data file '%s' for the golden file check", Name.c_str());
+			return(1);
+		}
+	if (!read_whole_file(gRadarConfig.GoldenFile, Gold)) {
+		FILE *fpGold = fopen(gRadarConfig.GoldenFile.c_str(), "wb");
+		if ((fpGold == NULL) || (fwrite(Out.data(), 1, Out.size(), fpGold) != Out.size())) {
+			log_message("Warning: Unable to create golden file '%s'", gRadarConfig.GoldenFile.c_str());
+			if (fpGold != NULL) fclose(fpGold);
+			return(1);
+		}
+		fclose(fpGold);
+		log_message("Golden file '%s' made from %d processed data files starting with '%s'", gRadarConfig.GoldenFile.c_str(),
+			(int)ProcFileNames.size(), ProcFileNames[0].c_str());
+		return(0);
+	}
+	size_t bytes = 0;
+	long line = 1;
+	while ((bytes < Out.size()) && (bytes < Gold.size()) && (Out[bytes] == Gold[bytes])) {
+		if (Out[bytes] == '\n') line++;
+		bytes++;
+	}
+	if ((bytes < Out.size()) || (bytes < Gold.size())) {
+		log_message("Error: Processed data (%d files starting with '%s') differs from golden file '%s' at line %ld",
+			(int)ProcFileNames.size(), ProcFileNames[0].c_str(), gRadarConfig.GoldenFile.c_str(), line);
+		return(1);
+	}
+	log_message("Processed data matches golden file '%s', %ld bytes in %d files", gRadarConfig.GoldenFile.c_str(),
+		(long)bytes, (int)ProcFileNames.size());
+	return(0);
+}
+
+
+// Called by the tracker thread after each update. Writes one line per track to the processed data file:
+// T,block,track ID,radar,status(1 tentative 2 confirmed),range bin,range rate,Doppler bin,Doppler rate,speed,amplitude,hits,age
+// The file is opened and closed by the gather thread, so nothing is written if it isn't open.
+int save_track_data(CPI_Params Params, const TrackReport *Reports, int NumReports)
+{
+	proc_file_lock.lock();
+	if (filedat == NULL) {
+		proc_file_lock.unlock();
+		return(-1);
+	}
+	for (int i = 0; i < NumReports; i++) {
+		const TrackReport &Rep = Reports[i];
+		fprintf(filedat, "T,%d,%u,%d,%d,%8.3f,%8.3f,%8.3f,%8.3f,%8.5f,%8.4f,%d,%d\n", Params.block_id, Rep.ID, Rep.RadarChan,
+			(int)Rep.Status, Rep.Range, Rep.RangeRate, Rep.Doppler, Rep.DopplerRate, Rep.Speed, Rep.Amplitude, Rep.Hits, Rep.Age);
+	}
+	fflush(filedat);
+	proc_file_lock.unlock();
+	return(0);
+}
+
+int save_fusion_data(const FusionReport &Rep)
+{
+	proc_file_lock.lock();
+	if (filedat == NULL) {
+		proc_file_lock.unlock();
+		return(-1);
+	}
+	fprintf(filedat, "F,%u,%.6f,%8.4f,%8.4f,%8.4f,%8.4f,%8.4f,%8.4f,%8.3f,%8.3f,%d\n", Rep.BlockID, Rep.Time, Rep.X, Rep.Y,
+		Rep.VX, Rep.VY, Rep.SigX, Rep.SigY, Rep.AxisAngle, Rep.PrecessionRate, Rep.RadarsUsed);
+	fflush(filedat);
+	proc_file_lock.unlock();
+	return(0);
+}
+
+int save_precession_data(const PrecessionReport &Rep)
+{
+	proc_file_lock.lock();
+	if (filedat == NULL) {
+		proc_file_lock.unlock();
+		return(-1);
+	}
+	fprintf(filedat, "P,%u,%.6f,%8.3f,%9.4f,%9.4f,%lu\n", Rep.BlockID, Rep.Time, Rep.AxisAngle, Rep.Rate, Rep.Rate95, Rep.Swings);
+	fflush(filedat);
+	proc_file_lock.unlock();
+	return(0);
+}
+
 bool toggle_raw_recording()
 {
 	if (gRadarState.RawRecording) {
@@ -46,6 +46,7 @@ See the GNU General Public License for more details, supplied with this source a
 #include <ratio>
 #include <atomic>
 #include <complex>
+#include <deque>
 #include "CPIParameters.h" // CPIParams definition
 #include "sensordata.h"  // Class definition for radar data
 
@@ -64,6 +65,8 @@ extern "C" {
 #endif
 }
 //#include <sndfile.h>
+#include "cfar.h"	// Detection lists and CFAR detector
+#include "peakRefine.h"	// Sub-bin peak location
 
 #include <iostream>
 
@@ -86,6 +89,9 @@ extern "C" {
 using DataTOV = std::chrono::system_clock::time_point ;
 
 using RTPComplex = std::complex<float>;
+#include "mti.h"	// Clutter cancellation
+#include "matchedFilter.h"	// Long sweep pulse compression
+#include "scenario.h"	// Scene for the radar simulation
 
 #ifndef		TWOPI
 #define		TWOPI		2.0 * 3.14159265358979323846264338
@@ -114,6 +120,7 @@ using RTPComplex = std::complex<float>;
 #define NUMOUTCHAN (2) /* Number of output channels driving the radar - only 2 channels are supported, no less, no more and no error checking */
 #define NBYTES_PER_PIXEL (4) /* Number of bytes in a pixel for the image array */
 #define MaxThreads 64
+#define MaxBatchCPIs 16	/* Most CPIs a worker can be given at once */
 
 /* Global declarations */
 
@@ -125,10 +132,31 @@ extern time_t tfiledat;	// Time data file opened.
 extern SNDFILE * fileraw ; /* I'm using soundfiles to record raw data since I had that library */
 extern time_t tfileraw;
 
+// Transmit waveform for the DAC, one block (all output channels interleaved).  There are two tables: the
+// audio callback copies from the live one while update_waveform() fills the other, and publish() swaps
+// them between callbacks.  So a change made while running never reaches the DAC half written.
+typedef struct WaveTable {
+	unsigned int Len = 0;				// Floats in each table
+	std::atomic<unsigned long> Version;	// Count of tables published
+
+	int initialize(unsigned int LenIn);
+	float *beginWrite();				// Spare table, once the callback is done with it. Holds the writer lock.
+	void publish();						// Spare table becomes live, and the writer lock is released
+	const float *beginRead();			// Audio callback: table to copy from
+	void endRead();
+	void cleanup();
+private:
+	float *Tables[2] = { NULL, NULL };
+	std::atomic<int> Live;				// Index of the live table
+	std::atomic<const float *> Reading;	// Table the callback is copying from, NULL between callbacks
+	std::mutex Writer;
+} WaveTable;
+
 /* Global variables */
-extern float * WaveData;  // Waveform data.  Memory allocated elsewhere, this is the pointer to the data
+extern WaveTable gWaveTable;  // Transmit waveform, see waveform.cpp
 extern RTPComplex *  WaveformReplica ;
 extern RTPComplex *  DownConvertWF;
+extern RTPComplex *  LongSweepReplica;
 
 // The following are for the ring buffer between the ADC data input thread and the radar processing dispatch thread
 extern float *Buff_Data[NBUFF];						// storage for ringbuffer data
@@ -160,8 +188,11 @@ void buff_destroy(void);  /* close buffers.  */
 /* The following will block until a full data buffer block is available */
 /* It will return the index to the data block that is next to be read/processed */
 int buff_Wait_For_Data(void);  /* Return index to oldest data buffer.  Block if no data is available. */
+int buff_depth(void);  /* Blocks waiting to be processed */
+bool buff_Wait_For_Space(void);  /* Block until a buffer is free (virtual time, where no block may be dropped) */
 
 int create_waveform(void);
+int update_waveform(void);	// Regenerate the transmit table after TransmitModAmp, TransmitModOn or TransmitLongSweep change
 
 // The following are in radar_io.cpp module
 int open_proc_data_file(void);
@@ -171,6 +202,10 @@ int close_raw_file(void);
 void close_all_open_files(void);
 int save_raw_data(const float * pData, int num_samps);
 int save_processed_data(void);
+int check_golden_file(void);	// Compare the processed data of a virtual time run with GoldenFile
+int save_track_data(CPI_Params Params, const struct TrackReport *Reports, int NumReports);
+int save_fusion_data(const struct FusionReport &Report);
+int save_precession_data(const struct PrecessionReport &Report);
 bool toggle_raw_recording();
 bool toggle_proc_recording();
 void start_raw_recording();
@@ -195,6 +230,132 @@ void dBClose();
 int clock_to_char(char* timestring, const int length, DataTOV TOV);
 int clock_to_char_long(char* timestring, const int length, DataTOV TOV);
 DataTOV duration_to_systime(DataTics duration, DataTOV &time_pt);
+std::time_t dataFileTime(void);	// Time for naming the recording files, from the block count in virtual time
+
+// In threads.cpp
+// Each pipeline thread has a role, which gives its name, CPUs and priority from the [threads] section
+enum ThreadRole {
+	ThreadCallback = 0,	// ADC callback (PortAudio, or the simulated ADC)
+	ThreadDispatcher,	// Process_data
+	ThreadWorker,		// Signal processing workers, one CPU each from the list
+	ThreadGather,		// Output gather
+	ThreadCal,			// Background calibration
+	ThreadDisplay,		// Display formatting and the GUI
+	ThreadRecorder,		// Network publisher, tracker and fusion, which record and send on the results
+	ThreadSim,			// Target simulation, one CPU each from the list
+	NumThreadRoles
+};
+void setThreadRole(ThreadRole Role, int Index = 0);	// For the calling thread
+void setThreadRole(std::thread &Thread, ThreadRole Role, int Index = 0);
+const char *threadRoleKey(ThreadRole Role);
+int parseCPUList(const std::string &List, std::vector<int> &CPUs);
+std::string cpuListText(const std::vector<int> &CPUs);
+
+// NUMA placement.  Each radar's CPIs go to the workers of one node, which allocate and first touch their
+// own buffers there (or bind them with _RTP_NUMA).  With NumaOn off there is one node and every worker
+// takes its turn, as before.
+typedef struct NumaLayout {
+	int NumNodes = 1;
+	std::vector<int> NodeID;				// OS node number of each node
+	std::vector<std::vector<int>> NodeCPUs;	// Empty for the one node when NumaOn is off
+	std::vector<int> WorkerNode;			// Node of each worker
+	std::vector<int> RadarNode;				// Node whose workers process each radar
+	std::vector<std::vector<int>> NodeWorkers;	// Workers of each node, in the order they take CPIs
+	std::atomic<unsigned long long> LocalBytes{ 0 }, RemoteBytes{ 0 };	// Copied between the dispatcher, workers and gather
+	std::atomic<unsigned long> RemoteCPIs{ 0 };		// CPIs handed to a worker on another node than the dispatcher
+	int initialize(int NumWorkers, int NumRadars);
+	int cpuNode(int cpu) const;				// -1 if the CPU isn't on any node
+	int currentNode() const;				// Node of the CPU the calling thread is on
+	std::vector<int> workerCPUs(int Worker, const std::vector<int> &List) const;
+	void countCopy(int FromNode, int ToNode, size_t Bytes);
+	void place(void *p, size_t Bytes, int Node) const;	// Bind (_RTP_NUMA) and first touch
+	void report() const;
+} NumaLayout;
+extern NumaLayout gNuma;	// In globals.cpp
+
+// The worker for each CPI.  The dispatcher steps through the workers of each node in turn.
+typedef struct WorkerRoute {
+	std::vector<int> Next;		// Next worker of each node's list
+	int next(int rindex);
+} WorkerRoute;
+
+// In arena.cpp
+// The pipeline buffers are all taken from one block, reserved by start_radar on huge pages if it can be
+enum ArenaKind {
+	ArenaNone = 0,
+	ArenaHugePages,			// MAP_HUGETLB, or large pages on Windows
+	ArenaTransparentPages,	// Normal allocation, with MADV_HUGEPAGE
+	ArenaNormalPages
+};
+typedef struct ArenaPart {
+	const char *Name;
+	size_t Bytes;			// Of each buffer
+	size_t Count;
+} ArenaPart;
+typedef struct BufferArena {
+	static const size_t AlignBytes = 64;			// A cache line, and an AVX-512 vector
+	static const size_t HugePageBytes = 2 << 20;
+	char *Base = NULL;
+	size_t Size = 0;
+	size_t Used = 0;
+	size_t Grain = AlignBytes;		// Buffers this big start on this boundary.  A huge page with NumaOn.
+	ArenaKind Kind = ArenaNone;
+	std::vector<ArenaPart> Parts;	// What the block is for
+	std::mutex Lock;
+	void plan(const CPI_Params &Params);
+	size_t boundary(size_t Bytes) const;
+	int reserve(const CPI_Params &Params);		// Exits if there isn't the memory
+	void *take(size_t Bytes, const char *Name);	// Exits if the buffer wasn't planned for
+	void release();
+} BufferArena;
+extern BufferArena gArena;	// In globals.cpp
+
+// In overload.cpp
+// When the processing can't keep up the dispatcher sheds work a step at a time, and takes the steps back
+// in the reverse order once it has caught up.  The data that is processed is never changed by a step.
+enum OverloadStep {
+	OverloadNone = 0,
+	OverloadOverlap,		// CPIs from every Stride'th block only, so they overlap less
+	OverloadDisplay,		// And only some of the frames are formatted for display
+	OverloadCal,			// And the calibration is given only some of the blocks
+	OverloadDrop,			// And the CPIs of a block are dropped while the load is high
+	NumOverloadSteps
+};
+typedef struct OverloadControl {
+	bool On = FALSE;
+	std::atomic<int> Step{ OverloadNone };
+	int Stride = 1;				// Blocks between the blocks whose CPIs are processed
+	int MaxStride = 1;			// A CPI's worth of blocks, where they no longer overlap
+	int CPIBlocks = 1;			// Blocks in a CPI
+	int NumRadars = 1;
+	double BlockTime = 1.0;		// Seconds of data in a block
+	int LastFrame = -1;			// ADC frame count of the last block
+	int Refill = 0;				// Blocks still to come before the CPI is clear of a gap
+	int SinceCPI = 0;			// Blocks since CPIs were last dispatched
+	int HighBlocks = 0, LowBlocks = 0;	// Blocks in a row over the high, or under the low, water mark
+	double Load = 0.0, PeakLoad = 0.0;
+	unsigned long Frames = 0;	// Frames the gather thread has finished
+	// Counts, logged as they change and reported when the processing stops
+	std::atomic<unsigned long> BlocksLost{ 0 };		// In ring buffer over-runs
+	std::atomic<unsigned long> CPIsSkipped{ 0 };	// Not made, with the CPI overlap reduced
+	std::atomic<unsigned long> CPIsDropped{ 0 };	// Dropped at the last step
+	std::atomic<unsigned long> CPIsGap{ 0 };		// Not made, as they would span lost blocks
+	std::atomic<unsigned long> FramesNotShown{ 0 };
+	std::atomic<unsigned long> CalBlocksSkipped{ 0 };
+	unsigned long StepsUp = 0, StepsDown = 0;
+	int HighestStep = OverloadNone;
+	void initialize(const CPI_Params &Params, bool LongSweep);
+	int lostBlocks(int Frame);					// Dispatcher, for each block.  Blocks lost before it.
+	bool dispatch(int RingDepth, double WorkerWait);	// Dispatcher, for each block.  Whether its CPIs are made.
+	bool calBlock(unsigned int n);				// Whether the n'th block (or cal run) goes to the calibration
+	bool showFrame();							// Gather thread, for each frame
+	void report() const;
+private:
+	bool stepUp();			// False when there is nothing more to shed
+	bool stepDown();		// Or to take back
+	std::string stepText() const;
+} OverloadControl;
+extern OverloadControl gOverload;	// In globals.cpp
 
 // In processMaster.cpp
 int startProcessingThread( void );
@@ -207,6 +368,7 @@ int Process_data(void);
 
 // In processWorkers.cpp
 void hamming(float *, int);
+unsigned int fftwPlanFlags(void);	// FFTW_MEASURE, or FFTW_ESTIMATE in virtual time so the plans don't vary
 
 // in consoleMonitor.cpp
 int ConsoleKeyMonitor(std::atomic<bool> &exitflag);
@@ -238,15 +400,65 @@ typedef struct PendSimParms {
 	std::vector<double> PendFreq;
 	double 	phaseinc=0.01;
 	double	pendfreqinc=0.01;
+	std::vector<double> RadarZv;
+	int NumTargets = 1;
+	std::vector<SimTarget> Targets;		// From the scenario, or SimNumTargets pendulums spread through the swing
+	std::vector<SimScatterer> Clutter;	// Stationary scatterers from the scenario
+	bool Multipath = false;
+	double GroundZ = -1.0;
+	double MultipathCoef = -0.7;
+	std::vector<std::vector<RTPComplex>> ClutterWRI;	// Return of the clutter over one WRI, per radar, at unit amplitude
+	std::vector<int> ClutterCW;			// Whether ClutterWRI was made for CW (1) or the sweep (0), -1 not made
 // Member functions
 	int RadarSimInit();
-	void simTargetData(PaTime simTimeStart, sensordata< RTPComplex> *SimData, double SimAmpdB);
+	void simRadarBlock(PaTime simTimeStart, int rindex, RTPComplex *Out, float SimAmpLin, int Group = 0, int NumGroups = 1);
 	void pendDistances(double postime, std::vector<double> *distances);
-	void pendPosition(double postime, double pos[3]);
+	double pendDistance(double postime, int target, int rindex);
+	void pendPosition(double postime, double pos[3], int target = 0);
+	void targetPosition(double postime, double pos[3], int target);
+	int rayRanges(const double pos[3], int rindex, double Range[3], float Gain[3]) const;
+	void wriPhase(double R0, double R1, bool CW, double &A, double &p, double &q) const;
+	void makeClutterWRI(int rindex, bool CW);
 
 } PendSimParms;
+
+// Makes the simulated returns on their own threads, a block ahead of the dispatch thread.  The targets of
+// each radar are split into NumGroups groups, and each (radar, group) is a job; thread ID does every
+// NumThreads'th job.  The first group of a radar goes straight into the block and the others into
+// Partial, which the last thread to finish adds in, always in the same order.  With no threads the
+// block is made on the calling thread.
+typedef struct SimStage {
+	int initialize(PendSimParms *SimIn, int NumThreadsIn);
+	const RTPComplex *next(int Frame, double SimAmpdB);	// Returns for ADC frame Frame, [radar][samples in a block]
+	void cleanup();
+private:
+	void startThreads();
+	void run(int ID);
+	void launch(int Frame, float Amp);
+	void wait();
+	void makeJob(int job, PaTime t, float Amp);
+	void addGroups();
+	PendSimParms *Sim = NULL;
+	int NumThreads = 0;
+	int NumGroups = 1;
+	std::vector<RTPComplex> Partial;	// [radar][group 1..NumGroups-1][samples in a block]
+	unsigned int BlockLen = 0;
+	std::vector<RTPComplex> Front, Back;	// Block handed out, block being made
+	bool Ahead = false;					// Back holds (or will hold) frame JobFrame
+	int JobFrame = 0;
+	PaTime JobTime = 0.0;
+	float JobAmp = 0.0f;
+	std::vector<std::thread> Threads;
+	std::mutex Lock;
+	std::condition_variable Go, Done;
+	unsigned long Job = 0;				// Count of blocks started
+	int Busy = 0;						// Threads still working on the current block
+	bool Stop = false;
+} SimStage;
+void RadarLocations(int NumRadars, double RadarX[], double RadarY[]);
 void startSimADC();
 void stopSimADC(); 
+bool simRunDone();	// Virtual time run has processed all SimFrames blocks
 
 // The following are in sensorIO.cpp
 int startStreamADC();
@@ -260,15 +472,57 @@ int paWaveCallback(const void* inputBuffer, void* outputBuffer, unsigned long fr
 int start_radar();
 int stop_radar();
 
+// In netPublish.cpp
+int startNetPublisher(CPI_Params Params);
+void stopNetPublisher();
+int NetPublishFrame(void);
+
+// In tracker.cpp
+int startTracker(CPI_Params Params);
+void stopTracker();
+int TrackerLoadFrame(void);
+
+// In fusion.cpp
+int startFusion(CPI_Params Params);
+void stopFusion();
+int FusionLoadFrame(void);
+
+// In precession.cpp
+int startPrecession(CPI_Params Params);
+void stopPrecession();
+int PrecessionLoadFrame(void);
+
 typedef struct floatdim4 {
 	float value[4] = { 0.0 };  // It is always of dim 4, so hard coding is OK
 } floatdim4;
 
 
+// One CPI of a worker's batch, and what the worker found in it
+typedef struct CPISlot {
+	int RadarChan = 0;
+	CPI_Params Params;
+	fftwf_complex *pData = NULL;		// In the worker's batch buffer, loaded by the dispatcher
+	float *pRDIPower = NULL;
+	const struct CalSnapshot *PinnedCal = NULL;
+	unsigned long CalVersion = 0;
+	int index_max_d = 0;
+	float index_frac_d = 0.0f;
+	int index_max_r = 0;
+	float index_frac_r = 0.0f;
+	float peakAmplitude = -2000.0f;
+	DetectionList Detections;
+} CPISlot;
+
+// A worker takes a batch of up to BatchCPIs CPIs at a time (one unless [system] BatchCPIs is set).  The
+// CPI being worked on is loaded into the fields below from its slot, and the results saved back.
 typedef struct Radar_Data_Flowing {
 	int MyID;						// ID of a specific processing thread.  Assigned by initializing thread. 
 	int RadarChan;					// Channel number of the radar data being passed here
 	CPI_Params Params;
+	std::vector<CPISlot> Slots;		// The batch, one after the other in a single buffer
+	int NumSlots = 0;				// CPIs in the batch.  Filled by the dispatcher.
+	int SlotsRead = 0;				// Of those, taken by the gather thread
+	std::vector<fftwf_plan> BatchPlans;	// 2-D FFTs of 2, 4, 8, ... CPIs at once (LFMRangeDoppler)
 
 	fftwf_complex *pData=NULL;			// Working data, being changed by worker thread.  Initialized by master thread before initiating processing
 	RTPComplex *pCData=NULL;
@@ -276,11 +530,15 @@ typedef struct Radar_Data_Flowing {
 	//RTPComplex *pCTargetLine; 
 	
 	fftwf_plan fftwfPlan;				// Creating fftwfPlan is not thread safe, so plan needs to be provided to thread.
+	DataType Mode = LFMRangeDoppler;	// Processing mode, Params.myType unless this worker can't do it
+	bool LongSweep = false;				// Rows are already range profiles from the long sweep matched filter
+	fftwf_plan RangePlan = NULL, RangeInvPlan = NULL, DopplerPlan = NULL;	// Batched 1-D FFTs for the other modes
+	fftwf_plan DopplerUpPlan = NULL, DopplerDownPlan = NULL;	// Doppler FFTs of the even and odd WRIs (UpDownLFM)
+	std::vector<RTPComplex> UpDownMap;	// Combined up/down map, Num_WRI/2 Doppler bins
 	float *pPRI_WGT=NULL, *pWRI_WGT=NULL;		// Pointers to window used to control sidelobes
 	bool DCOnly;					// Flag to say how to cal data
-	RTPComplex DCOffset;			// DC offset cal coefficients
-	RTPComplex *DCOffsetArr;		// Pointer to WRI level "DC offset" cal coefficient arrays [Samp_Per_WRI]
-	floatdim4 CalTransform;			// Gain and correlation cal constants between I/Q - after subtracting for DC offset
+	unsigned long CalVersion = 0;	// Version of the calibration snapshot (gCalPublished) used for this CPI
+	const struct CalSnapshot *PinnedCal = NULL;	// Snapshot acquired at dispatch (virtual time), NULL to take the latest
 
 	float *pRDIPower=NULL;				// Pointer to where the output RDI power is stored
 	int index_max_d=0;				// Index of maximimum in processed line
@@ -288,6 +546,9 @@ typedef struct Radar_Data_Flowing {
 	int index_max_r = 0;			// Index of peak in range
 	float index_frac_r = 0.0f;		// Fraction in range
 	float peakAmplitude = -2000.0f;		// Amplitude (power) value at the location of the peak
+	CFARData Cfar;					// CFAR detector state and work space for this thread
+	DetectionList Detections;		// CFAR detections in this CPI
+	PeakRefiner PeakInterp;			// Sub-bin peak estimator, calibrated for the windows in use
 	// C++11 constructs
 	std::condition_variable DataHere; // Data ready for processing
 	std::mutex OwnBuffers;			// Mutex for the data buffers
@@ -296,10 +557,26 @@ typedef struct Radar_Data_Flowing {
 	bool StopRequested=false;		// Tell thread to stop execution and return
 	int initialize(CPI_Params InitParams, float* win_cpi, float* win_wri);		// Initialization function
 	int calibrate();				// Calibration function
+	template <DataType M> void calibrateRows(const struct CalSnapshot *Cal);	// Calibration kernel for each mode
+	int compress();					// Range and Doppler processing for the mode
+	void compressBatch(int n);		// compress() of the first n slots
+	void useSlot(int s);			// Work on the CPI of slot s
+	void saveSlot(int s);			// Results of the current CPI to slot s
+	int pulseCompress();			// Matched filter and Doppler FFT (sonar)
+	int upDownCompress();			// Up and down sweep range-Doppler maps, combined
 	//Radar_Data_Flowing();			// Constructor
 	//~Radar_Data_Flowing();
 }  Radar_Data_Flowing, *pRadar_Data_Flowing;
 
+// The worker of each CPI, in the order the dispatcher handed them out.  The gather thread follows it.
+typedef struct CPIOrder {
+	std::deque<int> Workers;
+	std::mutex Lock;
+	std::condition_variable Added;
+	void push(int Worker);
+	int pop(const bool &StopRequest);	// -1 if asked to stop
+} CPIOrder;
+
 int StartWorkerThreads(pRadar_Data_Flowing  *pRadarDataArray,
 	std::thread  hWorkerThreads[],
 	int numThreads,
@@ -377,6 +654,21 @@ typedef struct RadarConfig {
 						// This block size determines the amount of overlap processing accomplished
 	int NumThreads=16;		// Number of worker threads to use for signal processing, minimum is NumRadars*2 (so ping-pong)
 						// Maximum number currently is MaxThreads = 64.
+	int BatchCPIs = 1;		// Most CPIs a worker takes at once, up to MaxBatchCPIs.  Batches fill while the ADC blocks queue up.
+	// Thread placement, [threads] section.  An empty CPU list leaves the thread to the OS, priority 0 is normal scheduling.
+	std::vector<int> ThreadCPUs[NumThreadRoles];	// CPUs for each role
+	int ThreadPriority[NumThreadRoles] = { 0 };	// SCHED_FIFO priority, 1-99, for each role
+	bool ReserveCPUs = FALSE;	// Keep threads of roles with no CPU list off the CPUs listed for the others
+	bool NumaOn = FALSE;		// Group the workers by NUMA node, with each radar's CPIs on one node
+	std::vector<std::vector<int>> NumaCPUs;	// CPUs of each node, [threads] NumaCPUs0, NumaCPUs1, ... Empty to find them.
+	bool HugePages = TRUE;		// Processing buffers on huge pages when the OS allows it, see arena.cpp
+	// Overload control, [overload] section, see overload.cpp.  Off in virtual time, where nothing is dropped.
+	bool OverloadOn = FALSE;
+	double OverloadHigh = 0.5;	// Load to shed work at: the ring buffer occupancy, or the time waiting for workers per block time
+	double OverloadLow = 0.125;	// Load to take it back at
+	int OverloadStepBlocks = 4;	// Blocks in a row over OverloadHigh for each step
+	int OverloadRecoverBlocks = 64;	// Blocks in a row under OverloadLow for each step back
+	int OverloadDecimate = 4;	// 1 in this many display frames and calibration blocks are used while shed
 
 	double MinRefLevel=10.0;	// Minimum level for the reference level.  The scroll bar will go from this level to this level plus 100dB
 	bool ASIOPriority=0; //ASIO interface, if true, then ASIO takes priority over default input
@@ -388,6 +680,17 @@ typedef struct RadarConfig {
 	double PendLatitude=34.5;
 	double ADCVariance=0.001;	// variance of ADC noise power
 	double RadarDistance=3.0;	// Radars distance from center of pendulum swing
+	int SimNumTargets = 1;		// Pendulums in the simulation, spread evenly through the swing
+	std::vector<double> SimTargetRCS;	// Return of each simulated pendulum relative to SimAmp, dB. The last value repeats.
+	int SimThreads = 2;			// Threads making the simulated returns ahead of the dispatch thread, 0 to make them on it
+	long long SimSeed = 0;		// Seed of the simulated ADC noise, so a run can be repeated. 0 for a new seed each run.
+	std::string SimScenario;	// Scenario file with the scene to simulate (see scenario.h), in place of the pendulums
+	// Virtual time: the simulated ADC runs as fast as the processing takes it, every time comes from the sample
+	// count and nothing is dropped, so two runs of a configuration give the same processed data file.
+	bool VirtualTime = FALSE;	// Needs SimADC
+	int SimFrames = 0;			// Blocks to simulate before stopping (virtual time), 0 to run until stopped
+	double VirtualEpoch = 1577836800.0;	// Time of the first sample in virtual time, s since 1970 (2020-01-01 UTC)
+	std::string GoldenFile;		// Processed data file the run must match, made from this run if it doesn't exist
 
 	double CalDCVal[2 * MaxRadars] = {0.0}; // Pointer to array of initial DC calibration values 
 	floatdim4 CalTransForm[MaxRadars] = {}; // Pointer to array of IQ transformation matrices
@@ -403,12 +706,68 @@ typedef struct RadarConfig {
 	bool DC_CalOnly=TRUE;		// True when only a single DC offset value is corrected per radar.  False if each range corrected seperately.
 	// The following are only partially implemented- need to deinterleave the ADC samples
 	bool ReceiveRealOnly=FALSE;		// Whether the input data is real only or IQ pairs
-	// And these require changing the processing flow in the worker threads
+	bool CalBenchmark = FALSE;		// Time the calibration statistics at start up
+	bool CalStreaming = TRUE;		// Update the calibration from every block, rather than a whole CPI now and then on the cal thread
+	std::string CalStateFile = "calstate.bin";	// Converged calibration saved here (in DataFileRoot) for a warm start. Empty to turn off.
+	double CalSaveInterval = 60.0;	// Seconds between saves of the calibration state, 0 saves only at stop
+	int CalSubBands = 0;			// IQ correction sub-bands along the WRI (range dependent cal only). 0 for one per radar.
+	// The sonar is pulse compressed with the replica in the worker threads (Radar_Data_Flowing::pulseCompress)
 	bool Sonar=FALSE ;			// Create transmit waveform and process as a sonar system
+	int ProcessingMode = LFMRangeDoppler;	// DataType of every CPI (CPI_Params::myType)
 	double SonarFreq=10e3 ;		// Center frequency of the sonar sweep (Default is 12kHz)
 	double SonarBandwidth=2e3 ; // Bandwidth of the audio chirp (default is 5kHz)
 	int RxADC_Chan = -1;
 	int TxADC_Chan = -1;
+
+	// Publishing of processed results to remote consumers (see netPublish.cpp)
+	bool NetPublish = FALSE;		// Send detections (and optionally RDI tiles) over the network
+	bool NetUseTCP = FALSE;			// Use a TCP stream instead of UDP datagrams
+	std::string NetHost = "127.0.0.1";	// Address of the consumer (IPv4)
+	int NetPort = 5700;				// Port of the consumer
+	bool NetSendRDI = FALSE;		// Also send the range-Doppler images as compressed tiles
+	int NetQueueDepth = 8;			// Frames that may wait to be sent before frames are dropped
+	int NetKeyFrameInterval = 50;	// Frames between RDI key frames (0 for only the first, TCP only)
+	double NetRDIQuantdB = 0.1;		// Quantization step of the RDI tiles in dB
+	bool NetSelfTest = FALSE;		// Run a loopback test of the publisher at start up
+
+	// CFAR detection in the worker threads (see cfar.cpp)
+	int CFARType = CFAROff;			// CFARMethod: off, CA, OS or GO
+	int CFARGuardRange = 2;			// Guard cells either side of the cell under test in range
+	int CFARTrainRange = 8;			// Training cells beyond the guard cells in range
+	int CFARGuardDoppler = 2;		// Guard cells in Doppler
+	int CFARTrainDoppler = 4;		// Training cells in Doppler
+	double CFARThresholddB = 13.0;	// Detection threshold above the noise estimate
+	double CFAROSRank = 0.75;		// Rank of the OS-CFAR noise estimate as a fraction of the training cells
+	int CFARMaxDetections = 16;		// Detections kept per radar per CPI (up to MaxDetections)
+
+	// Moving target indicator (see mti.cpp)
+	int MTIType = MTIOff;			// MTIMethod: off, 2 pulse, 3 pulse or recursive
+	double MTITimeConstant = 10.0;	// Clutter map time constant for the recursive MTI, seconds
+
+	// Multi-target tracker (see tracker.cpp). Units are range and Doppler bins
+	bool TrackerOn = FALSE;			// Run the tracker thread
+	int TrackMaxTracks = 256;		// Tracks kept at once over all radars (up to MaxTracks)
+	double TrackGate = 9.21;		// Association gate on the normalized distance squared (99% for 2 degrees of freedom)
+	double TrackRangeNoise = 0.5;	// Standard deviation of a detection's range in bins
+	double TrackDopplerNoise = 0.5;	// Standard deviation of a detection's Doppler in bins
+	double TrackRangeAccel = 5.0;	// Process noise, bins/s^2 in range
+	double TrackDopplerAccel = 5.0;	// Process noise, bins/s^2 in Doppler
+	int TrackConfirmHits = 3;		// Hits before a track is confirmed
+	int TrackMaxMisses = 5;			// Consecutive misses before a confirmed track is dropped
+	bool TrackRecordTentative = FALSE;	// Record tentative tracks as well as confirmed tracks
+	// Multi-radar fusion of the bob position
+	bool FusionOn = FALSE;			// Run the fusion thread
+	double FusionDopplerNoise = 0.02;	// Standard deviation of a radial speed measurement, m/s
+	double FusionRangeNoise = 0.3;	// Standard deviation of a range measurement, m
+	double FusionAccelNoise = 0.05;	// Process noise, m/s^2, for what the pendulum model leaves out
+	double FusionGate = 9.0;		// Gate on the normalized distance squared for using a radar's return
+	bool FusionUseRange = TRUE;		// Use range as well as Doppler when the radar is swept
+	double FusionPrecessionMemory = 1800.0;	// Time constant (s) of the fading memory precession rate fit, 0 for all data
+	// Precession estimate from the peak Doppler of each radar
+	bool PrecessionOn = FALSE;		// Estimate the precession rate
+	double PrecessionMinAmplitude = -200.0;	// Leave out CPIs where any radar's peak is below this, dB
+	double PrecessionMemory = 0.0;	// Time constant of the fit, hours. 0 weights all of the data equally
+	double PrecessionReportInterval = 600.0;	// Seconds between log messages with the estimate, 0 for none
 }  RadarConfig, *pRadarConfig;
 
 // The following are all the things that are normally changed as the program runs
@@ -442,6 +801,7 @@ typedef struct RadarState {
 	
 	bool AutoCalOn=TRUE;			// Whether auto calibration is enabled or not
 	int Current_block_id=0;	// Block counter - index of input data block being processed - maintained by processing thread
+	int Blocks_output=0;		// Blocks whose results have been gathered and recorded - maintained by the output thread
 	
 }  RadarState, *pRadarState;
 
@@ -460,6 +820,9 @@ typedef struct ProcessedRadarData {
 	int index_max_r[MaxRadars];			// Index of maximimum in processed line
 	float index_frac_d[MaxRadars];		// Fractional part of index to account for peak splitting
 	float index_frac_r[MaxRadars];		// Fractional part of index to account for peak splitting
+	DetectionList Detections[MaxRadars];	// CFAR detections for each radar
+	DataTics RadarTOVtt[MaxRadars];		// Time of validity of each radar's CPI
+	unsigned long CalVersion[MaxRadars];	// Calibration snapshot used for each radar's CPI
 //	DataTics Data_TOVtt;		// Time ticks for data validity
 	//int initialize();
 	//~ProcessedRadarData();
@@ -483,7 +846,7 @@ inline RadarConfig GetRadarConfig()
 }
 
 //_RTP_Thread_Type MagnetFunction(LPVOID lpParam);
-void OutputWorkerFunction(pRadar_Data_Flowing  pRadarData[], CPI_Params InitParams);
+void OutputWorkerFunction(pRadar_Data_Flowing  pRadarData[], CPI_Params InitParams, CPIOrder *Order);
 
 // In command.cpp
 
@@ -0,0 +1,156 @@
+// Reads the simulation scenario file, see scenario.h for the format.
+// The scene is read once, at start up, and the simulation works from its own copy of the targets.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "radarc.h"
+#include "INIReader.h"
+#include <random>
+#include <algorithm>
+
+// Space separated numbers
+static std::vector<double> readList(INIReader &reader, const std::string &section, const std::string &name)
+{
+	std::vector<double> values;
+	std::stringstream ss(reader.Get(section, name, ""));
+	double val;
+	while (ss >> val) values.push_back(val);
+	return values;
+}
+
+// Position at time t.  Before the first point the target waits there; after the last it either waits at
+// the last point or goes round again.
+void SimTarget::pathPosition(double t, double pos[3]) const
+{
+	const size_t n = PathT.size();
+	if (Loop && (n > 1) && (t > PathT[n - 1])) {
+		double span = PathT[n - 1] - PathT[0];
+		t = PathT[0] + fmod(t - PathT[0], span);
+	}
+	size_t i = std::upper_bound(PathT.begin(), PathT.end(), t) - PathT.begin();
+	if (i == 0 || i == n) {
+		i = (i == 0) ? 0 : n - 1;
+		pos[0] = PathX[i];
+		pos[1] = PathY[i];
+		pos[2] = PathZ[i];
+		return;
+	}
+	double f = (t - PathT[i - 1]) / (PathT[i] - PathT[i - 1]);
+	pos[0] = PathX[i - 1] + f * (PathX[i] - PathX[i - 1]);
+	pos[1] = PathY[i - 1] + f * (PathY[i] - PathY[i - 1]);
+	pos[2] = PathZ[i - 1] + f * (PathZ[i] - PathZ[i - 1]);
+}
+
+double SimScenario::radarNoisedB(int rindex, double Default) const
+{
+	if (NoisedB.empty()) return Default;
+	return NoisedB[MIN(rindex, (int)NoisedB.size() - 1)];
+}
+
+int SimScenario::load(const std::string &fname)
+{
+	INIReader reader(fname);
+	if (reader.ParseError() != 0) {
+		log_message("Error: Can't read the scenario file %s (line %d)", fname.c_str(), reader.ParseError());
+		return -1;
+	}
+	FileName = fname;
+	RadarX = readList(reader, "scene", "RadarX");
+	RadarY = readList(reader, "scene", "RadarY");
+	RadarZ = readList(reader, "scene", "RadarZ");
+	if (RadarX.size() != RadarY.size()) {
+		log_message("Error: Scenario %s has %d RadarX and %d RadarY values", fname.c_str(),
+			(int)RadarX.size(), (int)RadarY.size());
+		return -1;
+	}
+	RadarZ.resize(RadarX.size(), 0.0);
+	NoisedB = readList(reader, "scene", "NoisedB");
+	Multipath = reader.GetBoolean("scene", "Multipath", false);
+	GroundZ = reader.GetReal("scene", "GroundZ", -1.0);
+	MultipathCoef = reader.GetReal("scene", "MultipathCoef", -0.7);
+
+	Targets.clear();
+	int NumTargets = (int)reader.GetInteger("scene", "Targets", 0);
+	for (int target = 0; target < NumTargets; target++) {
+		std::string section = "target" + std::to_string(target);
+		SimTarget tgt;
+		std::string type = reader.Get(section, "Type", "pendulum");
+		tgt.Amp = (float)pow(10.0, reader.GetReal(section, "RCS", 0.0) / 20.0);
+		if (type == "pendulum") {
+			tgt.Type = SimTargetPendulum;
+			tgt.SwingPhase = reader.GetReal(section, "Phase", 0.0) * ((double)TWOPI) / 360.0;
+		}
+		else if (type == "path") {
+			tgt.Type = SimTargetPath;
+			tgt.Loop = reader.GetBoolean(section, "Loop", false);
+			std::stringstream pts(reader.Get(section, "Path", ""));
+			std::string pt;
+			while (std::getline(pts, pt, ',')) {
+				std::stringstream ss(pt);
+				double t, x, y, z;
+				if (!(ss >> t >> x >> y >> z)) {
+					log_message("Error: Scenario %s [%s] path point '%s' is not t x y z", fname.c_str(), section.c_str(), pt.c_str());
+					return -1;
+				}
+				if (!tgt.PathT.empty() && (t <= tgt.PathT.back())) {
+					log_message("Error: Scenario %s [%s] path times must increase", fname.c_str(), section.c_str());
+					return -1;
+				}
+				tgt.PathT.push_back(t);
+				tgt.PathX.push_back(x);
+				tgt.PathY.push_back(y);
+				tgt.PathZ.push_back(z);
+			}
+			if (tgt.PathT.empty()) {
+				log_message("Error: Scenario %s [%s] has no Path", fname.c_str(), section.c_str());
+				return -1;
+			}
+		}
+		else {
+			log_message("Error: Scenario %s [%s] Type %s is not pendulum or path", fname.c_str(), section.c_str(), type.c_str());
+			return -1;
+		}
+		Targets.push_back(tgt);
+	}
+
+	// Each patch is a set of scatterers spread over a disc.  The generator has a fixed seed, so the clutter
+	// is the same every run.  The power of the patch is shared equally between them.
+	Clutter.clear();
+	int NumPatches = (int)reader.GetInteger("scene", "Clutter", 0);
+	std::mt19937 gen(5489u);
+	for (int patch = 0; patch < NumPatches; patch++) {
+		std::string section = "clutter" + std::to_string(patch);
+		double X = reader.GetReal(section, "X", 0.0);
+		double Y = reader.GetReal(section, "Y", 0.0);
+		double Z = reader.GetReal(section, "Z", 0.0);
+		double Radius = reader.GetReal(section, "Radius", 0.0);
+		int Scatterers = MAX((int)reader.GetInteger(section, "Scatterers", 1), 1);
+		float Amp = (float)(pow(10.0, reader.GetReal(section, "RCS", 0.0) / 20.0) / sqrt((double)Scatterers));
+		for (int s = 0; s < Scatterers; s++) {
+			double r = Radius * sqrt((double)(gen() >> 8) / 16777216.0);
+			double a = ((double)TWOPI) * (double)(gen() >> 8) / 16777216.0;
+			Clutter.push_back({ X + r * cos(a), Y + r * sin(a), Z, Amp });
+		}
+	}
+
+	Loaded = true;
+	log_message("Scenario %s: %d targets, %d clutter scatterers in %d patches, multipath %s",
+		fname.c_str(), (int)Targets.size(), (int)Clutter.size(), NumPatches, Multipath ? "on" : "off");
+	return 0;
+}
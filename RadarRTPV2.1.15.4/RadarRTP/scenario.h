@@ -0,0 +1,88 @@
+#pragma once
+// Simulation scenario header file
+// A scenario file describes the scene for the radar simulation: where the radars are, the targets and
+// how they move, patches of stationary clutter, a ground plane for multipath and the noise of each radar.
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+#include <string>
+#include <vector>
+
+// The file is in the same ini format as radarconfig.ini, for example
+//
+//	[scene]
+//	RadarX = 1.8 0 -1.8			; m, one per radar.  Leave out to put them on the RadarDistance half circle
+//	RadarY = 0 1.8 0
+//	RadarZ = 0 0 0
+//	NoisedB = -40 -40 -34		; ADC noise of each radar, as ADCVariance.  The last value repeats.
+//	Multipath = true			; Add the bounce off the ground plane at GroundZ
+//	GroundZ = -1.0
+//	MultipathCoef = -0.7		; Reflection coefficient of the ground
+//	Targets = 2
+//	Clutter = 1
+//
+//	[target0]
+//	Type = pendulum				; The pendulum of the [target] section of radarconfig.ini
+//	RCS = 0						; dB relative to SimAmp
+//	Phase = 0					; deg, offset in the swing
+//
+//	[target1]
+//	Type = path
+//	RCS = -6
+//	Path = 0 -2 1 0, 10 2 1 0.5, 20 -2 1 0	; t x y z, ... in s and m.  Straight lines between the points.
+//	Loop = true					; Start over at the end, otherwise stay at the last point
+//
+//	[clutter0]
+//	X = 0						; Centre of the patch, m
+//	Y = 3
+//	Z = 0
+//	Radius = 0.5				; Scatterers are spread over a disc of this radius
+//	Scatterers = 20
+//	RCS = -10					; dB, the whole patch
+enum SimTargetType {
+	SimTargetPendulum = 0,		// Moves like the pendulum, positions are the bob centre
+	SimTargetPath				// Straight lines between the points of Path
+};
+
+typedef struct SimTarget {
+	SimTargetType Type = SimTargetPendulum;
+	float Amp = 1.0f;				// Return relative to the sim amplitude, from the RCS
+	double SwingPhase = 0.0;		// Pendulum: offset in the swing, rad
+	std::vector<double> PathT, PathX, PathY, PathZ;	// Path: times (s, increasing) and positions (m)
+	bool Loop = false;
+	void pathPosition(double t, double pos[3]) const;
+} SimTarget;
+
+typedef struct SimScatterer {
+	double X, Y, Z;
+	float Amp;
+} SimScatterer;
+
+typedef struct SimScenario {
+	bool Loaded = false;
+	std::string FileName;
+	std::vector<double> RadarX, RadarY, RadarZ;	// Empty to use the half circle
+	std::vector<double> NoisedB;				// Empty to use ADCVariance for every radar
+	bool Multipath = false;
+	double GroundZ = -1.0;
+	double MultipathCoef = -0.7;
+	std::vector<SimTarget> Targets;
+	std::vector<SimScatterer> Clutter;		// The clutter patches, as point scatterers
+	int load(const std::string &fname);		// 0 if the scene was read
+	double radarNoisedB(int rindex, double Default) const;
+} SimScenario;
+
+extern SimScenario gScenario;	// In globals.cpp, loaded by ReadConfiguration when SimScenario is set
@@ -46,6 +46,11 @@ int paWaveCallback(const void* inputBuffer, void* outputBuffer,
 {
 	int wr_ind;
 	int* fc = (int*)framecount;
+	static thread_local bool RoleSet = false;	// PortAudio may use a new thread after a restart
+	if (!RoleSet) {
+		setThreadRole(ThreadCallback);
+		RoleSet = true;
+	}
 	int test = (int)statusFlags & 255; //Portaudio only uses the first 5 bits
 	if (test != 0) {
 		if ((statusFlags & paInputUnderflow) ||(statusFlags & paInputOverflow))
@@ -57,8 +62,12 @@ int paWaveCallback(const void* inputBuffer, void* outputBuffer,
 				log_message("Warning, portaudio callback status = %d",test);
 	}
 	/* Copy waveform data into output buffer */
+	// PortAudio owns the output buffer, so this has to be a copy. It is from the live table, which
+	// update_waveform() won't touch until the next callback.
 	if (outputBuffer != NULL) {
-		memcpy(outputBuffer, WaveData, framesPerBuffer * sizeof(float) * NUMOUTCHAN);
+		const float *Table = gWaveTable.beginRead();
+		memcpy(outputBuffer, Table, MIN(framesPerBuffer * NUMOUTCHAN, gWaveTable.Len) * sizeof(float));
+		gWaveTable.endRead();
 	}
 
 	if (inputBuffer != NULL)  /* Process the input data */
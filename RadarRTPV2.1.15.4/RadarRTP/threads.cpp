@@ -0,0 +1,341 @@
+// Placement of the pipeline threads: name, CPUs and scheduling priority of each thread role, and the
+// NUMA node of the workers and their buffers.
+// Each thread calls setThreadRole() for itself when it starts (the GUI thread is set up by main), using
+// the [threads] section of radarconfig.ini:
+//
+//	[threads]
+//	CPUCallback = 1			; CPU list like 2,4-7.  Leave out to let the OS place the thread.
+//	CPUDispatcher = 2
+//	CPUWorkers = 4-11		; The workers (and Sim threads) each get one CPU of the list, in turn
+//	PriorityCallback = 80	; SCHED_FIFO priority 1-99, 0 (the default) for normal scheduling
+//	PriorityDispatcher = 70
+//	ReserveCPUs = true		; Keep the threads with no CPU list off the CPUs listed for the others
+//	NumaOn = true			; Workers grouped by NUMA node, each radar's CPIs on one node
+//	NumaCPUs0 = 0-15		; CPUs of each node, if the OS doesn't give them
+//	NumaCPUs1 = 16-31
+//
+// The OS can't be told from here to keep its own work off those CPUs (isolcpus or a cpuset does that),
+// but ReserveCPUs keeps the GUI and the rest of this program off them.  A real-time priority needs
+// CAP_SYS_NICE or an rtprio limit; without it the thread runs with normal scheduling and a warning is
+// logged once for the role.  On Windows there are no thread names, and a priority above 0 is
+// THREAD_PRIORITY_HIGHEST, above 50 THREAD_PRIORITY_TIME_CRITICAL.
+//
+// With NumaOn a worker runs on the CPUs of its node, and makes its buffers there.  The dispatcher copies
+// each CPI to the worker, so the data crosses nodes at most once, and not again as the worker does its
+// FFTs.  The bytes that cross are counted and logged when processing stops.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "radarc.h"
+#include <algorithm>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+#ifdef _RTP_NUMA
+#include <numa.h>
+#endif
+
+// Key in [threads] and thread name of each role
+static const char *RoleKey[NumThreadRoles] = { "Callback", "Dispatcher", "Workers", "Gather", "Cal", "Display", "Recorder", "Sim" };
+static const char *RoleName[NumThreadRoles] = { "callback", "dispatch", "worker", "gather", "cal", "display", "recorder", "sim" };
+static std::atomic<bool> PriorityWarned[NumThreadRoles];
+
+const char *threadRoleKey(ThreadRole Role)
+{
+	return RoleKey[Role];
+}
+
+// "2,4-7" to 2 4 5 6 7.  Returns -1 if the list can't be read.
+int parseCPUList(const std::string &List, std::vector<int> &CPUs)
+{
+	CPUs.clear();
+	std::stringstream ss(List);
+	std::string item;
+	while (std::getline(ss, item, ',')) {
+		int first, last;
+		char dash;
+		std::stringstream is(item);
+		if (!(is >> first)) {
+			if (item.find_first_not_of(" \t") == std::string::npos) continue;
+			return -1;
+		}
+		last = first;
+		if (is >> dash) {
+			if ((dash != '-') || !(is >> last)) return -1;
+		}
+		if ((first < 0) || (last < first)) return -1;
+		for (int cpu = first; cpu <= last; cpu++) CPUs.push_back(cpu);
+	}
+	return 0;
+}
+
+std::string cpuListText(const std::vector<int> &CPUs)
+{
+	std::ostringstream os;
+	for (size_t i = 0; i < CPUs.size(); i++) os << (i ? "," : "") << CPUs[i];
+	return os.str();
+}
+
+// The CPUs not listed for any role
+static std::vector<int> unreservedCPUs()
+{
+	std::vector<bool> Used(MAX(std::thread::hardware_concurrency(), 1u), false);
+	for (int role = 0; role < NumThreadRoles; role++)
+		for (int cpu : gRadarConfig.ThreadCPUs[role])
+			if (cpu < (int)Used.size()) Used[cpu] = true;
+	std::vector<int> CPUs;
+	for (int cpu = 0; cpu < (int)Used.size(); cpu++)
+		if (!Used[cpu]) CPUs.push_back(cpu);
+	return CPUs;
+}
+
+static void applyThreadRole(std::thread::native_handle_type Handle, ThreadRole Role, int Index)
+{
+	const bool Pool = (Role == ThreadWorker) || (Role == ThreadSim);	// One CPU each
+	const std::vector<int> &List = gRadarConfig.ThreadCPUs[Role];
+	std::vector<int> CPUs;
+	if (!List.empty()) {
+		if (Pool) CPUs.push_back(List[Index % List.size()]);
+		else CPUs = List;
+	}
+	else if (gRadarConfig.ReserveCPUs)
+		CPUs = unreservedCPUs();
+	if ((Role == ThreadWorker) && gRadarConfig.NumaOn && (Index < (int)gNuma.WorkerNode.size()) && !gNuma.NodeCPUs[0].empty())
+		CPUs = gNuma.workerCPUs(Index, List);
+	const int Priority = gRadarConfig.ThreadPriority[Role];
+
+	char Name[16];	// Linux limit, with the terminator
+	if (Pool) snprintf(Name, sizeof(Name), "rtp-%s%d", RoleName[Role], Index);
+	else snprintf(Name, sizeof(Name), "rtp-%s", RoleName[Role]);
+
+	bool Placed = false, RealTime = false;
+#ifdef _WIN32
+	if (!CPUs.empty()) {
+		DWORD_PTR Mask = 0;
+		for (int cpu : CPUs)
+			if (cpu < 8 * (int)sizeof(DWORD_PTR)) Mask |= ((DWORD_PTR)1) << cpu;
+		Placed = (SetThreadAffinityMask(Handle, Mask) != 0);
+		if (!Placed) log_message("Warning: Can't put the %s thread on CPUs %s, error %d", Name, cpuListText(CPUs).c_str(), (int)GetLastError());
+	}
+	if (Priority > 0) {
+		RealTime = (SetThreadPriority(Handle, (Priority > 50) ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST) != 0);
+		if (!RealTime && !PriorityWarned[Role].exchange(true))
+			log_message("Warning: Can't raise the priority of the %s threads, error %d", RoleName[Role], (int)GetLastError());
+	}
+#else
+	pthread_setname_np(Handle, Name);
+	if (!CPUs.empty()) {
+		cpu_set_t Set;
+		CPU_ZERO(&Set);
+		for (int cpu : CPUs)
+			if (cpu < CPU_SETSIZE) CPU_SET(cpu, &Set);
+		int err = pthread_setaffinity_np(Handle, sizeof(Set), &Set);
+		Placed = (err == 0);
+		if (!Placed) log_message("Warning: Can't put the %s thread on CPUs %s: %s", Name, cpuListText(CPUs).c_str(), strerror(err));
+	}
+	if (Priority > 0) {
+		sched_param Param;
+		Param.sched_priority = MIN(MAX(Priority, sched_get_priority_min(SCHED_FIFO)), sched_get_priority_max(SCHED_FIFO));
+		int err = pthread_setschedparam(Handle, SCHED_FIFO, &Param);
+		RealTime = (err == 0);
+		if (!RealTime && !PriorityWarned[Role].exchange(true))
+			log_message("Warning: No real-time priority for the %s threads (%s), using normal scheduling. It needs CAP_SYS_NICE or an rtprio limit.",
+				RoleName[Role], strerror(err));
+	}
+#endif
+	if (Placed || RealTime)
+		log_message("Thread %s: CPUs %s, priority %s", Name, Placed ? cpuListText(CPUs).c_str() : "any",
+			RealTime ? std::to_string(Priority).c_str() : "normal");
+}
+
+void setThreadRole(ThreadRole Role, int Index)
+{
+#ifdef _WIN32
+	applyThreadRole(GetCurrentThread(), Role, Index);
+#else
+	applyThreadRole(pthread_self(), Role, Index);
+#endif
+}
+
+void setThreadRole(std::thread &Thread, ThreadRole Role, int Index)
+{
+	applyThreadRole(Thread.native_handle(), Role, Index);
+}
+
+#ifndef _WIN32
+// A list like 0-3,8 from a file in /sys, empty if it can't be read
+static std::string readSysList(const char *fname)
+{
+	char line[4096] = "";
+	FILE *fp = fopen(fname, "r");
+	if (fp == NULL) return std::string();
+	if (fgets(line, sizeof(line), fp) == NULL) line[0] = 0;
+	fclose(fp);
+	std::string text(line);
+	text.erase(text.find_last_not_of(" \n\r\t") + 1);
+	return text;
+}
+#endif
+
+// The nodes come from NumaCPUs0, NumaCPUs1, ... if they are set, otherwise from the OS.  The radars are
+// dealt out to the nodes in turn (no more nodes are used than there are radars), and the workers are
+// split between the nodes in proportion to their radars, as contiguous IDs.
+int NumaLayout::initialize(int NumWorkers, int NumRadars)
+{
+	NodeID.clear();
+	NodeCPUs.clear();
+	if (gRadarConfig.NumaOn) {
+		if (!gRadarConfig.NumaCPUs.empty()) {
+			NodeCPUs = gRadarConfig.NumaCPUs;
+			for (int node = 0; node < (int)NodeCPUs.size(); node++) NodeID.push_back(node);
+		}
+		else {
+#ifdef _WIN32
+			ULONG HighestNode = 0;
+			GetNumaHighestNodeNumber(&HighestNode);
+			for (int node = 0; node <= (int)HighestNode; node++) {
+				ULONGLONG Mask = 0;
+				if (!GetNumaNodeProcessorMask((UCHAR)node, &Mask) || (Mask == 0)) continue;
+				std::vector<int> CPUs;
+				for (int cpu = 0; cpu < 64; cpu++)
+					if (Mask & (1ULL << cpu)) CPUs.push_back(cpu);
+				NodeID.push_back(node);
+				NodeCPUs.push_back(CPUs);
+			}
+#else
+			std::vector<int> Online, CPUs;
+			parseCPUList(readSysList("/sys/devices/system/node/online"), Online);
+			for (int node : Online) {
+				std::string fname = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+				if ((parseCPUList(readSysList(fname.c_str()), CPUs) != 0) || CPUs.empty()) continue;	// Memory only node
+				NodeID.push_back(node);
+				NodeCPUs.push_back(CPUs);
+			}
+#endif
+		}
+	}
+	NumNodes = MAX(MIN((int)NodeCPUs.size(), NumRadars), 1);
+	NodeID.resize(NumNodes, 0);
+	NodeCPUs.resize(NumNodes);
+
+	RadarNode.assign(NumRadars, 0);
+	std::vector<int> NodeRadars(NumNodes, 0);
+	for (int rindex = 0; rindex < NumRadars; rindex++) {
+		RadarNode[rindex] = rindex % NumNodes;
+		NodeRadars[RadarNode[rindex]]++;
+	}
+	NodeWorkers.assign(NumNodes, std::vector<int>());
+	WorkerNode.assign(NumWorkers, 0);
+	int worker = 0;
+	for (int node = 0; node < NumNodes; node++) {
+		int Count = (node == NumNodes - 1) ? NumWorkers - worker : NumWorkers * NodeRadars[node] / MAX(NumRadars, 1);
+		for (int i = 0; i < Count; i++, worker++) {
+			WorkerNode[worker] = node;
+			NodeWorkers[node].push_back(worker);
+		}
+	}
+	LocalBytes = 0;
+	RemoteBytes = 0;
+	RemoteCPIs = 0;
+	if (gRadarConfig.NumaOn) {
+		std::ostringstream msg;
+		msg << "NUMA placement on " << NumNodes << " node(s):";
+		for (int node = 0; node < NumNodes; node++) {
+			msg << "\n\tNode " << NodeID[node] << " CPUs " << cpuListText(NodeCPUs[node]) << ", workers "
+				<< NodeWorkers[node].front() << "-" << NodeWorkers[node].back() << ", radars";
+			for (int rindex = 0; rindex < NumRadars; rindex++)
+				if (RadarNode[rindex] == node) msg << " " << rindex;
+		}
+		log_message(msg.str());
+	}
+	return 0;
+}
+
+int NumaLayout::cpuNode(int cpu) const
+{
+	for (int node = 0; node < (int)NodeCPUs.size(); node++)
+		if (std::find(NodeCPUs[node].begin(), NodeCPUs[node].end(), cpu) != NodeCPUs[node].end()) return node;
+	return -1;
+}
+
+int NumaLayout::currentNode() const
+{
+	if (NumNodes == 1) return 0;
+#ifdef _WIN32
+	return cpuNode((int)GetCurrentProcessorNumber());
+#else
+	return cpuNode(sched_getcpu());
+#endif
+}
+
+// A worker on a NUMA node runs on that node's CPUs: one of them from CPUWorkers if the list has any on the
+// node, otherwise any of them.
+std::vector<int> NumaLayout::workerCPUs(int Worker, const std::vector<int> &List) const
+{
+	const int node = WorkerNode[Worker];
+	const std::vector<int> &Node = NodeCPUs[node];
+	std::vector<int> OnNode;
+	for (int cpu : List)
+		if (std::find(Node.begin(), Node.end(), cpu) != Node.end()) OnNode.push_back(cpu);
+	if (OnNode.empty()) return Node;
+	int Pos = (int)(std::find(NodeWorkers[node].begin(), NodeWorkers[node].end(), Worker) - NodeWorkers[node].begin());
+	return std::vector<int>(1, OnNode[Pos % OnNode.size()]);
+}
+
+void NumaLayout::countCopy(int FromNode, int ToNode, size_t Bytes)
+{
+	if ((FromNode == ToNode) || (FromNode < 0) || (ToNode < 0)) LocalBytes += Bytes;
+	else RemoteBytes += Bytes;
+}
+
+// Pages go to the node of the thread that first writes them, so the buffer is cleared here, by its owner.
+// With _RTP_NUMA it is bound to the node first, so it goes there whoever writes it first.
+void NumaLayout::place(void *p, size_t Bytes, int Node) const
+{
+#ifdef _RTP_NUMA
+	if (gRadarConfig.NumaOn && (Node >= 0) && (Node < NumNodes) && (numa_available() >= 0) && (NodeID[Node] <= numa_max_node())) {
+		uintptr_t Page = (uintptr_t)sysconf(_SC_PAGESIZE);
+		uintptr_t Start = (uintptr_t)p & ~(Page - 1);
+		numa_tonode_memory((void *)Start, Bytes + ((uintptr_t)p - Start), NodeID[Node]);
+	}
+#else
+	(void)Node;
+#endif
+	memset(p, 0, Bytes);
+}
+
+void NumaLayout::report() const
+{
+	if (NumNodes == 1) return;
+	unsigned long long Local = LocalBytes, Remote = RemoteBytes;
+	log_message("NUMA: %lu CPIs went to a worker on another node than the dispatcher. %.1f MB of CPI data crossed nodes, %.1f MB stayed on one (%.1f%% crossed)",
+		(unsigned long)RemoteCPIs, Remote / 1048576.0, Local / 1048576.0, 100.0 * Remote / MAX((double)(Local + Remote), 1.0));
+}
+
+int WorkerRoute::next(int rindex)
+{
+	const int node = gNuma.RadarNode[rindex];
+	if (Next.size() != gNuma.NodeWorkers.size()) Next.assign(gNuma.NodeWorkers.size(), 0);
+	const std::vector<int> &Workers = gNuma.NodeWorkers[node];
+	int worker = Workers[Next[node]];
+	Next[node] = (Next[node] + 1) % (int)Workers.size();
+	return worker;
+}
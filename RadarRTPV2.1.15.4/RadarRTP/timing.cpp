@@ -96,4 +96,14 @@ int clock_to_char_long(char* timestring, const int length, DataTOV msgTOV)
 DataTOV duration_to_systime(DataTics duration, DataTOV &time_pt)
 {
 	return (gStreamSysTimeRef + duration);
+}
+
+// Clock time used to name the recording files and to decide when to start new ones.  In virtual time it is
+// the time of the block being processed, so the files are named the same way on every run.
+std::time_t dataFileTime(void)
+{
+	if (!gRadarConfig.VirtualTime) return std::time(nullptr);
+	double BlockTime = ((double)gRadarConfig.NSamplesPerWRI * gRadarConfig.NWRIPerBlock) / gRadarConfig.SampleRate;
+	return std::chrono::system_clock::to_time_t(gStreamSysTimeRef + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+		std::chrono::duration<double>(BlockTime * gRadarState.Current_block_id)));
 }
\ No newline at end of file
@@ -0,0 +1,381 @@
+// Multi-target tracker
+// Tracks the detections from each radar in range-Doppler space.  Each track is a pair of constant
+// velocity Kalman filters, one on the range bin and one on the Doppler bin (which wraps around).
+// Detections are gated on the normalized innovation and then assigned to tracks with global nearest
+// neighbor (GNN) association, solved as a minimum cost assignment.  A detection that is not assigned
+// starts a tentative track, which is confirmed after enough hits.  Tracks are dropped after too many misses.
+//
+// The tracker runs on its own thread, fed by the output gather thread.  All storage is in a preallocated
+// track table so nothing is allocated while running.  If the tracker falls behind, the newest
+// detections replace the ones waiting and the overrun is counted.
+//
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+
+#include "stdafx.h"
+#include "radarc.h"
+#include "tracker.h"
+#include <thread>
+#include <chrono>
+
+#define TRACK_INIT_RATE_SIGMA 10.0	// Initial uncertainty of the rates in bins/s
+#define TRACK_BIG_COST 1e12			// Cost of pairing a detection with a track outside the gate
+
+static TrackerData Tracker;
+static std::thread TrackerThread;
+static bool TrackerRunning = FALSE;
+
+
+int TrackerData::initialize(CPI_Params InitParams)
+{
+	Params = InitParams;
+	WorkParams = InitParams;
+	for (int i = 0; i < MaxTracks; i++) Tracks[i] = TrackState();
+	InBufferFull = false;
+	Working = false;
+	StopRequested = false;
+	Overruns = 0;
+	NumActive = 0;
+	MaxActive = 0;
+	TracksStarted = 0;
+	TracksConfirmed = 0;
+	Updates = 0;
+	UpdateTimeTotal = 0.0;
+	FirstUpdate = true;
+	return 0;
+}
+
+// Copy a set of detections in for the tracker thread.  If the previous set hasn't been taken yet it is replaced,
+// except in virtual time where this waits until the tracker has finished with it.
+int TrackerData::loadDetections(CPI_Params CPIParams, const DetectionList Dets[])
+{
+	std::unique_lock<std::mutex> bufferlock(OwnBuffers);
+	if (InBufferFull) Overruns++;
+	Params = CPIParams;
+	for (unsigned int rindex = 0; rindex < CPIParams.NumSensorsSet; rindex++)
+		Detections[rindex] = Dets[rindex];
+	InBufferFull = true;
+	bufferlock.unlock();
+	DataHere.notify_one();
+	// In virtual time this CPI's track reports go into the data file before the next CPI's results, on every run
+	if (gRadarConfig.VirtualTime) {
+		bufferlock.lock();
+		while ((InBufferFull || Working) && !StopRequested)
+			DataHere.wait_for(bufferlock, std::chrono::milliseconds(1000));
+	}
+	return 0;
+}
+
+void TrackerData::TrackerFunction()
+{
+	setThreadRole(ThreadRecorder);
+	log_message("Tracker thread started.");
+	while (!StopRequested) {
+		std::unique_lock<std::mutex> bufferlock(OwnBuffers);
+		while (!InBufferFull && !StopRequested) {
+			DataHere.wait_for(bufferlock, std::chrono::milliseconds(1000));
+		}
+		if (StopRequested) break;
+		WorkParams = Params;
+		for (unsigned int rindex = 0; rindex < Params.NumSensorsSet; rindex++)
+			Work[rindex] = Detections[rindex];
+		InBufferFull = false;
+		Working = true;
+		bufferlock.unlock();
+
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		update();
+		UpdateTimeTotal += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		Updates++;
+		bufferlock.lock();
+		Working = false;
+		bufferlock.unlock();
+		DataHere.notify_all();
+	}
+	log_message("Tracker stopped. Updates %lu, average update %.3f ms, tracks started %lu, confirmed %lu, most at once %d, overruns %lu",
+		Updates, (Updates > 0) ? 1000.0*UpdateTimeTotal / Updates : 0.0, TracksStarted, TracksConfirmed, MaxActive, Overruns);
+}
+
+void TrackerData::predict(TrackState &Trk, double dt)
+{
+	TrackAxis *axes[2] = { &Trk.Range, &Trk.Doppler };
+	double accel[2] = { gRadarConfig.TrackRangeAccel, gRadarConfig.TrackDopplerAccel };
+	for (int k = 0; k < 2; k++) {
+		TrackAxis &Ax = *axes[k];
+		double q = accel[k] * accel[k];
+		Ax.Pos += dt * Ax.Vel;
+		Ax.P00 += 2.0*dt*Ax.P01 + dt * dt*Ax.P11 + q * dt*dt*dt / 3.0;
+		Ax.P01 += dt * Ax.P11 + q * dt*dt / 2.0;
+		Ax.P11 += q * dt;
+	}
+	double nd = (double)WorkParams.Num_WRI;
+	Trk.Doppler.Pos = fmod(Trk.Doppler.Pos, nd);
+	if (Trk.Doppler.Pos < 0.0) Trk.Doppler.Pos += nd;
+}
+
+// Kalman update of one axis with the innovation already computed (Meas is the innovation)
+void TrackerData::correct(TrackAxis &Ax, double Meas, double MeasVar)
+{
+	double S = Ax.P00 + MeasVar;
+	double K0 = Ax.P00 / S, K1 = Ax.P01 / S;
+	Ax.Pos += K0 * Meas;
+	Ax.Vel += K1 * Meas;
+	double P00 = Ax.P00, P01 = Ax.P01;
+	Ax.P00 = (1.0 - K0)*P00;
+	Ax.P01 = (1.0 - K0)*P01;
+	Ax.P11 -= K1 * P01;
+}
+
+void TrackerData::startTrack(int RadarChan, const RadarDetection &Det)
+{
+	if (NumActive >= MIN(gRadarConfig.TrackMaxTracks, MaxTracks)) return;
+	for (int i = 0; i < MaxTracks; i++) {
+		if (Tracks[i].Status != TrackFree) continue;
+		TrackState &Trk = Tracks[i];
+		Trk.Status = TrackTentative;
+		Trk.ID = NextID++;
+		Trk.RadarChan = RadarChan;
+		double rvar = gRadarConfig.TrackRangeNoise * gRadarConfig.TrackRangeNoise;
+		double dvar = gRadarConfig.TrackDopplerNoise * gRadarConfig.TrackDopplerNoise;
+		Trk.Range.Pos = Det.RangeIndex + Det.RangeFrac;
+		Trk.Range.Vel = 0.0;
+		Trk.Range.P00 = rvar;
+		Trk.Range.P01 = 0.0;
+		Trk.Range.P11 = TRACK_INIT_RATE_SIGMA * TRACK_INIT_RATE_SIGMA;
+		Trk.Doppler.Pos = Det.DopplerIndex + Det.DopplerFrac;
+		Trk.Doppler.Vel = 0.0;
+		Trk.Doppler.P00 = dvar;
+		Trk.Doppler.P01 = 0.0;
+		Trk.Doppler.P11 = TRACK_INIT_RATE_SIGMA * TRACK_INIT_RATE_SIGMA;
+		Trk.Amplitude = Det.Amplitude;
+		Trk.Hits = 1;
+		Trk.Misses = 0;
+		Trk.Age = 0;
+		NumActive++;
+		MaxActive = MAX(MaxActive, NumActive);
+		TracksStarted++;
+		return;
+	}
+}
+
+// Associate the detections of one radar with its tracks and update them.  Returns the number of tracks updated.
+int TrackerData::associate(int RadarChan)
+{
+	const DetectionList &Dets = Work[RadarChan];
+	const int nrow = Dets.NumDetections;
+	const double nd = (double)WorkParams.Num_WRI;
+	const double rvar = gRadarConfig.TrackRangeNoise * gRadarConfig.TrackRangeNoise;
+	const double dvar = gRadarConfig.TrackDopplerNoise * gRadarConfig.TrackDopplerNoise;
+	const double gate = gRadarConfig.TrackGate;
+
+	int ntrk = 0;
+	for (int i = 0; i < MaxTracks; i++)
+		if ((Tracks[i].Status != TrackFree) && (Tracks[i].RadarChan == RadarChan)) TrackCol[ntrk++] = i;
+	if (nrow == 0) return 0;
+
+	// Cost matrix. Columns past the tracks are "start a new track" at the cost of the gate.
+	const int ncol = ntrk + nrow;
+	for (int r = 0; r < nrow; r++) {
+		double zr = Dets.Det[r].RangeIndex + Dets.Det[r].RangeFrac;
+		double zd = Dets.Det[r].DopplerIndex + Dets.Det[r].DopplerFrac;
+		double *pCost = &Cost[r*ncol];
+		for (int c = 0; c < ntrk; c++) {
+			const TrackState &Trk = Tracks[TrackCol[c]];
+			double yr = zr - Trk.Range.Pos;
+			double yd = zd - Trk.Doppler.Pos;
+			yd -= nd * floor(yd / nd + 0.5);	// Shortest way around
+			double d2 = yr * yr / (Trk.Range.P00 + rvar) + yd * yd / (Trk.Doppler.P00 + dvar);
+			pCost[c] = (d2 < gate) ? d2 : TRACK_BIG_COST;
+		}
+		for (int c = ntrk; c < ncol; c++) pCost[c] = gate;
+	}
+
+	// Minimum cost assignment of rows to columns (Hungarian method with potentials, 1 based indexing,
+	// Match[column] = row).  O(rows^2 * columns), and rows are at most MaxDetections.
+	for (int c = 0; c <= ncol; c++) {
+		V[c] = 0.0;
+		Match[c] = 0;
+	}
+	for (int r = 0; r <= nrow; r++) U[r] = 0.0;
+	for (int r = 1; r <= nrow; r++) {
+		Match[0] = r;
+		int c0 = 0;
+		for (int c = 0; c <= ncol; c++) {
+			MinV[c] = 1e300;
+			ColUsed[c] = false;
+		}
+		do {
+			ColUsed[c0] = true;
+			int r0 = Match[c0], c1 = 0;
+			double delta = 1e300;
+			for (int c = 1; c <= ncol; c++) {
+				if (ColUsed[c]) continue;
+				double cur = Cost[(r0 - 1)*ncol + (c - 1)] - U[r0] - V[c];
+				if (cur < MinV[c]) {
+					MinV[c] = cur;
+					Way[c] = c0;
+				}
+				if (MinV[c] < delta) {
+					delta = MinV[c];
+					c1 = c;
+				}
+			}
+			for (int c = 0; c <= ncol; c++) {
+				if (ColUsed[c]) {
+					U[Match[c]] += delta;
+					V[c] -= delta;
+				}
+				else {
+					MinV[c] -= delta;
+				}
+			}
+			c0 = c1;
+		} while (Match[c0] != 0);
+		do {
+			int c1 = Way[c0];
+			Match[c0] = Match[c1];
+			c0 = c1;
+		} while (c0 != 0);
+	}
+	for (int r = 0; r < nrow; r++) RowAssign[r] = -1;
+	for (int c = 1; c <= ncol; c++)
+		if (Match[c] > 0) RowAssign[Match[c] - 1] = c - 1;
+
+	// Update the tracks that got a detection and start tracks for the rest
+	int nupdated = 0;
+	for (int r = 0; r < nrow; r++) {
+		int c = RowAssign[r];
+		const RadarDetection &Det = Dets.Det[r];
+		if ((c >= 0) && (c < ntrk) && (Cost[r*ncol + c] < gate)) {
+			TrackState &Trk = Tracks[TrackCol[c]];
+			double yr = Det.RangeIndex + Det.RangeFrac - Trk.Range.Pos;
+			double yd = Det.DopplerIndex + Det.DopplerFrac - Trk.Doppler.Pos;
+			yd -= nd * floor(yd / nd + 0.5);
+			correct(Trk.Range, yr, rvar);
+			correct(Trk.Doppler, yd, dvar);
+			Trk.Doppler.Pos = fmod(Trk.Doppler.Pos + nd, nd);
+			Trk.Amplitude = Det.Amplitude;
+			Trk.Hits++;
+			Trk.Misses = -1;	// Set to 0 when misses are counted below
+			if ((Trk.Status == TrackTentative) && (Trk.Hits >= gRadarConfig.TrackConfirmHits)) {
+				Trk.Status = TrackConfirmed;
+				TracksConfirmed++;
+			}
+			nupdated++;
+		}
+		else {
+			startTrack(RadarChan, Det);
+		}
+	}
+	return nupdated;
+}
+
+void TrackerData::update()
+{
+	// Time since the last update. The first update only starts tracks.
+	double dt = 0.0;
+	if (!FirstUpdate) dt = std::chrono::duration<double>(WorkParams.Data_TOVtt - LastTOV).count();
+	if (dt < 0.0) dt = 0.0;
+	LastTOV = WorkParams.Data_TOVtt;
+	FirstUpdate = false;
+
+	for (int i = 0; i < MaxTracks; i++) {
+		if (Tracks[i].Status == TrackFree) continue;
+		predict(Tracks[i], dt);
+		Tracks[i].Age++;
+	}
+
+	for (unsigned int rindex = 0; rindex < WorkParams.NumSensorsSet; rindex++)
+		associate(rindex);
+
+	// Count misses and drop tracks. Tentative tracks are dropped on their second miss.
+	int nreport = 0;
+	for (int i = 0; i < MaxTracks; i++) {
+		TrackState &Trk = Tracks[i];
+		if (Trk.Status == TrackFree) continue;
+		if (Trk.Age == 0) continue;		// Started this CPI
+		Trk.Misses++;
+		if (((Trk.Status == TrackTentative) && (Trk.Misses >= 2)) ||
+			((Trk.Status == TrackConfirmed) && (Trk.Misses > gRadarConfig.TrackMaxMisses))) {
+			Trk.Status = TrackFree;
+			NumActive--;
+			continue;
+		}
+		if ((Trk.Status == TrackConfirmed) || gRadarConfig.TrackRecordTentative) {
+			TrackReport &Rep = Reports[nreport++];
+			Rep.ID = Trk.ID;
+			Rep.RadarChan = Trk.RadarChan;
+			Rep.Status = Trk.Status;
+			Rep.Range = (float)Trk.Range.Pos;
+			Rep.RangeRate = (float)Trk.Range.Vel;
+			Rep.Doppler = (float)Trk.Doppler.Pos;
+			Rep.DopplerRate = (float)Trk.Doppler.Vel;
+			Rep.Speed = ((float)gRadarConfig.UAmbDoppler)*(Rep.Doppler - ((float)(WorkParams.Num_WRI / 2)))* 2.0F /
+				(float)WorkParams.Num_WRI;
+			Rep.Amplitude = Trk.Amplitude;
+			Rep.Hits = Trk.Hits;
+			Rep.Misses = Trk.Misses;
+			Rep.Age = Trk.Age;
+		}
+	}
+
+	if (gRadarState.DataRecording == TRUE) save_track_data(WorkParams, Reports, nreport);
+}
+
+
+int startTracker(CPI_Params Params)
+{
+	if (!gRadarConfig.TrackerOn) return 0;
+	Tracker.initialize(Params);
+	TrackerThread = std::thread(&TrackerData::TrackerFunction, &Tracker);
+	TrackerRunning = TRUE;
+	log_message("Tracker started. Up to %d tracks, gate %.2f, confirm after %d hits, drop after %d misses",
+		MIN(gRadarConfig.TrackMaxTracks, MaxTracks), gRadarConfig.TrackGate, gRadarConfig.TrackConfirmHits, gRadarConfig.TrackMaxMisses);
+	return 0;
+}
+
+void stopTracker()
+{
+	if (!TrackerRunning) return;
+	std::unique_lock<std::mutex> bufferlock(Tracker.OwnBuffers);
+	Tracker.StopRequested = true;
+	bufferlock.unlock();
+	Tracker.DataHere.notify_all();
+	if (TrackerThread.joinable()) TrackerThread.join();
+	TrackerRunning = FALSE;
+}
+
+// Called by the output gather thread once a full set of radar results is in gProcessedData.
+// Without CFAR the strongest peak of each radar is used as its only detection.
+int TrackerLoadFrame(void)
+{
+	if (!TrackerRunning) return 0;
+	if (gRadarConfig.CFARType != CFAROff)
+		return Tracker.loadDetections(gProcessedData.Params, gProcessedData.Detections);
+
+	DetectionList Peaks[MaxRadars];
+	for (unsigned int rindex = 0; rindex < gProcessedData.Params.NumSensorsSet; rindex++) {
+		RadarDetection &det = Peaks[rindex].Det[0];
+		Peaks[rindex].NumDetections = 1;
+		det.RangeIndex = gProcessedData.index_max_r[rindex];
+		det.DopplerIndex = gProcessedData.index_max_d[rindex];
+		det.RangeFrac = gProcessedData.index_frac_r[rindex];
+		det.DopplerFrac = gProcessedData.index_frac_d[rindex];
+		det.Amplitude = gProcessedData.peakAmplitude[rindex];
+	}
+	return Tracker.loadDetections(gProcessedData.Params, Peaks);
+}
@@ -0,0 +1,110 @@
+#pragma once
+// Multi-target tracker header file
+// The tracker runs on its own thread after the output gather thread.  It follows the detections of
+// each radar from CPI to CPI in range-Doppler space, so the reported target is not the instantaneous
+// peak that jumps between clutter and target.
+// Oct 2026 Initial version
+/*
+RadarRTP - Radar Real time Program (RTP)
+
+ 2022 Massachusetts Institute of Technology.
+
+Distributed under GNU GPLv2.
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+General Public License, Version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details, supplied with this source as License.txt
+*/
+#include "stdafx.h"
+#include "cfar.h"
+#include <mutex>
+#include <condition_variable>
+
+#define MaxTracks 512		// Size of the preallocated track table, shared by all radars
+
+enum TrackStatus {
+	TrackFree = 0,
+	TrackTentative,			// Not enough hits yet to be reported as confirmed
+	TrackConfirmed
+};
+
+// One axis of the track, a constant velocity Kalman filter with position measured
+typedef struct TrackAxis {
+	double Pos = 0.0;		// bins
+	double Vel = 0.0;		// bins per second
+	double P00 = 0.0, P01 = 0.0, P11 = 0.0;	// Covariance (symmetric)
+} TrackAxis;
+
+typedef struct TrackState {
+	TrackStatus Status = TrackFree;
+	unsigned int ID = 0;		// Unique while the program runs
+	int RadarChan = 0;
+	TrackAxis Range;			// Range bin
+	TrackAxis Doppler;			// Doppler bin, before fftshift. Wraps around at Num_WRI
+	float Amplitude = 0.0f;		// dB of the last associated detection
+	int Hits = 0;				// Detections associated
+	int Misses = 0;				// Consecutive CPIs without a detection
+	int Age = 0;				// CPIs since the track started
+} TrackState;
+
+// What is recorded for each track after each update
+typedef struct TrackReport {
+	unsigned int ID;
+	int RadarChan;
+	TrackStatus Status;
+	float Range, RangeRate;		// bins, bins/s
+	float Doppler, DopplerRate;	// bins, bins/s
+	float Speed;				// m/s, from the Doppler bin as for peakDoppler
+	float Amplitude;
+	int Hits, Misses, Age;
+} TrackReport;
+
+typedef struct TrackerData {
+	CPI_Params Params;
+	// Input, loaded by the output gather thread
+	DetectionList Detections[MaxRadars];
+	// C++11 constructs
+	std::condition_variable DataHere;	// Detections ready for tracking
+	std::mutex OwnBuffers;				// Mutex for the input buffers
+	bool InBufferFull = false;
+	bool Working = false;				// Update in progress
+	bool StopRequested = false;
+	unsigned long Overruns = 0;			// CPIs the tracker could not keep up with
+
+	int initialize(CPI_Params InitParams);
+	int loadDetections(CPI_Params CPIParams, const DetectionList Dets[]);	// Called by the gather thread, only blocks in virtual time
+	void TrackerFunction();
+private:
+	TrackState Tracks[MaxTracks];
+	TrackReport Reports[MaxTracks];
+	DetectionList Work[MaxRadars];		// Copy of the input so the gather thread isn't held up
+	CPI_Params WorkParams;
+	// Assignment work space, rows are detections and columns tracks then one "no track" column per detection
+	double Cost[MaxDetections*(MaxTracks + MaxDetections)];
+	int TrackCol[MaxTracks];			// Track table index for each column
+	double U[MaxDetections + 1], V[MaxTracks + MaxDetections + 1], MinV[MaxTracks + MaxDetections + 1];
+	int Match[MaxTracks + MaxDetections + 1], Way[MaxTracks + MaxDetections + 1];
+	int RowAssign[MaxDetections];
+	bool ColUsed[MaxTracks + MaxDetections + 1];
+
+	unsigned int NextID = 1;
+	int NumActive = 0, MaxActive = 0;
+	unsigned long TracksStarted = 0, TracksConfirmed = 0, Updates = 0;
+	double UpdateTimeTotal = 0.0;
+	DataTics LastTOV;
+	bool FirstUpdate = true;
+
+	void update();
+	void predict(TrackState &Trk, double dt);
+	void correct(TrackAxis &Ax, double Meas, double MeasVar);
+	int associate(int RadarChan);
+	void startTrack(int RadarChan, const RadarDetection &Det);
+} TrackerData;
+
+int startTracker(CPI_Params Params);
+void stopTracker();
+int TrackerLoadFrame(void);		// Called from the gather thread with gProcessedData complete
@@ -24,31 +24,107 @@ See the GNU General Public License for more details, supplied with this source a
 
 #include "stdafx.h"
 
+// The transmit tables.  One period of the waveform at unit amplitude is kept here (Period), so a live
+// change (amplitude, modulation on or off, radar long sweep) only scales it into the spare table.
+static std::vector<float> Period;	// One period of the output, unit amplitude
+static bool PeriodFixed = false;	// Period is the sonar chirp, made once by create_waveform()
+
+int WaveTable::initialize(unsigned int LenIn)
+{
+	if (Len != LenIn) {
+		cleanup();
+		Len = LenIn;
+		for (int t = 0; t < 2; t++) {
+			Tables[t] = (float*)fftwf_malloc(Len * sizeof(float));	// Aligned for the copy in the callback
+			if (Tables[t] == NULL)
+			{
+				log_message("Error %d: Malloc of output data array failed, exiting", errno);
+				exit(1);  /* Should exit gracefully rather than just quitting */
+			}
+		}
+	}
+	for (int t = 0; t < 2; t++) memset(Tables[t], 0, Len * sizeof(float));
+	Live = 0;
+	Reading = NULL;
+	Version = 0;
+	return 0;
+}
+
+// Locks out other writers and returns the table that isn't live, once the callback has finished with it.
+// The callback can only be reading it if it picked it up just before the last publish().
+float *WaveTable::beginWrite()
+{
+	Writer.lock();
+	float *Back = Tables[1 - Live.load()];
+	while (Reading.load() == Back)
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	return Back;
+}
+
+void WaveTable::publish()
+{
+	Live = 1 - Live.load();
+	Version++;
+	Writer.unlock();
+}
+
+// For the audio callback.  Reading is set before Live is checked again, so a writer either sees the
+// table marked or the callback sees the new Live and takes that table instead.
+const float *WaveTable::beginRead()
+{
+	const float *Table;
+	do {
+		Table = Tables[Live.load()];
+		Reading = Table;
+	} while (Table != Tables[Live.load()]);
+	return Table;
+}
+
+void WaveTable::endRead()
+{
+	Reading = NULL;
+}
+
+void WaveTable::cleanup()
+{
+	for (int t = 0; t < 2; t++) {
+		if (Tables[t] != NULL) fftwf_free(Tables[t]);
+		Tables[t] = NULL;
+	}
+	Len = 0;
+}
+
+// Radar VCO tuning voltage over one period: a sawtooth from -1 to (1-1/N) over the WRI, or over the whole
+// block for the long sweep.  For up/down processing the odd WRIs sweep back down, so the period is a
+// triangle over two WRIs.
+static void make_radar_period()
+{
+	int N = gRadarConfig.NSamplesPerWRI;
+	if (gRadarState.TransmitLongSweep) N *= gRadarConfig.NWRIPerBlock;
+	bool UpDown = (gRadarConfig.ProcessingMode == UpDownLFM) && !gRadarState.TransmitLongSweep;
+	Period.resize(UpDown ? 2 * N : N);
+	for (int k = 0; k < N; k++) {
+		Period[k] = (float)(k - N / 2) / (float)N;
+		if (UpDown) Period[2 * N - 1 - k] = Period[k];
+	}
+}
+
 // Create the waveform that will be output by the soundcard
 // Primarily intended to create a ramp that will chirp the radar.
 // Sonar waveform and processing added over several months in late 2017-Apr 2018
 // Only limited utility in chirping the radar at this time since equalization and calibration needed
 // to make chirp processing work well has not been completed.
+// The sonar replicas are made here, once.  The output tables are filled by update_waveform().
 int create_waveform()
 
 {
-	int k, dindex, p;
-	float wave_val;
+	int k;
 
 	if (NUMOUTCHAN == 0) {
 		return(0);
 	}
-	if (WaveData != NULL) {
-		free(WaveData);
-		WaveData = NULL;
-	}
-
-	WaveData = (float*)malloc(gRadarConfig.NSamplesPerWRI * gRadarConfig.NWRIPerBlock * NUMOUTCHAN * sizeof(WaveData[0]));
-	if (WaveData == NULL)
-	{
-		log_message("Error %d: Malloc of output data array failed, exiting", errno);
-		exit(1);  /* Should exit gracefully rather than just quitting */
-	}
+	gWaveTable.initialize(gRadarConfig.NSamplesPerWRI * gRadarConfig.NWRIPerBlock * NUMOUTCHAN);
+	PeriodFixed = false;
 	if (gRadarConfig.Sonar) {
 
 		// Allocate memory for pulse compression replica and down conversion
@@ -65,46 +141,9 @@ int create_waveform()
 		}
 	}
 
-	double WFAmp;
-	if (gRadarState.TransmitModOn) {
-		WFAmp = gRadarState.TransmitModAmp;
-	}
-	else {
-		WFAmp = 0.0;
-	}
-
 	/* Initialize the transmit waveform */
 	if (!gRadarConfig.Sonar) {  // If not sonar, then it is the radar VCO control
-		if (!gRadarState.TransmitLongSweep) {
-			/* Note that this is only used when ranging.   */
-			for (k = 0, dindex = 0; k < (gRadarConfig.NSamplesPerWRI * gRadarConfig.NWRIPerBlock); k++) {
-				wave_val = (float)(WFAmp*(float)(
-					((k + ((int) gRadarConfig.TxRxSampleOffset)) % gRadarConfig.NSamplesPerWRI)
-					- gRadarConfig.NSamplesPerWRI / 2))
-					/ (float)gRadarConfig.NSamplesPerWRI;  /* This generates a sawtooth from -1 to (1-1/gRadarConfig.NSamplesPerWRI) */
-				WaveData[dindex++] = wave_val;
-				if (NUMOUTCHAN > 1) {
-					for (p = 1; p < NUMOUTCHAN; p++) {
-						WaveData[dindex++] = 0.0f;	// Currently setting all other channels to zero
-					}
-				}
-			}
-		}
-		else {
-			for (k = 0, dindex = 0; k < (gRadarConfig.NSamplesPerWRI * gRadarConfig.NWRIPerBlock); k++) {
-				wave_val = (float)(WFAmp* (
-					((k + ((int)gRadarConfig.TxRxSampleOffset)) % (gRadarConfig.NSamplesPerWRI*gRadarConfig.NWRIPerBlock))
-					- (gRadarConfig.NSamplesPerWRI* gRadarConfig.NWRIPerBlock) / 2))
-					/ (float)(gRadarConfig.NSamplesPerWRI* gRadarConfig.NWRIPerBlock);  /* This generates a sawtooth from -1 to (1-1/gRadarConfig.NSamplesPerWRI) */
-				WaveData[dindex++] = wave_val;
-				if (NUMOUTCHAN > 1) {
-					for (p = 1; p < NUMOUTCHAN; p++) {
-						WaveData[dindex++] = 0.0f;	// Currently setting all other channels to zero
-					}
-				}
-			}
-
-		}
+		update_waveform();
 		log_message("Created VCO tuning voltage sweep for RF Waveform.");
 	}
 	else { // Create a sonar waveform on one channel
@@ -114,24 +153,40 @@ int create_waveform()
 		for (k = 0; k < gRadarConfig.NSamplesPerWRI; k++) {
 			argument = TWOPI * ((gRadarConfig.SonarFreq - gRadarConfig.SonarBandwidth / 2.0) +
 				gRadarConfig.SonarBandwidth * ((double)k) / (2.0*((double)gRadarConfig.NSamplesPerWRI)))
-				* ((double)k);
+				* ((double)k) / gRadarConfig.SampleRate;
 			WaveformReplica[k] = (RTPComplex)exp(std::complex<double>(0.0, argument));
 			DownConvertWF[k] = (RTPComplex)exp(std::complex<double>(0.0, -TWOPI*((double)k)*gRadarConfig.SonarFreq / gRadarConfig.SampleRate));
 
 		}
-		for (k = 0, dindex = 0; k < (gRadarConfig.NSamplesPerWRI * gRadarConfig.NWRIPerBlock); k++) {
-			wave_val = (float)WaveformReplica[(k + ((int)gRadarConfig.TxRxSampleOffset)) % gRadarConfig.NSamplesPerWRI].real();  /* This generates a sawtooth from -1 to (1-1/gRadarConfig.NSamplesPerWRI) */
-			WaveData[dindex++] = wave_val;
-			// Store the complex replica
-			if (NUMOUTCHAN > 1) {
-				for (p = 1; p < NUMOUTCHAN; p++) {
-					WaveData[dindex++] = 0.0f;	// Currently setting all other channels to zero
-				}
-			}
-		}
+		Period.resize(gRadarConfig.NSamplesPerWRI);
+		for (k = 0; k < gRadarConfig.NSamplesPerWRI; k++)
+			Period[k] = WaveformReplica[k].real();
 		if (gRadarState.TransmitLongSweep) {
-			log_message("Warning: Long sweep is currently not implemented for sonar. Ignoring");
+			// One sweep over the whole block.  It is compressed by the long sweep matched filter
+			// (matchedFilter.cpp), which wants the baseband replica in the time domain.
+			int SweepLen = gRadarConfig.NSamplesPerWRI * gRadarConfig.NWRIPerBlock;
+			if (LongSweepReplica != NULL)
+				free(LongSweepReplica);
+			LongSweepReplica = (RTPComplex*)malloc(SweepLen * sizeof(LongSweepReplica[0]));
+			if (LongSweepReplica == NULL)
+			{
+				log_message("Error %d: Malloc of waveform data arrays failed, exiting..", errno);
+				exit(1);  /* Should exit gracefully rather than just quitting */
+			}
+			Period.resize(SweepLen);
+			for (k = 0; k < SweepLen; k++) {
+				argument = TWOPI * ((gRadarConfig.SonarFreq - gRadarConfig.SonarBandwidth / 2.0) +
+					gRadarConfig.SonarBandwidth * ((double)k) / (2.0*((double)SweepLen)))
+					* ((double)k) / gRadarConfig.SampleRate;
+				RTPComplex Sweep = (RTPComplex)exp(std::complex<double>(0.0, argument));
+				Period[k] = Sweep.real();
+				LongSweepReplica[k] = Sweep *
+					(RTPComplex)exp(std::complex<double>(0.0, -TWOPI*((double)k)*gRadarConfig.SonarFreq / gRadarConfig.SampleRate));
+			}
+			log_message("Created long sweep sonar waveform, %d samples", SweepLen);
 		}
+		PeriodFixed = true;
+		update_waveform();
 		// Now downconvert and convert the replica to the frequency domain (FFT)
 		for (k = 0; k < gRadarConfig.NSamplesPerWRI; k++) {
 			WaveformReplica[k] *= DownConvertWF[k];  // Note, not doing any waveform tapering/windowing
@@ -159,3 +214,31 @@ int create_waveform()
 	return(0);
 }
 
+// Fills the spare output table from the current transmit state and swaps it in at the next callback.
+// Can be called while the stream is running.  The radar sweep is remade (TransmitLongSweep can change),
+// the sonar chirp is fixed by the processing set up at the start and is only rescaled.
+// TxRxSampleOffset is applied by starting part way into the period, and the period wraps with a
+// counter, so there is no divide or modulus per sample.
+int update_waveform()
+{
+	if ((NUMOUTCHAN == 0) || (gWaveTable.Len == 0)) {
+		return(0);
+	}
+	if (!PeriodFixed)
+		make_radar_period();
+
+	float WFAmp = gRadarState.TransmitModOn ? (float)gRadarState.TransmitModAmp : 0.0f;
+	const unsigned int P = (unsigned int)Period.size();
+	const unsigned int NFrames = gWaveTable.Len / NUMOUTCHAN;
+	unsigned int j = ((int)gRadarConfig.TxRxSampleOffset) % P;
+
+	float *Table = gWaveTable.beginWrite();
+	for (unsigned int k = 0; k < NFrames; k++) {
+		Table[NUMOUTCHAN * k] = WFAmp * Period[j];
+		for (int p = 1; p < NUMOUTCHAN; p++)
+			Table[NUMOUTCHAN * k + p] = 0.0f;	// Currently setting all other channels to zero
+		if (++j == P) j = 0;
+	}
+	gWaveTable.publish();
+	return(0);
+}